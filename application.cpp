@@ -1,48 +1,101 @@
 #include "application.hpp"
 
+#include "program_manager.hpp"
 
+#ifdef CG_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#if defined(CG_HAS_EGL) && !defined(EGL_PLATFORM_SURFACELESS_MESA)
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
 
 namespace cg
 {
-	Application::Application(std::string title, int window_width, int window_height)
+	Application::Options Application::parse_options(int& argc, char** argv)
 	{
-		// GLFW init
-		glfwSetErrorCallback(error_callback);
-		if(!glfwInit())
+		Options options{};
+		int kept{0};
+		for(int i{0}; i < argc; ++i)
 		{
-			std::cerr << "GLFW failed to initialize\n";
-			throw std::runtime_error{"GLFW failed to initialize."};
+			std::string argument{argv[i]};
+			if(argument == "--headless")
+				options.headless = true;
+			else if(argument == "--frames" && i + 1 < argc)
+				options.frame_count = std::atoi(argv[++i]);
+			else if(argument == "--capture" && i + 1 < argc)
+				options.capture_prefix = argv[++i];
+			else if(argument == "--profile" && i + 1 < argc)
+				options.profile_path = argv[++i];
+			else
+				argv[kept++] = argv[i];
 		}
+		argc = kept;
+		return options;
+	}
 
-		// Window settings
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);	// Set Opengl constext version 3.3
-		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);	// Set OpenGL core profile
-		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);	// Make window visible on creation
-		glfwWindowHint(GLFW_SAMPLES, 16);	// Anti-aliasing
+	Application::Application(std::string title, int window_width, int window_height)
+		: Application{std::move(title), window_width, window_height, Options{}}
+	{
+	}
 
+	Application::Application(std::string title, int window_width, int window_height, const Options& options)
+		: options{options},
+		  width{window_width},
+		  height{window_height}
+	{
+		if(this->options.headless && this->options.frame_count <= 0)
+			this->options.frame_count = 1;
 
-		// Window init
-		constexpr auto window_deleter{[] (GLFWwindow* window) { glfwDestroyWindow(window); glfwTerminate(); }};
-		window = WindowPointer{glfwCreateWindow(window_width, window_height, title.c_str(), nullptr, nullptr), window_deleter};
-		
-		if(!window)
+		if(!this->options.headless || !create_egl_context())
 		{
-			std::cerr << "GLFW window creation failed\n";
-			throw std::runtime_error{"GLFW window creation failed."};
+			// GLFW init
+			glfwSetErrorCallback(error_callback);
+			if(!glfwInit())
+			{
+				std::cerr << "GLFW failed to initialize\n";
+				throw std::runtime_error{"GLFW failed to initialize."};
+			}
+
+			// Window settings
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);	// Set Opengl constext version 3.3
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);	// Set OpenGL core profile
+			glfwWindowHint(GLFW_VISIBLE, this->options.headless ? GLFW_FALSE : GLFW_TRUE);	// Make window visible on creation
+			glfwWindowHint(GLFW_SAMPLES, 16);	// Anti-aliasing
+
+
+			// Window init
+			constexpr auto window_deleter{[] (GLFWwindow* window) { glfwDestroyWindow(window); glfwTerminate(); }};
+			window = WindowPointer{glfwCreateWindow(window_width, window_height, title.c_str(), nullptr, nullptr), window_deleter};
+
+			if(!window)
+			{
+				std::cerr << "GLFW window creation failed\n";
+				throw std::runtime_error{"GLFW window creation failed."};
+			}
+
+			glfwSetFramebufferSizeCallback(window.get(), framebuffer_callback);
+			glfwMakeContextCurrent(window.get());
+			glfwSwapInterval(this->options.headless ? 0 : 1);	// Turn VSYNC off
+
+			std::cout << "Application: GLFW initialized successfully\n";
 		}
-		
-		glfwSetFramebufferSizeCallback(window.get(), framebuffer_callback);
-		glfwMakeContextCurrent(window.get());
-		glfwSwapInterval(1);	// Turn VSYNC off
-		
-		std::cout << "Application: GLFW initialized successfully\n";
 
 
-		// GLEW init
+		// GLEW init, without a window there is no GLX or WGL to initialize
 		glewExperimental = GL_TRUE;
-		GLenum status{glewInit()};
+		GLenum status{window ? glewInit() : glewContextInit()};
 
 		if(status != GLEW_OK)
 		{
@@ -52,7 +105,39 @@ namespace cg
 
 		std::cout << "Application: GLEW initialized successfully\n";
 
-		glfwSetWindowUserPointer(window.get(), nullptr);
+		if(window)
+			glfwSetWindowUserPointer(window.get(), nullptr);
+		if(this->options.headless)
+			create_framebuffer();
+
+		frame_start = std::chrono::steady_clock::now();
+	}
+
+	Application::~Application()
+	{
+		if(frames > 0 && (options.headless || options.frame_count > 0))
+		{
+			std::cout << "Application: Rendered " << frames << " frames in " << frame_seconds * 1000. << " ms, "
+				<< frame_seconds * 1000. / frames << " ms per frame\n";
+		}
+
+		ProgramManager::get_global().clear();
+
+		if(framebuffer)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(2, renderbuffers);
+		}
+
+#ifdef CG_HAS_EGL
+		if(egl_display)
+		{
+			eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if(egl_context)
+				eglDestroyContext(egl_display, egl_context);
+			eglTerminate(egl_display);
+		}
+#endif
 	}
 
 	GLFWwindow* Application::get_window() const
@@ -60,6 +145,161 @@ namespace cg
 		return window.get();
 	}
 
+	bool Application::is_headless() const
+	{
+		return options.headless;
+	}
+
+	bool Application::should_close() const
+	{
+		return closed || (window && glfwWindowShouldClose(window.get())) || (options.frame_count > 0 && frames >= options.frame_count);
+	}
+
+	void Application::close()
+	{
+		closed = true;
+	}
+
+	void Application::swap_buffers()
+	{
+		if(!options.capture_prefix.empty())
+			capture_frame();
+
+		if(options.headless)
+			glFinish();
+		else
+			glfwSwapBuffers(window.get());
+
+		auto now{std::chrono::steady_clock::now()};
+		if(input)
+			input->presented(now);
+		frame_seconds += std::chrono::duration<double>(now - frame_start).count();
+		frame_start = now;
+		++frames;
+	}
+
+	void Application::poll_events()
+	{
+		if(window)
+			glfwPollEvents();
+		if(input)
+			input->process_events();
+		ProgramManager::get_global().update();
+	}
+
+	double Application::get_time() const
+	{
+		return options.headless ? frames / 60. : glfwGetTime();
+	}
+
+	void Application::get_framebuffer_size(int& width, int& height) const
+	{
+		if(options.headless)
+		{
+			width = this->width;
+			height = this->height;
+		}
+		else
+		{
+			glfwGetFramebufferSize(window.get(), &width, &height);
+		}
+	}
+
+	bool Application::create_egl_context()
+	{
+#ifdef CG_HAS_EGL
+		// Prefer the surfaceless platform, it needs neither a display server nor a GPU device node
+		EGLDisplay display{EGL_NO_DISPLAY};
+		auto get_platform_display{reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"))};
+		if(get_platform_display)
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if(display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+		{
+			std::cerr << "Application: EGL display initialization failed, falling back to a hidden window\n";
+			return false;
+		}
+		egl_display = display;
+
+		const EGLint config_attributes[]{EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+		EGLConfig config{nullptr};
+		EGLint config_count{0};
+		eglChooseConfig(display, config_attributes, &config, 1, &config_count);
+
+		const EGLint context_attributes[]{EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+		EGLContext context{EGL_NO_CONTEXT};
+		if(eglBindAPI(EGL_OPENGL_API))
+			context = eglCreateContext(display, config_count > 0 ? config : nullptr, EGL_NO_CONTEXT, context_attributes);
+		if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			if(context != EGL_NO_CONTEXT)
+				eglDestroyContext(display, context);
+			eglTerminate(display);
+			egl_display = nullptr;
+			std::cerr << "Application: EGL surfaceless OpenGL 3.3 context creation failed, falling back to a hidden window\n";
+			return false;
+		}
+		egl_context = context;
+
+		std::cout << "Application: EGL surfaceless context initialized successfully\n";
+		return true;
+#else
+		std::cerr << "Application: Built without EGL, falling back to a hidden window\n";
+		return false;
+#endif
+	}
+
+	void Application::create_framebuffer()
+	{
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glGenRenderbuffers(2, renderbuffers);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Application: Offscreen framebuffer of " << width << "x" << height << " is incomplete\n";
+			throw std::runtime_error{"Application: Offscreen framebuffer creation failed."};
+		}
+
+		glViewport(0, 0, width, height);
+		std::cout << "Application: Rendering offscreen into a " << width << "x" << height << " framebuffer\n";
+	}
+
+	void Application::capture_frame() const
+	{
+		int frame_width, frame_height;
+		get_framebuffer_size(frame_width, frame_height);
+
+		std::vector<unsigned char> pixels(static_cast<size_t>(frame_width) * frame_height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(options.headless ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+		glReadPixels(0, 0, frame_width, frame_height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+		std::ostringstream path{};
+		path << options.capture_prefix << std::setw(4) << std::setfill('0') << frames << ".ppm";
+		std::ofstream file{path.str(), std::ios::binary};
+		if(!file)
+		{
+			std::cerr << "Application: Could not write frame capture " << path.str() << '\n';
+			return;
+		}
+
+		// PPM rows go from top to bottom, OpenGL rows from bottom to top
+		file << "P6\n" << frame_width << ' ' << frame_height << "\n255\n";
+		for(int row{frame_height - 1}; row >= 0; --row)
+			file.write(reinterpret_cast<const char*>(pixels.data() + static_cast<size_t>(row) * frame_width * 3), frame_width * 3);
+	}
+
 	void Application::error_callback(int errorcode, const char* description)
 	{
 		std::cerr << "GLFW failed with error code " << errorcode << " and description: " << description;
@@ -73,6 +313,7 @@ namespace cg
 
 	void Application::set_input(InputManager* input)
 	{
+		this->input = input;
 		if(window)
 		{
 			glfwSetWindowUserPointer(window.get(), input);
@@ -82,9 +323,9 @@ namespace cg
 				if(input_ptr)
 				{
 					if(action == GLFW_PRESS)
-						input_ptr->key_pressed(keycode);
+						input_ptr->post({InputManager::Event::Type::key_pressed, keycode, glm::vec2{0.f}, {}});
 					else if(action == GLFW_RELEASE)
-						input_ptr->key_released(keycode);
+						input_ptr->post({InputManager::Event::Type::key_released, keycode, glm::vec2{0.f}, {}});
 				}
 			}};
 			glfwSetKeyCallback(window.get(), key_callback);
@@ -94,9 +335,9 @@ namespace cg
 				if(input_ptr)
 				{
 					if(action == GLFW_PRESS)
-						input_ptr->key_pressed(buttoncode);
+						input_ptr->post({InputManager::Event::Type::key_pressed, buttoncode, glm::vec2{0.f}, {}});
 					else if(action == GLFW_RELEASE)
-						input_ptr->key_released(buttoncode);
+						input_ptr->post({InputManager::Event::Type::key_released, buttoncode, glm::vec2{0.f}, {}});
 				}
 			}};
 			glfwSetMouseButtonCallback(window.get(), button_callback);
@@ -104,21 +345,21 @@ namespace cg
 			auto cursor_callback{[] (GLFWwindow* window, double x, double y) {
 				auto input_ptr = static_cast<InputManager*>(glfwGetWindowUserPointer(window));
 				if(input_ptr)
-					input_ptr->cursor_moved(glm::vec2{static_cast<float>(x), static_cast<float>(y)});
+					input_ptr->post({InputManager::Event::Type::cursor_moved, 0, glm::vec2{static_cast<float>(x), static_cast<float>(y)}, {}});
 			}};
 			glfwSetCursorPosCallback(window.get(), cursor_callback);
 
 			auto scroll_callback{[] (GLFWwindow* window, double x, double y) {
 				auto input_ptr = static_cast<InputManager*>(glfwGetWindowUserPointer(window));
 				if(input_ptr)
-					input_ptr->mouse_scrolled(glm::ivec2{static_cast<int>(x), static_cast<int>(y)});
+					input_ptr->post({InputManager::Event::Type::scrolled, 0, glm::vec2{static_cast<float>(x), static_cast<float>(y)}, {}});
 			}};
 			glfwSetScrollCallback(window.get(), scroll_callback);
 			
 			auto focus_callback{[] (GLFWwindow* window, int /*focused*/) {
 				auto input_ptr = static_cast<InputManager*>(glfwGetWindowUserPointer(window));
 				if(input_ptr)
-					input_ptr->ignore_cursor_once();
+					input_ptr->post({InputManager::Event::Type::focus_changed, 0, glm::vec2{0.f}, {}});
 			}};
 			glfwSetWindowFocusCallback(window.get(), focus_callback);
 		}
@@ -6,6 +6,7 @@
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
 
+#include <chrono>
 #include <string>
 #include <memory>
 #include <functional>
@@ -18,17 +19,70 @@ namespace cg
 		using WindowPointer = std::unique_ptr<GLFWwindow, std::function<void(GLFWwindow*)>>;
 
 		public:
+			struct Options
+			{
+				/// Renders into a framebuffer object of an EGL surfaceless context, or of a hidden window if EGL is missing.
+				bool headless{false};
+				/// Closes after this many frames, 0 runs until the window is closed. Headless mode renders 1 frame by default.
+				int frame_count{0};
+				/// Writes every frame to <capture_prefix><frame>.ppm if not empty.
+				std::string capture_prefix{};
+				/// Frame times are written here on exit if not empty, see FrameProfiler::write_file.
+				std::string profile_path{};
+			};
+
+			/// Removes --headless, --frames <count>, --capture <prefix> and --profile <path> from the arguments.
+			static Options parse_options(int& argc, char** argv);
+
 			explicit Application(std::string title, int window_width = 640, int window_height = 480);
+			explicit Application(std::string title, int window_width, int window_height, const Options& options);
+			~Application();
 
+			/// Returns nullptr for headless EGL contexts.
 			GLFWwindow* get_window() const;
+			/// The window callbacks post their input to input as events.
 			void set_input(InputManager* input);
 
+			bool is_headless() const;
+			bool should_close() const;
+			void close();
+
+			/// Presents the frame, captures it if requested and counts it. Headless frames wait for the GPU to finish.
+			/// Records the input latency of the frame, see InputManager::presented.
+			void swap_buffers();
+			/// Applies the queued input events, see InputManager::process_events. Also relinks shader programs whose
+			/// files changed, see ProgramManager::update.
+			void poll_events();
+
+			/// Seconds since start. Headless mode advances 1/60 s per frame so its output is reproducible.
+			double get_time() const;
+			void get_framebuffer_size(int& width, int& height) const;
+
 
 		private:
 			[[noreturn]] static void error_callback(int errorcode, const char* description);
 			static void framebuffer_callback(GLFWwindow* window, int width, int height);
 
+			bool create_egl_context();
+			void create_framebuffer();
+			void capture_frame() const;
+
 			WindowPointer window;
+			Options options;
+			int width;
+			int height;
+			bool closed{false};
+			InputManager* input{nullptr};
+
+			// EGLDisplay and EGLContext of a headless context
+			void* egl_display{nullptr};
+			void* egl_context{nullptr};
+			GLuint framebuffer{0};
+			GLuint renderbuffers[2]{0, 0};
+
+			int frames{0};
+			std::chrono::steady_clock::time_point frame_start;
+			double frame_seconds{0.};
 	};
 }
 
@@ -4,19 +4,22 @@
 #include "soup_mesh.hpp"
 #include "half_edge_mesh.hpp"
 #include "regular_mesh.hpp"
-#include "glutil.hpp"
+#include "frame_profiler.hpp"
+#include "mesh_renderer.hpp"
+#include "instance_buffer.hpp"
+#include "mesh_loader.hpp"
 
 #include "GLFW/glfw3.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
-#include "glm/gtc/type_ptr.hpp"
 
 #include <iostream>
 #include <string>
 
 int main(int argc, char** argv)
 {
+	auto options{cg::Application::parse_options(argc, argv)};
 	using namespace std::string_literals;
 	if(argc < 1)
 	{
@@ -26,87 +29,101 @@ int main(int argc, char** argv)
 	if(argc == 1 || argv[1] == "-h"s)
 	{
 		std::cout << "Usage:\n" << argv[0] << " <path> : Loads and displays model at path.\n"
+			<< argv[0] << " ... --headless [--frames <count>] [--capture <prefix>] [--profile <path>] : Renders offscreen, optionally writing every frame to <prefix>NNNN.ppm\n"
+			<< "    and the frame times to a CSV or JSON file.\n"
 			<< argv[0] << " -h : Shows this message.\n";
 		return 0;
 	}
 	using namespace cg;
 
-	Application app{"Assignment 1", 640, 480};
+	Application app{"Assignment 1", 640, 480, options};
 	InputManager input{};
 	app.set_input(&input);
-	GLFWwindow* window{app.get_window()};
-
-	// Load mesh
-	SoupMesh mesh{argv[1]};
-	// Convert to half edge mesh
-	HalfEdgeMesh hemesh{mesh};
-	// Convert back to renderable triangle soup
-	mesh = hemesh.toSoupMesh();
-	auto indices{mesh.calculate_indices()};
-
-	GLuint vao;
-	GLuint vbo[2];
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(2, vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.get_positions().size(), mesh.get_positions().data(), GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Load shader
-	auto program{glCreateProgram()};
-
-	std::string vs_path{"shaders/vertex_shader.glsl"};
-	auto vs{glCreateShader(GL_VERTEX_SHADER)};
-	glutil::load_compile_shader(vs, {vs_path});
-	glAttachShader(program, vs);
-
-	std::string fs_path{"shaders/fragment_shader.glsl"};
-	auto fs{glCreateShader(GL_FRAGMENT_SHADER)};
-	glutil::load_compile_shader(fs, {fs_path});
-	glAttachShader(program, fs);
-
-	glLinkProgram(program);
-	glUseProgram(program);
-	glDetachShader(program, vs);
-	glDetachShader(program, fs);
-
-	auto mvp_uniform{glGetUniformLocation(program, "mvp")};
-	glm::mat4 mvp{1.f};
+
+	// Load mesh, convert it to a half edge mesh and back to a renderable triangle soup while the window already shows
+	MeshLoader loader{argv[1], [] (const SoupMesh& mesh, HalfEdgeMesh& hemesh) {
+		std::cout << mesh.get_memory_usage() << hemesh.get_memory_usage();
+	}};
+	MeshRenderer renderer{};
+	// Captured headless frames should show the mesh, so they wait for it
+	if(app.is_headless())
+		loader.wait();
+
+	glm::mat4 model{1.f};
 	float sensitivity{1.f};
 
+	// Copies of the mesh on a grid, I switches between the model, the grid with one copy turning per frame, so only its
+	// instance is uploaded again, and the grid with every copy turning, streamed anew every frame
+	constexpr size_t grid_size{10};
+	auto grid_model{[grid_size] (size_t index, float angle) {
+		auto cell{2.f / grid_size};
+		glm::vec3 center{-1.f + (index % grid_size + .5f) * cell, -1.f + (index / grid_size + .5f) * cell, 0.f};
+		return glm::rotate(glm::scale(glm::translate(glm::mat4{1.f}, center), glm::vec3{cell * .5f}), angle, glm::vec3{0.f, 1.f, 0.f});
+	}};
+	InstanceBuffer instances{};
+	InstanceBuffer turning{InstanceBuffer::Usage::stream};
+	for(size_t i{0}; i < grid_size * grid_size; ++i)
+	{
+		instances.add(grid_model(i, 0.f));
+		turning.add(grid_model(i, 0.f));
+	}
+	int show_instances{0};
+	size_t frame{0};
+
 
 	glEnable(GL_DEPTH_TEST);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	while(!glfwWindowShouldClose(window))
+	FrameProfiler profiler{512, 4, true, !options.profile_path.empty()};
+	while(!app.should_close())
 	{
+		profiler.begin_frame();
+		profiler.begin_phase("draw");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		profiler.begin_phase("input");
 		// TODO:DO STUFF
 		if(input.get_key(GLFW_KEY_ESCAPE))
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-
-		mvp = glm::rotate(glm::mat4{1.f}, std::sin(static_cast<float>(glfwGetTime()) * sensitivity) * 0.5f, glm::vec3{1.f, 0.f, 0.f});
-		mvp = glm::rotate(mvp, static_cast<float>(glfwGetTime()) * sensitivity * 1.0f, glm::vec3{0.f, 1.f, 0.f});
-		glUniformMatrix4fv(mvp_uniform, 1, GL_FALSE, value_ptr(mvp));
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
+			app.close();
+		else if(input.get_key(GLFW_KEY_I))
+		{
+			input.key_released(GLFW_KEY_I);
+			show_instances = (show_instances + 1) % 3;
+		}
+
+		profiler.begin_phase("upload");
+		if(auto geometry{loader.take()})
+			renderer.upload(*geometry);
+
+		profiler.begin_phase("draw");
+		model = glm::rotate(glm::mat4{1.f}, std::sin(static_cast<float>(app.get_time()) * sensitivity) * 0.5f, glm::vec3{1.f, 0.f, 0.f});
+		model = glm::rotate(model, static_cast<float>(app.get_time()) * sensitivity * 1.0f, glm::vec3{0.f, 1.f, 0.f});
+		if(show_instances == 1)
+		{
+			auto index{frame++ % instances.size()};
+			instances.set(index, grid_model(index, static_cast<float>(app.get_time()) * sensitivity));
+			renderer.draw(glm::mat4{1.f}, instances);
+		}
+		else if(show_instances == 2)
+		{
+			for(size_t i{0}; i < turning.size(); ++i)
+				turning.set(i, grid_model(i, static_cast<float>(app.get_time()) * sensitivity));
+			renderer.draw(glm::mat4{1.f}, turning);
+		}
+		else
+			renderer.draw(glm::mat4{1.f}, model);
 		
-		glfwSwapBuffers(window);
+		profiler.begin_phase("swap");
+		app.swap_buffers();
 		input.unstick();
-		glfwPollEvents();
+		app.poll_events();
+		profiler.end_frame();
 	}
 
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(2, vbo);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
-	glDeleteProgram(program);
+	profiler.finish();
+	std::cout << profiler << input.get_latency();
+	if(!options.profile_path.empty())
+		profiler.write_file(options.profile_path);
 
 	return 0;
 }
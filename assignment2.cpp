@@ -4,130 +4,190 @@
 #include "soup_mesh.hpp"
 #include "half_edge_mesh.hpp"
 #include "regular_mesh.hpp"
-#include "glutil.hpp"
+#include "heightfield.hpp"
+#include "regular_mesh_pyramid.hpp"
+#include "chunked_lod.hpp"
+#include "frame_profiler.hpp"
+#include "mesh_renderer.hpp"
+#include "subdivision_worker.hpp"
 
 #include "GLFW/glfw3.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
-#include "glm/gtc/type_ptr.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <memory>
 
-int main(int /*argc*/, char** /*argv*/)
+int main(int argc, char** argv)
 {
 	using namespace cg;
+	auto options{Application::parse_options(argc, argv)};
 
-	Application app{"Assignment 2", 640, 480};
+	Application app{"Assignment 2", 640, 480, options};
 	InputManager input{};
 	app.set_input(&input);
-	GLFWwindow* window{app.get_window()};
-
-	// Calculate positions
-	std::vector<glm::vec3> positions(5*5);
-	std::array<float, 5> xys{-2.f, -1.f, 0.f, 1.f, 2.f};
-	std::array<float, 5> zs{1.f, 2.f, 5.f, 1.f, 3.f};
-	for(size_t row{0}; row < 5; ++row)
-		for(size_t col{0}; col < 5; ++col)
-			positions[row * 5 + col] = glm::vec3{xys[row], xys[col], zs[row]};
-
-	// Create mesh
-	RegularMesh mesh{5, 5, positions, {}, {}};
-	auto indices{mesh.calculate_indices()};
-
-	GLuint vao;
-	GLuint vbo[2];
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(2, vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.get_positions().size(), mesh.get_positions().data(), GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Load shader
-	auto program{glCreateProgram()};
-
-	std::string vs_path{"shaders/vertex_shader.glsl"};
-	auto vs{glCreateShader(GL_VERTEX_SHADER)};
-	glutil::load_compile_shader(vs, {vs_path});
-	glAttachShader(program, vs);
-
-	std::string fs_path{"shaders/fragment_shader.glsl"};
-	auto fs{glCreateShader(GL_FRAGMENT_SHADER)};
-	glutil::load_compile_shader(fs, {fs_path});
-	glAttachShader(program, fs);
-
-	glLinkProgram(program);
-	glUseProgram(program);
-	glDetachShader(program, vs);
-	glDetachShader(program, fs);
-
-	auto mvp_uniform{glGetUniformLocation(program, "mvp")};
-	glm::mat4 mvp{1.f};
+
+	// Load a heightfield raster given on the command line or calculate positions
+	std::unique_ptr<Heightfield> field{};
+	if(argc > 1)
+	{
+		field = std::make_unique<Heightfield>(argv[1]);
+		field->set_scale(glm::vec3{1.f / static_cast<float>(field->get_width()), 1.f / static_cast<float>(field->get_height()), .25f});
+	}
+
+	// Samples every stride-th vertex of the raster so the larger side has at most max_size vertices
+	auto load_field{[&field] (size_t max_size) {
+		auto stride{std::max(size_t{1}, (std::max(field->get_width(), field->get_height()) + max_size - 1) / max_size)};
+		return field->load_window(0, 0, (field->get_width() - 1) / stride + 1, (field->get_height() - 1) / stride + 1, stride);
+	}};
+
+	auto create_mesh{[&field, &load_field] {
+		if(field)
+			return load_field(256);
+
+		std::vector<glm::vec3> positions(5*5);
+		std::array<float, 5> xys{-2.f, -1.f, 0.f, 1.f, 2.f};
+		std::array<float, 5> zs{1.f, 2.f, 5.f, 1.f, 3.f};
+		for(size_t row{0}; row < 5; ++row)
+			for(size_t col{0}; col < 5; ++col)
+				positions[row * 5 + col] = glm::vec3{xys[row], xys[col], zs[row]};
+		return RegularMesh{5, 5, positions, {}, {}};
+	}};
+
+	// Create mesh, every subdivision level keeps its own buffers so switching levels only binds another vertex array
+	RegularMeshPyramid pyramid{create_mesh()};
+
+	// Renderers of dropped levels are kept, a later subdivision reuses their buffer storage
+	std::vector<MeshRenderer> level_renderers{};
+	auto upload_level{[&level_renderers] (size_t level, const MeshRenderer::Geometry& geometry) {
+		if(level == level_renderers.size())
+			level_renderers.emplace_back();
+		level_renderers[level].upload(geometry);
+	}};
+
+	upload_level(0, MeshRenderer::build_geometry(pyramid.get_level(0)));
+	size_t level{0};
+
+	// Subdivisions run on a worker while the current level stays on screen, C cancels them
+	SubdivisionWorker subdivision_worker{};
+	auto subdivide_level{[&pyramid, &subdivision_worker] (size_t level, RegularMesh::Scheme scheme) {
+		// Keys pressed while jobs are pending continue from the last requested level
+		if(!subdivision_worker.get_pending() || !subdivision_worker.request(scheme))
+			subdivision_worker.request(pyramid.get_level(level), level, scheme);
+	}};
+
+	// Rasters are also shown at full resolution with chunked level of detail, toggled with L
+	std::unique_ptr<ChunkedLod> terrain{};
+	MeshRenderer terrain_renderer{};
+	std::vector<GLint> base_vertices{};
+	bool show_terrain{false};
+	if(field)
+	{
+		terrain = std::make_unique<ChunkedLod>(load_field(4097));
+		terrain_renderer.upload(MeshRenderer::interleave(terrain->get_positions(), terrain->get_normals(), terrain->get_texture_coordinates()),
+			terrain->get_indices());
+	}
+
 	float sensitivity{1.f};
 
 
 	glEnable(GL_DEPTH_TEST);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	while(!glfwWindowShouldClose(window))
+	FrameProfiler profiler{512, 4, true, !options.profile_path.empty()};
+	while(!app.should_close())
 	{
+		profiler.begin_frame();
+		profiler.begin_phase("draw");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		profiler.begin_phase("input");
 		// TODO:DO STUFF
 		if(input.get_key(GLFW_KEY_1))
 		{
 			input.key_released(GLFW_KEY_1);
-			mesh.loop_subdivision();
-			indices = mesh.calculate_indices();
-
-			glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.get_positions().size(), mesh.get_positions().data(), GL_DYNAMIC_DRAW);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+			subdivide_level(level, RegularMesh::Scheme::loop);
 		}
 		else if(input.get_key(GLFW_KEY_2))
 		{
 			input.key_released(GLFW_KEY_2);
-			mesh.catmull_clark_subdivision();
-			indices = mesh.calculate_indices();
-
-			glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.get_positions().size(), mesh.get_positions().data(), GL_DYNAMIC_DRAW);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+			subdivide_level(level, RegularMesh::Scheme::catmull_clark);
 		}
 		else if(input.get_key(GLFW_KEY_3))
 		{
 			input.key_released(GLFW_KEY_3);
-			mesh.catmull_clark_subdivision_sharp_bounds();
-			indices = mesh.calculate_indices();
+			subdivide_level(level, RegularMesh::Scheme::catmull_clark_sharp_bounds);
+		}
+		else if(input.get_key(GLFW_KEY_C))
+		{
+			input.key_released(GLFW_KEY_C);
+			subdivision_worker.cancel();
+		}
+		else if(input.get_key(GLFW_KEY_MINUS))
+		{
+			input.key_released(GLFW_KEY_MINUS);
+			level = level ? level - 1 : level;
+		}
+		else if(input.get_key(GLFW_KEY_EQUAL))
+		{
+			input.key_released(GLFW_KEY_EQUAL);
+			level = std::min(level + 1, pyramid.get_level_count() - 1);
+		}
+		else if(input.get_key(GLFW_KEY_L))
+		{
+			input.key_released(GLFW_KEY_L);
+			show_terrain = terrain && !show_terrain;
+		}
 
-			glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.get_positions().size(), mesh.get_positions().data(), GL_DYNAMIC_DRAW);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+		profiler.begin_phase("update");
+		if(auto result{subdivision_worker.take()})
+		{
+			// Dropping finer levels before the new subdivision replaces them, the pyramid takes the mesh without subdividing
+			pyramid.truncate(result->level);
+			pyramid.push(std::move(result->mesh), result->scheme);
+
+			profiler.begin_phase("upload");
+			upload_level(result->level, result->geometry);
+			level = result->level;
 		}
 
-		mvp = glm::rotate(glm::mat4{1.f}, static_cast<float>(glfwGetTime()) * sensitivity, glm::vec3{0.2f, 0.4f, 0.6f});
-		glUniformMatrix4fv(mvp_uniform, 1, GL_FALSE, value_ptr(mvp));
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
+		profiler.begin_phase("draw");
+		if(show_terrain)
+		{
+			// Orbit above the center of the raster and draw the chunks selected for this view
+			int width, height;
+			app.get_framebuffer_size(width, height);
+			auto angle{static_cast<float>(app.get_time()) * sensitivity * .2f};
+			glm::vec3 center{.5f, -.5f, 0.f};
+			glm::vec3 camera{center + glm::vec3{std::cos(angle) * .6f, std::sin(angle) * .6f, .3f}};
+			auto field_of_view{glm::radians(60.f)};
+			auto view_projection{glm::perspective(field_of_view, static_cast<float>(width) / height, .001f, 10.f) * glm::lookAt(camera, center, glm::vec3{0.f, 0.f, 1.f})};
+
+			base_vertices.clear();
+			for(auto index : terrain->select({camera, static_cast<float>(height), field_of_view}, Frustum{view_projection}, 1.f, 2000000))
+				base_vertices.push_back(terrain->get_nodes()[index].base_vertex);
+			terrain_renderer.draw(view_projection, glm::mat4{1.f}, base_vertices);
+		}
+		else
+		{
+			auto model{glm::rotate(glm::mat4{1.f}, static_cast<float>(app.get_time()) * sensitivity, glm::vec3{0.2f, 0.4f, 0.6f})};
+			level_renderers[level].draw(glm::mat4{1.f}, model);
+		}
 		
-		glfwSwapBuffers(window);
+		profiler.begin_phase("swap");
+		app.swap_buffers();
 		input.unstick();
-		glfwPollEvents();
+		app.poll_events();
+		profiler.end_frame();
 	}
 
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(2, vbo);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
-	glDeleteProgram(program);
+	profiler.finish();
+	std::cout << profiler << input.get_latency();
+	if(!options.profile_path.empty())
+		profiler.write_file(options.profile_path);
 
 	return 0;
 }
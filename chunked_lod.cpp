@@ -0,0 +1,266 @@
+#include "chunked_lod.hpp"
+
+#include "grid_indices.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace cg
+{
+	ChunkedLod::ChunkedLod(const RegularMesh& mesh, size_t chunk_size)
+		: chunk_size{chunk_size}
+	{
+		auto width{mesh.get_width()};
+		auto height{mesh.get_height()};
+		if(chunk_size < 3 || ((chunk_size - 1) & (chunk_size - 2)) != 0 || width < 2 || height < 2)
+		{
+			std::cerr << "ChunkedLod: Chunk size " << chunk_size << " is not 2^k + 1 or the " << width << "x" << height << " mesh is too small\n";
+			throw std::invalid_argument{"ChunkedLod: Construction failed."};
+		}
+
+		// Build the quadtree bottom up, a node of level l covers quads * 2^l quads per side
+		auto quads{chunk_size - 1};
+		std::vector<int> level{};
+		size_t level_cols{(width - 2) / quads + 1};
+		size_t level_rows{(height - 2) / quads + 1};
+		size_t child_cols{0};
+		size_t child_rows{0};
+		for(size_t stride{1}; ; stride *= 2)
+		{
+			std::vector<int> next(level_cols * level_rows);
+			for(size_t row{0}; row < level_rows; ++row)
+			{
+				for(size_t col{0}; col < level_cols; ++col)
+				{
+					Node node{col * quads * stride, row * quads * stride, stride, 0.f, {}, {}, 0, {-1, -1, -1, -1}};
+					for(size_t k{0}; k < 4 && stride > 1; ++k)
+					{
+						auto child_col{col * 2 + k % 2};
+						auto child_row{row * 2 + k / 2};
+						if(child_col < child_cols && child_row < child_rows)
+							node.children[k] = level[child_row * child_cols + child_col];
+					}
+					next[row * level_cols + col] = static_cast<int>(nodes.size());
+					nodes.push_back(node);
+				}
+			}
+
+			level = std::move(next);
+			if(level_cols == 1 && level_rows == 1)
+				break;
+			child_cols = level_cols;
+			child_rows = level_rows;
+			level_cols = (level_cols + 1) / 2;
+			level_rows = (level_rows + 1) / 2;
+		}
+		root = nodes.size() - 1;
+
+		auto vertices_per_chunk{(chunk_size + 2) * (chunk_size + 2)};
+		if(nodes.size() * vertices_per_chunk > static_cast<size_t>(std::numeric_limits<int>::max()))
+		{
+			std::cerr << "ChunkedLod: " << nodes.size() << " chunks exceed the range of base vertices\n";
+			throw std::invalid_argument{"ChunkedLod: Construction failed."};
+		}
+
+		const auto& mesh_positions{mesh.get_positions()};
+		const auto& mesh_normals{mesh.get_normals()};
+		const auto& mesh_texture_coordinates{mesh.get_texture_coordinates()};
+		auto at{[width, height] (size_t col, size_t row) { return std::min(row, height - 1) * width + std::min(col, width - 1); }};
+
+		// Distance of the mesh vertices inside a node from the triangles of its decimated grid
+		ThreadPool::get_global().parallel_for(0, nodes.size(), 1, [&] (size_t begin, size_t end) {
+			for(auto index{begin}; index < end; ++index)
+			{
+				auto& node{nodes[index]};
+				if(node.stride == 1)
+					continue;
+
+				auto last_col{std::min(node.col + quads * node.stride, width - 1)};
+				auto last_row{std::min(node.row + quads * node.stride, height - 1)};
+				float error{0.f};
+				for(auto row{node.row}; row <= last_row; ++row)
+				{
+					auto row0{node.row + (row - node.row) / node.stride * node.stride};
+					auto row1{std::min(row0 + node.stride, height - 1)};
+					auto t{row1 > row0 ? static_cast<float>(row - row0) / static_cast<float>(row1 - row0) : 0.f};
+					for(auto col{node.col}; col <= last_col; ++col)
+					{
+						auto col0{node.col + (col - node.col) / node.stride * node.stride};
+						auto col1{std::min(col0 + node.stride, width - 1)};
+						auto s{col1 > col0 ? static_cast<float>(col - col0) / static_cast<float>(col1 - col0) : 0.f};
+
+						// Triangles (row0, col0), (row1, col0), (row1, col1) and (row0, col0), (row1, col1), (row0, col1)
+						const auto& p00{mesh_positions[at(col0, row0)]};
+						const auto& p10{mesh_positions[at(col0, row1)]};
+						const auto& p11{mesh_positions[at(col1, row1)]};
+						const auto& p01{mesh_positions[at(col1, row0)]};
+						auto drawn{t >= s ? p00 + t * (p10 - p00) + s * (p11 - p10) : p00 + s * (p01 - p00) + t * (p11 - p01)};
+						error = std::max(error, glm::length(mesh_positions[at(col, row)] - drawn));
+					}
+				}
+				node.error = error;
+			}
+		});
+
+		// Children come before their parents
+		for(auto& node : nodes)
+			for(auto child : node.children)
+				if(child >= 0)
+					node.error = std::max(node.error, nodes[child].error);
+
+		// A gap between two chunks is at most the error of the coarser one, so the largest error covers all seams
+		auto skirt_depth{nodes[root].error};
+		auto down{[&] (size_t col, size_t row) {
+			auto du{mesh_positions[at(col + 1, row)] - mesh_positions[at(col ? col - 1 : 0, row)]};
+			auto dv{mesh_positions[at(col, row + 1)] - mesh_positions[at(col, row ? row - 1 : 0)]};
+			auto normal{glm::cross(dv, du)};
+			auto length{glm::length(normal)};
+			return length > 0.f ? -normal / length : glm::vec3{0.f, 0.f, -1.f};
+		}};
+
+		positions.resize(nodes.size() * vertices_per_chunk);
+		normals.resize(positions.size());
+		texture_coordinates.resize(positions.size());
+		ThreadPool::get_global().parallel_for(0, nodes.size(), 1, [&] (size_t begin, size_t end) {
+			for(auto index{begin}; index < end; ++index)
+			{
+				auto& node{nodes[index]};
+				node.base_vertex = static_cast<int>(index * vertices_per_chunk);
+				node.bounds_min = glm::vec3{std::numeric_limits<float>::max()};
+				node.bounds_max = glm::vec3{std::numeric_limits<float>::lowest()};
+
+				// The outer ring repeats the border vertices moved down by the skirt depth
+				auto vertex{static_cast<size_t>(node.base_vertex)};
+				for(size_t i{0}; i < chunk_size + 2; ++i)
+				{
+					auto row{node.row + (std::clamp(i, size_t{1}, chunk_size) - 1) * node.stride};
+					for(size_t j{0}; j < chunk_size + 2; ++j, ++vertex)
+					{
+						auto col{node.col + (std::clamp(j, size_t{1}, chunk_size) - 1) * node.stride};
+						auto sample{at(col, row)};
+						positions[vertex] = mesh_positions[sample];
+						if(i == 0 || j == 0 || i == chunk_size + 1 || j == chunk_size + 1)
+							positions[vertex] += down(std::min(col, width - 1), std::min(row, height - 1)) * skirt_depth;
+						normals[vertex] = mesh_normals[sample];
+						texture_coordinates[vertex] = mesh_texture_coordinates[sample];
+
+						node.bounds_min = glm::min(node.bounds_min, positions[vertex]);
+						node.bounds_max = glm::max(node.bounds_max, positions[vertex]);
+					}
+				}
+			}
+		});
+
+		indices = grid_indices::triangles(chunk_size + 2, chunk_size + 2);
+		selection.push_back(root);
+
+		std::cout << "ChunkedLod: Built " << nodes.size() << " chunks of " << chunk_size << "x" << chunk_size << " vertices, largest error " << skirt_depth << '\n';
+	}
+
+	const std::vector<size_t>& ChunkedLod::select(const View& view, float pixel_tolerance, size_t max_triangles)
+	{
+		return select(view, nullptr, pixel_tolerance, max_triangles);
+	}
+
+	const std::vector<size_t>& ChunkedLod::select(const View& view, const Frustum& frustum, float pixel_tolerance, size_t max_triangles)
+	{
+		return select(view, &frustum, pixel_tolerance, max_triangles);
+	}
+
+	const std::vector<size_t>& ChunkedLod::select(const View& view, const Frustum* frustum, float pixel_tolerance, size_t max_triangles)
+	{
+		selection.clear();
+		auto visible{[this, frustum] (size_t index) {
+			return !frustum || frustum->intersects(nodes[index].bounds_min, nodes[index].bounds_max);
+		}};
+		if(!visible(root))
+			return selection;
+
+		auto chunk_triangles{get_triangles_per_chunk()};
+		auto triangles{chunk_triangles};
+
+		std::priority_queue<std::pair<float, size_t>> queue{};
+		queue.push({screen_space_error(nodes[root], view), root});
+		while(!queue.empty())
+		{
+			auto [error, index]{queue.top()};
+			queue.pop();
+
+			const auto& node{nodes[index]};
+			std::array<size_t, 4> children{};
+			size_t child_count{0};
+			for(auto child : node.children)
+				if(child >= 0 && visible(static_cast<size_t>(child)))
+					children[child_count++] = static_cast<size_t>(child);
+
+			// A node with all children culled is only visible through its skirt and stays as it is
+			if(error > pixel_tolerance && child_count && triangles + (child_count - 1) * chunk_triangles <= max_triangles)
+			{
+				triangles += (child_count - 1) * chunk_triangles;
+				for(size_t i{0}; i < child_count; ++i)
+					queue.push({screen_space_error(nodes[children[i]], view), children[i]});
+			}
+			else
+			{
+				selection.push_back(index);
+			}
+		}
+		return selection;
+	}
+
+	const std::vector<ChunkedLod::Node>& ChunkedLod::get_nodes() const
+	{
+		return nodes;
+	}
+
+	const std::vector<size_t>& ChunkedLod::get_selection() const
+	{
+		return selection;
+	}
+
+	size_t ChunkedLod::get_chunk_size() const
+	{
+		return chunk_size;
+	}
+
+	size_t ChunkedLod::get_triangles_per_chunk() const
+	{
+		return indices->size() / 3;
+	}
+
+	const std::vector<glm::vec3>& ChunkedLod::get_positions() const
+	{
+		return positions;
+	}
+
+	const std::vector<glm::vec3>& ChunkedLod::get_normals() const
+	{
+		return normals;
+	}
+
+	const std::vector<glm::vec2>& ChunkedLod::get_texture_coordinates() const
+	{
+		return texture_coordinates;
+	}
+
+	const std::vector<unsigned int>& ChunkedLod::get_indices() const
+	{
+		return *indices;
+	}
+
+	float ChunkedLod::screen_space_error(const Node& node, const View& view) const
+	{
+		auto closest{glm::clamp(view.camera_position, node.bounds_min, node.bounds_max)};
+		auto distance{glm::length(view.camera_position - closest)};
+		if(distance <= 0.f)
+			return std::numeric_limits<float>::max();
+
+		return node.error * view.viewport_height / (2.f * std::tan(view.field_of_view / 2.f) * distance);
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef CHUNKED_LOD_HPP
+#define CHUNKED_LOD_HPP
+
+#include "frustum.hpp"
+#include "regular_mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace cg
+{
+	/// Chunked level of detail for large RegularMeshes. The grid is split into a quadtree of chunks with chunk_size x chunk_size
+	/// vertices each, a node one level up covers twice the area with every second vertex. Every chunk has a skirt that hangs
+	/// down along its border, so seams between chunks of different levels are covered without stitching. All chunks share
+	/// one index buffer and are drawn with glDrawElementsBaseVertex from the concatenated vertex arrays.
+	class ChunkedLod
+	{
+		public:
+			struct Node
+			{
+				size_t col;
+				size_t row;
+				size_t stride;
+				/// Largest distance of a mesh vertex inside the node from the triangles drawn for it, including all descendants.
+				float error;
+				glm::vec3 bounds_min;
+				glm::vec3 bounds_max;
+				int base_vertex;
+				/// Indices into get_nodes(), -1 for missing children, leaves have none.
+				std::array<int, 4> children;
+			};
+
+			struct View
+			{
+				glm::vec3 camera_position;
+				float viewport_height;
+				/// Vertical field of view in radians.
+				float field_of_view;
+			};
+
+			/// chunk_size has to be 2^k + 1 with k >= 1. Throws invalid_argument otherwise or for meshes smaller than 2x2.
+			explicit ChunkedLod(const RegularMesh& mesh, size_t chunk_size = 65);
+
+			/// Refines the quadtree from the root, always splitting the node with the largest screen space error, until all
+			/// nodes are within pixel_tolerance or splitting would exceed max_triangles. Returns indices into get_nodes().
+			const std::vector<size_t>& select(const View& view, float pixel_tolerance, size_t max_triangles);
+			/// Same as select, but nodes outside of frustum are dropped and neither refined nor counted against max_triangles.
+			const std::vector<size_t>& select(const View& view, const Frustum& frustum, float pixel_tolerance, size_t max_triangles);
+
+			const std::vector<Node>& get_nodes() const;
+			const std::vector<size_t>& get_selection() const;
+			size_t get_chunk_size() const;
+			size_t get_triangles_per_chunk() const;
+
+			/// Vertices of all chunks, each chunk has (chunk_size + 2)^2 vertices including its skirt ring.
+			const std::vector<glm::vec3>& get_positions() const;
+			const std::vector<glm::vec3>& get_normals() const;
+			const std::vector<glm::vec2>& get_texture_coordinates() const;
+			/// Triangle list of one chunk, relative to its base vertex.
+			const std::vector<unsigned int>& get_indices() const;
+
+		private:
+			const std::vector<size_t>& select(const View& view, const Frustum* frustum, float pixel_tolerance, size_t max_triangles);
+			float screen_space_error(const Node& node, const View& view) const;
+
+			size_t chunk_size;
+			std::vector<Node> nodes;
+			size_t root{0};
+			std::vector<size_t> selection;
+
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> normals;
+			std::vector<glm::vec2> texture_coordinates;
+			std::shared_ptr<const std::vector<unsigned int>> indices;
+	};
+}
+
+#endif // CHUNKED_LOD_HPP
@@ -0,0 +1,354 @@
+#include "frame_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace cg
+{
+	namespace
+	{
+		constexpr float missing{std::numeric_limits<float>::quiet_NaN()};
+
+		double milliseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		void accumulate(float& time, double milliseconds)
+		{
+			time = static_cast<float>((std::isnan(time) ? 0. : time) + milliseconds);
+		}
+
+		/// Appends value for a new slot or overwrites the slot of a frame that left the history window.
+		template<typename T>
+		void reset(std::vector<T>& values, size_t slot, T value)
+		{
+			if(slot == values.size())
+				values.push_back(value);
+			else
+				values[slot] = value;
+		}
+
+		void write_json_statistics(std::ostream& stream, const FrameProfiler::Statistics& statistics)
+		{
+			stream << "{\"samples\":" << statistics.samples << ",\"mean\":" << statistics.mean << ",\"p50\":" << statistics.p50
+				<< ",\"p95\":" << statistics.p95 << ",\"p99\":" << statistics.p99 << '}';
+		}
+	}
+
+	FrameProfiler::FrameProfiler(size_t history, size_t query_latency, bool gpu, bool keep_all)
+		: history{std::max(history, size_t{1})},
+		  gpu{gpu},
+		  keep_all{keep_all},
+		  capacity{this->history + std::max(query_latency, size_t{1})},
+		  ring(std::max(query_latency, size_t{1}))
+	{
+		phases.push_back({frame_phase, {}, {}});
+	}
+
+	FrameProfiler::~FrameProfiler()
+	{
+		if(!gpu)
+			return;
+
+		for(const auto& queries : ring)
+			for(const auto& query : queries)
+				glDeleteQueries(1, &query.query);
+	}
+
+	void FrameProfiler::begin_frame()
+	{
+		if(in_frame)
+			end_frame();
+
+		// The queries of this slot were issued query_latency frames ago
+		collect(ring[frame % ring.size()], false);
+		slot_query = 0;
+
+		auto index{slot(frame)};
+		for(auto& phase : phases)
+		{
+			reset(phase.cpu, index, missing);
+			reset(phase.gpu, index, missing);
+		}
+		reset(incomplete_frames, index, false);
+		in_frame = true;
+		frame_start = Clock::now();
+	}
+
+	void FrameProfiler::begin_phase(const std::string& name)
+	{
+		if(!in_frame)
+			begin_frame();
+
+		auto now{Clock::now()};
+		end_phase(now);
+		current_phase = get_or_add_phase(name);
+		in_phase = true;
+
+		if(gpu)
+		{
+			auto& queries{ring[frame % ring.size()]};
+			if(slot_query == queries.size())
+			{
+				queries.push_back({0, 0, 0, false});
+				glGenQueries(1, &queries.back().query);
+			}
+
+			auto& query{queries[slot_query++]};
+			query.frame = frame;
+			query.phase = current_phase;
+			query.pending = true;
+			glBeginQuery(GL_TIME_ELAPSED, query.query);
+		}
+		phase_start = Clock::now();
+	}
+
+	void FrameProfiler::end_frame()
+	{
+		if(!in_frame)
+			return;
+
+		auto now{Clock::now()};
+		end_phase(now);
+		phases.front().cpu[slot(frame)] = static_cast<float>(milliseconds(now - frame_start));
+		in_frame = false;
+		++frame;
+	}
+
+	void FrameProfiler::finish()
+	{
+		end_frame();
+		for(auto& queries : ring)
+			collect(queries, true);
+	}
+
+	size_t FrameProfiler::get_frame_count() const
+	{
+		return frame;
+	}
+
+	size_t FrameProfiler::get_dropped_queries() const
+	{
+		return dropped_queries;
+	}
+
+	size_t FrameProfiler::get_first_frame() const
+	{
+		return keep_all ? 0 : frame - std::min(frame, history);
+	}
+
+	std::vector<std::string> FrameProfiler::get_phases() const
+	{
+		std::vector<std::string> names{};
+		for(const auto& phase : phases)
+			names.push_back(phase.name);
+		return names;
+	}
+
+	FrameProfiler::Statistics FrameProfiler::get_cpu_statistics(const std::string& phase) const
+	{
+		return statistics(phases[find_phase(phase)].cpu);
+	}
+
+	FrameProfiler::Statistics FrameProfiler::get_gpu_statistics(const std::string& phase) const
+	{
+		return statistics(phases[find_phase(phase)].gpu);
+	}
+
+	void FrameProfiler::write_csv(std::ostream& stream) const
+	{
+		stream << "frame,phase,cpu_ms,gpu_ms\n";
+		for(auto f{get_first_frame()}; f < frame; ++f)
+		{
+			auto index{slot(f)};
+			for(const auto& phase : phases)
+			{
+				if(std::isnan(phase.cpu[index]))
+					continue;
+
+				stream << f << ',' << phase.name << ',' << phase.cpu[index] << ',';
+				if(!std::isnan(phase.gpu[index]))
+					stream << phase.gpu[index];
+				stream << '\n';
+			}
+		}
+	}
+
+	void FrameProfiler::write_json(std::ostream& stream) const
+	{
+		auto write_times{[this, &stream] (const std::vector<float>& times) {
+			stream << '[';
+			for(auto f{get_first_frame()}; f < frame; ++f)
+			{
+				auto time{times[slot(f)]};
+				stream << (f != get_first_frame() ? "," : "");
+				if(std::isnan(time))
+					stream << "null";
+				else
+					stream << time;
+			}
+			stream << ']';
+		}};
+
+		stream << "{\"frames\":" << frame << ",\"first_frame\":" << get_first_frame() << ",\"history\":" << history
+			<< ",\"dropped_queries\":" << dropped_queries << ",\"phases\":[";
+		for(size_t i{0}; i < phases.size(); ++i)
+		{
+			const auto& phase{phases[i]};
+			stream << (i ? "," : "") << "{\"name\":\"" << phase.name << "\",\"cpu\":";
+			write_json_statistics(stream, statistics(phase.cpu));
+			stream << ",\"gpu\":";
+			write_json_statistics(stream, statistics(phase.gpu));
+			stream << ",\"cpu_ms\":";
+			write_times(phase.cpu);
+			stream << ",\"gpu_ms\":";
+			write_times(phase.gpu);
+			stream << '}';
+		}
+		stream << "]}";
+	}
+
+	void FrameProfiler::write_file(const std::string& file_path) const
+	{
+		std::ofstream file{file_path};
+		if(!file)
+		{
+			std::cerr << "FrameProfiler: Could not open " << file_path << " for writing\n";
+			throw std::runtime_error{"FrameProfiler: Writing file failed."};
+		}
+
+		auto json{file_path.size() >= 5 && file_path.compare(file_path.size() - 5, 5, ".json") == 0};
+		if(json)
+			write_json(file);
+		else
+			write_csv(file);
+		std::cout << "FrameProfiler: Wrote " << frame - get_first_frame() << " frames to " << file_path << '\n';
+	}
+
+	size_t FrameProfiler::slot(size_t f) const
+	{
+		return keep_all ? f : f % capacity;
+	}
+
+	size_t FrameProfiler::find_phase(const std::string& name) const
+	{
+		for(size_t i{0}; i < phases.size(); ++i)
+			if(phases[i].name == name)
+				return i;
+
+		throw std::out_of_range{"FrameProfiler: Unknown phase " + name + "."};
+	}
+
+	size_t FrameProfiler::get_or_add_phase(const std::string& name)
+	{
+		for(size_t i{0}; i < phases.size(); ++i)
+			if(phases[i].name == name)
+				return i;
+
+		// Covers the slots used so far including the current frame
+		auto slots{incomplete_frames.size()};
+		phases.push_back({name, std::vector<float>(slots, missing), std::vector<float>(slots, missing)});
+		return phases.size() - 1;
+	}
+
+	void FrameProfiler::end_phase(Clock::time_point now)
+	{
+		if(!in_phase)
+			return;
+
+		accumulate(phases[current_phase].cpu[slot(frame)], milliseconds(now - phase_start));
+		if(gpu)
+			glEndQuery(GL_TIME_ELAPSED);
+		in_phase = false;
+	}
+
+	void FrameProfiler::collect(std::vector<Query>& queries, bool wait)
+	{
+		if(!gpu)
+			return;
+
+		for(auto& query : queries)
+		{
+			if(!query.pending)
+				continue;
+
+			query.pending = false;
+			GLint available{GL_TRUE};
+			if(!wait)
+				glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available)
+			{
+				// Drop the result rather than stall, the frame time stays incomplete
+				++dropped_queries;
+				incomplete_frames[slot(query.frame)] = true;
+				phases.front().gpu[slot(query.frame)] = missing;
+				continue;
+			}
+
+			GLuint64 nanoseconds{0};
+			glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+			auto index{slot(query.frame)};
+			accumulate(phases[query.phase].gpu[index], static_cast<double>(nanoseconds) / 1e6);
+			if(!incomplete_frames[index])
+				accumulate(phases.front().gpu[index], static_cast<double>(nanoseconds) / 1e6);
+		}
+	}
+
+	FrameProfiler::Statistics FrameProfiler::statistics(const std::vector<float>& times) const
+	{
+		std::vector<float> window{};
+		for(auto f{frame - std::min(frame, history)}; f < frame; ++f)
+			if(!std::isnan(times[slot(f)]))
+				window.push_back(times[slot(f)]);
+
+		Statistics result{};
+		result.samples = window.size();
+		if(window.empty())
+			return result;
+
+		std::sort(window.begin(), window.end());
+		double sum{0.};
+		for(auto time : window)
+			sum += time;
+		result.mean = sum / static_cast<double>(window.size());
+
+		// Nearest rank percentiles
+		auto percentile{[&window] (double p) {
+			auto rank{static_cast<size_t>(std::ceil(p * static_cast<double>(window.size())))};
+			return static_cast<double>(window[std::clamp(rank, size_t{1}, window.size()) - 1]);
+		}};
+		result.p50 = percentile(.50);
+		result.p95 = percentile(.95);
+		result.p99 = percentile(.99);
+		return result;
+	}
+
+	std::ostream& operator<<(std::ostream& stream, const FrameProfiler& profiler)
+	{
+		stream << "Frame profile of " << profiler.get_frame_count() << " frames in milliseconds:\n"
+			<< "  " << std::left << std::setw(12) << "phase" << std::right
+			<< std::setw(10) << "cpu p50" << std::setw(10) << "cpu p95" << std::setw(10) << "cpu p99"
+			<< std::setw(10) << "gpu p50" << std::setw(10) << "gpu p95" << std::setw(10) << "gpu p99" << '\n';
+
+		auto precision{stream.precision()};
+		stream << std::fixed << std::setprecision(3);
+		for(const auto& phase : profiler.get_phases())
+		{
+			auto cpu{profiler.get_cpu_statistics(phase)};
+			auto gpu{profiler.get_gpu_statistics(phase)};
+			stream << "  " << std::left << std::setw(12) << phase << std::right
+				<< std::setw(10) << cpu.p50 << std::setw(10) << cpu.p95 << std::setw(10) << cpu.p99
+				<< std::setw(10) << gpu.p50 << std::setw(10) << gpu.p95 << std::setw(10) << gpu.p99 << '\n';
+		}
+		stream << std::defaultfloat << std::setprecision(precision);
+		if(profiler.get_dropped_queries())
+			stream << "  " << profiler.get_dropped_queries() << " GPU queries were not ready in time\n";
+		return stream;
+	}
+}
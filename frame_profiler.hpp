@@ -0,0 +1,115 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include "GL/glew.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cg
+{
+	/// Measures the CPU and GPU time of the named phases of every frame. GPU times come from GL_TIME_ELAPSED queries
+	/// that are read back query_latency frames later and only if their result is available, so the profiler never
+	/// waits for the GPU. Phases follow each other, a phase ends when the next one begins or the frame ends.
+	/// Only the frames of the history window are kept unless keep_all is set, for example to write a whole profile.
+	class FrameProfiler
+	{
+		public:
+			/// Percentiles in milliseconds over the last frames of the history window.
+			struct Statistics
+			{
+				size_t samples{0};
+				double mean{0.};
+				double p50{0.};
+				double p95{0.};
+				double p99{0.};
+			};
+
+			/// Name of the pseudo phase that spans from begin_frame to end_frame.
+			static constexpr const char* frame_phase{"frame"};
+
+			/// Without gpu no OpenGL calls are made, the profiler then works without a context.
+			explicit FrameProfiler(size_t history = 512, size_t query_latency = 4, bool gpu = true, bool keep_all = false);
+			~FrameProfiler();
+
+			FrameProfiler(const FrameProfiler&) = delete;
+			FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+			void begin_frame();
+			void begin_phase(const std::string& name);
+			void end_frame();
+
+			/// Waits for all outstanding queries, call before reading the final GPU times.
+			void finish();
+
+			size_t get_frame_count() const;
+			/// GPU results that were still pending when their query had to be reused.
+			size_t get_dropped_queries() const;
+			std::vector<std::string> get_phases() const;
+			Statistics get_cpu_statistics(const std::string& phase) const;
+			Statistics get_gpu_statistics(const std::string& phase) const;
+
+			/// First frame that is still kept, 0 with keep_all.
+			size_t get_first_frame() const;
+
+			/// One row per kept frame and phase with the CPU and GPU milliseconds, missing GPU times are empty.
+			void write_csv(std::ostream& stream) const;
+			/// Statistics of every phase and the times of the kept frames.
+			void write_json(std::ostream& stream) const;
+			/// Writes JSON for paths ending in .json and CSV otherwise.
+			void write_file(const std::string& file_path) const;
+
+		private:
+			using Clock = std::chrono::steady_clock;
+
+			struct Phase
+			{
+				std::string name;
+				/// Milliseconds per frame slot, NaN where the phase did not run or the GPU time is missing.
+				std::vector<float> cpu;
+				std::vector<float> gpu;
+			};
+
+			struct Query
+			{
+				GLuint query;
+				size_t frame;
+				size_t phase;
+				bool pending;
+			};
+
+			/// Index of frame f in the per frame vectors.
+			size_t slot(size_t f) const;
+			size_t find_phase(const std::string& name) const;
+			size_t get_or_add_phase(const std::string& name);
+			void end_phase(Clock::time_point now);
+			void collect(std::vector<Query>& queries, bool wait);
+			Statistics statistics(const std::vector<float>& times) const;
+
+			size_t history;
+			bool gpu;
+			bool keep_all;
+			/// Frame slots without keep_all, the history window plus the frames whose queries may still be pending.
+			size_t capacity;
+			std::vector<Phase> phases;
+			/// Queries of the frames in flight, frame f uses slot f % query_latency.
+			std::vector<std::vector<Query>> ring;
+			size_t slot_query{0};
+
+			size_t frame{0};
+			bool in_frame{false};
+			size_t current_phase{0};
+			bool in_phase{false};
+			Clock::time_point frame_start;
+			Clock::time_point phase_start;
+			size_t dropped_queries{0};
+			/// Frames with a dropped query have no total GPU time.
+			std::vector<bool> incomplete_frames;
+	};
+
+	std::ostream& operator<<(std::ostream& stream, const FrameProfiler& profiler);
+}
+
+#endif // FRAME_PROFILER_HPP
@@ -0,0 +1,106 @@
+#include "frustum.hpp"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace cg
+{
+	namespace
+	{
+		/// Signed distance of the corner farthest along the plane normal, scaled by the normal length.
+		/// Summed in the same order as the SSE path, so both agree on every box.
+		float farthest_distance(const glm::vec4& plane, float x, float y, float z)
+		{
+			return (x * plane.x + y * plane.y) + (z * plane.z + plane.w);
+		}
+	}
+
+	void Frustum::Boxes::add(const glm::vec3& min, const glm::vec3& max)
+	{
+		min_x.push_back(min.x);
+		min_y.push_back(min.y);
+		min_z.push_back(min.z);
+		max_x.push_back(max.x);
+		max_y.push_back(max.y);
+		max_z.push_back(max.z);
+	}
+
+	void Frustum::Boxes::clear()
+	{
+		for(auto* values : {&min_x, &min_y, &min_z, &max_x, &max_y, &max_z})
+			values->clear();
+	}
+
+	size_t Frustum::Boxes::size() const
+	{
+		return min_x.size();
+	}
+
+	Frustum::Frustum(const glm::mat4& view_projection)
+	{
+		// Rows of the matrix, a clip space point is inside for -w <= x, y, z <= w
+		auto row{[&view_projection] (int i) {
+			return glm::vec4{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+		}};
+		planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+	}
+
+	const std::array<glm::vec4, 6>& Frustum::get_planes() const
+	{
+		return planes;
+	}
+
+	bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const
+	{
+		for(const auto& plane : planes)
+		{
+			if(farthest_distance(plane, plane.x >= 0.f ? max.x : min.x, plane.y >= 0.f ? max.y : min.y, plane.z >= 0.f ? max.z : min.z) < 0.f)
+				return false;
+		}
+		return true;
+	}
+
+	void Frustum::cull(const Boxes& boxes, std::vector<unsigned int>& visible) const
+	{
+		size_t i{0};
+#ifdef __SSE__
+		// The farthest corner only depends on the plane, so every plane picks whole coordinate arrays
+		const float* xs[6];
+		const float* ys[6];
+		const float* zs[6];
+		__m128 coefficients[6][4];
+		for(size_t p{0}; p < planes.size(); ++p)
+		{
+			const auto& plane{planes[p]};
+			xs[p] = (plane.x >= 0.f ? boxes.max_x : boxes.min_x).data();
+			ys[p] = (plane.y >= 0.f ? boxes.max_y : boxes.min_y).data();
+			zs[p] = (plane.z >= 0.f ? boxes.max_z : boxes.min_z).data();
+			for(int k{0}; k < 4; ++k)
+				coefficients[p][k] = _mm_set1_ps(plane[k]);
+		}
+
+		auto zero{_mm_setzero_ps()};
+		for(; i + 4 <= boxes.size(); i += 4)
+		{
+			auto outside{_mm_setzero_ps()};
+			for(size_t p{0}; p < planes.size(); ++p)
+			{
+				auto xy{_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs[p] + i), coefficients[p][0]), _mm_mul_ps(_mm_loadu_ps(ys[p] + i), coefficients[p][1]))};
+				auto zw{_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(zs[p] + i), coefficients[p][2]), coefficients[p][3])};
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(xy, zw), zero));
+			}
+
+			auto inside{~_mm_movemask_ps(outside) & 0xf};
+			for(unsigned int k{0}; k < 4; ++k)
+				if(inside & (1 << k))
+					visible.push_back(static_cast<unsigned int>(i) + k);
+		}
+#endif
+		for(; i < boxes.size(); ++i)
+		{
+			if(intersects({boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]}, {boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]}))
+				visible.push_back(static_cast<unsigned int>(i));
+		}
+	}
+}
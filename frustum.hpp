@@ -0,0 +1,48 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace cg
+{
+	/// View frustum as six planes extracted from a view projection matrix, points p with dot(plane, vec4(p, 1)) >= 0 for
+	/// every plane are inside. Boxes are tested in the space the matrix maps from, e.g. model space for a model view projection.
+	class Frustum
+	{
+		public:
+			/// Axis aligned boxes in structure of arrays layout, so cull can test several at once.
+			struct Boxes
+			{
+				std::vector<float> min_x;
+				std::vector<float> min_y;
+				std::vector<float> min_z;
+				std::vector<float> max_x;
+				std::vector<float> max_y;
+				std::vector<float> max_z;
+
+				void add(const glm::vec3& min, const glm::vec3& max);
+				void clear();
+				size_t size() const;
+			};
+
+			explicit Frustum(const glm::mat4& view_projection);
+
+			const std::array<glm::vec4, 6>& get_planes() const;
+
+			/// False if the box is completely outside of one plane. Conservative, boxes near the edges of the frustum
+			/// may be reported as intersecting although they are outside.
+			bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+			/// Appends the indices of all boxes that intersect to visible in ascending order, the same boxes intersects accepts.
+			/// Tests four boxes at a time with SSE when available.
+			void cull(const Boxes& boxes, std::vector<unsigned int>& visible) const;
+
+		private:
+			std::array<glm::vec4, 6> planes;
+	};
+}
+
+#endif // FRUSTUM_HPP
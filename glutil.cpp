@@ -3,20 +3,30 @@
 #include <fstream>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 namespace cg
 {
+	std::string glutil::read_file(const std::string& file_path)
+	{
+		std::ifstream ifs{file_path, std::ios::binary | std::ios::ate};
+		if(!ifs)
+		{
+			std::cerr << "GLUtil: Could not open " << file_path << '\n';
+			throw std::runtime_error("Failed to read file.");
+		}
+
+		std::string contents(static_cast<size_t>(ifs.tellg()), '\0');
+		ifs.seekg(0);
+		ifs.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+		return contents;
+	}
+
 	void glutil::load_compile_shader(GLuint id, const std::vector<std::string>& file_paths)
 	{
 		std::vector<std::string> sources{};
 		for(const auto& path : file_paths)
-		{
-			sources.emplace_back();
-			std::ifstream ifs{path};
-			std::copy(std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{},
-					std::back_inserter(sources.back()));
-			sources.back().push_back('\0');
-		}
+			sources.push_back(read_file(path));
 		std::vector<const char*> source_ptrs{};
 		std::transform(sources.begin(), sources.end(), std::back_inserter(source_ptrs),
 				[] (const auto& source) { return source.c_str(); });
@@ -8,6 +8,9 @@
 
 namespace cg::glutil
 {
+	/// Reads the whole file in one go, throws runtime_error if it cannot be opened.
+	std::string read_file(const std::string& file_path);
+
 	void load_compile_shader(GLuint id, const std::vector<std::string>& file_paths);
 }
 
@@ -0,0 +1,238 @@
+#include "gpu_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace cg
+{
+	GpuBuffer::GpuBuffer(GLenum target, GLenum usage)
+		: target{target},
+		  usage{usage}
+	{
+		glGenBuffers(1, &id);
+	}
+
+	GpuBuffer::~GpuBuffer()
+	{
+		if(id)
+			glDeleteBuffers(1, &id);
+	}
+
+	GpuBuffer::GpuBuffer(GpuBuffer&& other) noexcept
+		: id{std::exchange(other.id, 0)},
+		  target{other.target},
+		  usage{other.usage},
+		  size{std::exchange(other.size, 0)},
+		  capacity{std::exchange(other.capacity, 0)},
+		  allocations{std::exchange(other.allocations, 0)}
+	{
+	}
+
+	GpuBuffer& GpuBuffer::operator=(GpuBuffer&& other) noexcept
+	{
+		std::swap(id, other.id);
+		std::swap(target, other.target);
+		std::swap(usage, other.usage);
+		std::swap(size, other.size);
+		std::swap(capacity, other.capacity);
+		std::swap(allocations, other.allocations);
+		return *this;
+	}
+
+	void GpuBuffer::upload(const void* data, size_t bytes)
+	{
+		if(bytes > capacity)
+			allocate(std::max(bytes, capacity * 2));
+		else
+		{
+			// Orphaning lets the driver hand out fresh memory of the same size while draws finish with the old one
+			bind();
+			glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr, usage);
+		}
+
+		if(bytes)
+			glBufferSubData(target, 0, static_cast<GLsizeiptr>(bytes), data);
+		size = bytes;
+	}
+
+	void GpuBuffer::update(size_t offset, const void* data, size_t bytes)
+	{
+		if(offset > size || bytes > size - offset)
+		{
+			std::cerr << "GpuBuffer: Update of " << bytes << " bytes at offset " << offset << " exceeds the buffer size of " << size << " bytes\n";
+			throw std::out_of_range{"Buffer update failed."};
+		}
+
+		bind();
+		glBufferSubData(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+	}
+
+	void GpuBuffer::reserve(size_t bytes)
+	{
+		if(bytes > capacity)
+		{
+			allocate(bytes);
+			size = 0;
+		}
+	}
+
+	void GpuBuffer::bind() const
+	{
+		glBindBuffer(target, id);
+	}
+
+	GLuint GpuBuffer::get_id() const
+	{
+		return id;
+	}
+
+	GLenum GpuBuffer::get_target() const
+	{
+		return target;
+	}
+
+	size_t GpuBuffer::get_size() const
+	{
+		return size;
+	}
+
+	size_t GpuBuffer::get_capacity() const
+	{
+		return capacity;
+	}
+
+	size_t GpuBuffer::get_allocations() const
+	{
+		return allocations;
+	}
+
+	void GpuBuffer::allocate(size_t bytes)
+	{
+		bind();
+		glBufferData(target, static_cast<GLsizeiptr>(bytes), nullptr, usage);
+		capacity = bytes;
+		++allocations;
+	}
+
+	StreamBuffer::StreamBuffer(GLenum target, size_t region_bytes, size_t region_count)
+		: target{target},
+		  region_bytes{region_bytes},
+		  fences(std::max(region_count, size_t{1}), nullptr)
+	{
+		auto bytes{static_cast<GLsizeiptr>(region_bytes * fences.size())};
+		glGenBuffers(1, &id);
+		bind();
+
+		if(GLEW_ARB_buffer_storage)
+		{
+			constexpr GLbitfield flags{GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+			glBufferStorage(target, bytes, nullptr, flags);
+			mapping = static_cast<char*>(glMapBufferRange(target, 0, bytes, flags));
+			if(!mapping)
+			{
+				std::cerr << "StreamBuffer: Mapping " << bytes << " bytes persistently failed\n";
+				glDeleteBuffers(1, &id);
+				throw std::runtime_error{"Stream buffer creation failed."};
+			}
+		}
+		else
+			glBufferData(target, bytes, nullptr, GL_STREAM_DRAW);
+	}
+
+	StreamBuffer::~StreamBuffer()
+	{
+		for(auto fence : fences)
+			if(fence)
+				glDeleteSync(fence);
+
+		if(mapping)
+		{
+			bind();
+			glUnmapBuffer(target);
+		}
+		glDeleteBuffers(1, &id);
+	}
+
+	size_t StreamBuffer::write(const void* data, size_t bytes, size_t alignment)
+	{
+		auto aligned{(offset + alignment - 1) / alignment * alignment};
+		if(aligned > region_bytes || bytes > region_bytes - aligned)
+		{
+			std::cerr << "StreamBuffer: Writing " << bytes << " bytes at offset " << aligned << " exceeds the region size of " << region_bytes << " bytes\n";
+			throw std::length_error{"Stream buffer write failed."};
+		}
+
+		auto position{region * region_bytes + aligned};
+		if(mapping)
+			std::memcpy(mapping + position, data, bytes);
+		else
+		{
+			bind();
+			glBufferSubData(target, static_cast<GLintptr>(position), static_cast<GLsizeiptr>(bytes), data);
+		}
+
+		offset = aligned + bytes;
+		return position;
+	}
+
+	void StreamBuffer::next_region()
+	{
+		offset = 0;
+		if(!mapping)
+		{
+			region = (region + 1) % fences.size();
+			if(!region)
+			{
+				bind();
+				glBufferData(target, static_cast<GLsizeiptr>(region_bytes * fences.size()), nullptr, GL_STREAM_DRAW);
+			}
+			return;
+		}
+
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region = (region + 1) % fences.size();
+
+		auto& fence{fences[region]};
+		if(!fence)
+			return;
+
+		// Region count frames in flight usually suffice, so only the first poll is expected to succeed
+		auto status{glClientWaitSync(fence, 0, 0)};
+		if(status == GL_TIMEOUT_EXPIRED)
+		{
+			++waits;
+			while(status == GL_TIMEOUT_EXPIRED)
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	void StreamBuffer::bind() const
+	{
+		glBindBuffer(target, id);
+	}
+
+	GLuint StreamBuffer::get_id() const
+	{
+		return id;
+	}
+
+	size_t StreamBuffer::get_region_bytes() const
+	{
+		return region_bytes;
+	}
+
+	bool StreamBuffer::is_persistent() const
+	{
+		return mapping != nullptr;
+	}
+
+	size_t StreamBuffer::get_waits() const
+	{
+		return waits;
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef GPU_BUFFER_HPP
+#define GPU_BUFFER_HPP
+
+#include "GL/glew.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace cg
+{
+	/// OpenGL buffer object that keeps its storage across uploads. Storage only grows, at least doubling each time,
+	/// so repeated uploads of similar sizes do not make the driver allocate new memory.
+	class GpuBuffer
+	{
+		public:
+			explicit GpuBuffer(GLenum target, GLenum usage = GL_STATIC_DRAW);
+			~GpuBuffer();
+
+			GpuBuffer(const GpuBuffer&) = delete;
+			GpuBuffer& operator=(const GpuBuffer&) = delete;
+			GpuBuffer(GpuBuffer&& other) noexcept;
+			GpuBuffer& operator=(GpuBuffer&& other) noexcept;
+
+			/// Replaces the contents with bytes of data and leaves the buffer bound to its target. Storage that is large
+			/// enough is orphaned instead of overwritten, so the upload does not wait for draws still reading the old contents.
+			void upload(const void* data, size_t bytes);
+			template<typename T>
+			void upload(const std::vector<T>& data)
+			{
+				upload(data.data(), sizeof(T) * data.size());
+			}
+
+			/// Overwrites bytes at offset in place. Throws out_of_range if the range exceeds the uploaded size.
+			void update(size_t offset, const void* data, size_t bytes);
+			/// Grows the storage to at least bytes, the contents are lost if it grows.
+			void reserve(size_t bytes);
+
+			void bind() const;
+
+			GLuint get_id() const;
+			GLenum get_target() const;
+			/// Bytes written by the last upload.
+			size_t get_size() const;
+			size_t get_capacity() const;
+			/// Number of times the storage was (re)allocated.
+			size_t get_allocations() const;
+
+		private:
+			void allocate(size_t bytes);
+
+			GLuint id{0};
+			GLenum target;
+			GLenum usage;
+			size_t size{0};
+			size_t capacity{0};
+			size_t allocations{0};
+	};
+
+	/// Ring of equally sized regions in one buffer for data that is rewritten every frame. With GL_ARB_buffer_storage the
+	/// buffer is mapped persistently, writes go straight to the mapping and every region is fenced once it has been drawn.
+	/// Otherwise writes use glBufferSubData and the buffer is orphaned whenever the ring wraps around.
+	class StreamBuffer
+	{
+		public:
+			explicit StreamBuffer(GLenum target, size_t region_bytes, size_t region_count = 3);
+			~StreamBuffer();
+
+			StreamBuffer(const StreamBuffer&) = delete;
+			StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+			/// Appends bytes of data to the current region and returns their offset from the start of the buffer, aligned to
+			/// alignment. Throws length_error if the region is full.
+			size_t write(const void* data, size_t bytes, size_t alignment = 16);
+			template<typename T>
+			size_t write(const std::vector<T>& data, size_t alignment = alignof(T))
+			{
+				return write(data.data(), sizeof(T) * data.size(), alignment);
+			}
+
+			/// Call after the draws reading the current region were issued. Moves on to the next region and waits for the GPU
+			/// only if it still reads from it.
+			void next_region();
+
+			void bind() const;
+
+			GLuint get_id() const;
+			size_t get_region_bytes() const;
+			bool is_persistent() const;
+			/// Number of times next_region had to wait for the GPU.
+			size_t get_waits() const;
+
+		private:
+			GLuint id{0};
+			GLenum target;
+			size_t region_bytes;
+			std::vector<GLsync> fences;
+			char* mapping{nullptr};
+			size_t region{0};
+			size_t offset{0};
+			size_t waits{0};
+	};
+}
+
+#endif // GPU_BUFFER_HPP
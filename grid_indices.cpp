@@ -0,0 +1,178 @@
+#include "grid_indices.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+namespace cg::grid_indices
+{
+	namespace
+	{
+		enum class Layout
+		{
+			triangles,
+			strips,
+			tiles
+		};
+
+		using Key = std::tuple<Layout, size_t, size_t, size_t>;
+
+		struct Cache
+		{
+			std::mutex mutex;
+			/// Buffers die with their last user, the cache only hands out the ones still alive.
+			std::map<Key, std::weak_ptr<const void>> buffers;
+		};
+
+		Cache& get_cache()
+		{
+			static Cache cache{};
+			return cache;
+		}
+
+		/// Returns the cached buffer for key if it is still in use or stores the one build creates. Building happens
+		/// outside of the lock, if two threads race the first stored buffer wins.
+		template<typename T, typename Build>
+		std::shared_ptr<const T> cached(const Key& key, Build build)
+		{
+			auto& cache{get_cache()};
+			{
+				std::lock_guard<std::mutex> lock{cache.mutex};
+				auto it{cache.buffers.find(key)};
+				if(it != cache.buffers.end())
+					if(auto buffer{it->second.lock()})
+						return std::static_pointer_cast<const T>(buffer);
+			}
+
+			std::shared_ptr<const T> buffer{std::make_shared<const T>(build())};
+			std::lock_guard<std::mutex> lock{cache.mutex};
+			auto& entry{cache.buffers[key]};
+			if(auto existing{entry.lock()})
+				return std::static_pointer_cast<const T>(existing);
+			entry = buffer;
+
+			// Drop the entries of buffers that died in the meantime
+			for(auto it{cache.buffers.begin()}; it != cache.buffers.end();)
+				it = it->second.expired() ? cache.buffers.erase(it) : std::next(it);
+			return buffer;
+		}
+
+		void check_dimensions(size_t width, size_t height)
+		{
+			if(width * height >= restart_index)
+			{
+				std::cerr << "GridIndices: No index buffer for a " << width << "x" << height << " grid\n";
+				throw std::invalid_argument{"Grid index generation failed."};
+			}
+		}
+
+		/// Appends the triangles of quad_cols x quad_rows quads, index (row, col) is offset + row * stride + col.
+		template<typename Index>
+		void append_triangles(std::vector<Index>& indices, size_t quad_cols, size_t quad_rows, size_t stride, size_t offset)
+		{
+			for(size_t row{0}; row < quad_rows; ++row)
+			{
+				for(size_t col{0}; col < quad_cols; ++col)
+				{
+					auto top{static_cast<Index>(offset + row * stride + col)};
+					auto bottom{static_cast<Index>(top + stride)};
+					indices.insert(indices.end(), {top, bottom, static_cast<Index>(bottom + 1), top, static_cast<Index>(bottom + 1), static_cast<Index>(top + 1)});
+				}
+			}
+		}
+	}
+
+	std::shared_ptr<const std::vector<unsigned int>> triangles(size_t width, size_t height)
+	{
+		check_dimensions(width, height);
+		return cached<std::vector<unsigned int>>({Layout::triangles, width, height, 0}, [=] {
+			std::vector<unsigned int> indices{};
+			if(width < 2 || height < 2)
+				return indices;
+
+			indices.reserve((width - 1) * (height - 1) * 6);
+			append_triangles(indices, width - 1, height - 1, width, 0);
+			return indices;
+		});
+	}
+
+	std::shared_ptr<const std::vector<unsigned int>> strips(size_t width, size_t height)
+	{
+		check_dimensions(width, height);
+		return cached<std::vector<unsigned int>>({Layout::strips, width, height, 0}, [=] {
+			std::vector<unsigned int> indices{};
+			if(width < 2 || height < 2)
+				return indices;
+
+			indices.reserve((height - 1) * (2 * width + 2));
+			for(size_t row{0}; row < height - 1; ++row)
+			{
+				if(row)
+					indices.push_back(restart_index);
+
+				auto top{static_cast<unsigned int>(row * width)};
+				auto bottom{static_cast<unsigned int>(top + width)};
+				indices.push_back(bottom);
+				for(unsigned int col{0}; col < width; ++col)
+				{
+					indices.push_back(bottom + col);
+					indices.push_back(top + col);
+				}
+			}
+			return indices;
+		});
+	}
+
+	std::shared_ptr<const Tiling> tiles(size_t width, size_t height, size_t tile_size)
+	{
+		check_dimensions(width, height);
+		if(tile_size == 0 || tile_size > max_tile_size(width) || width * height > static_cast<size_t>(std::numeric_limits<int>::max()))
+		{
+			std::cerr << "GridIndices: Tiles of " << tile_size << " quads do not fit 16 bit indices for a grid of width " << width << "\n";
+			throw std::invalid_argument{"Grid index generation failed."};
+		}
+
+		return cached<Tiling>({Layout::tiles, width, height, tile_size}, [=] {
+			Tiling tiling{tile_size, {}, {}, {}};
+			auto quad_cols{width ? width - 1 : 0};
+			auto quad_rows{height ? height - 1 : 0};
+
+			// Blocks for full tiles, the right border, the bottom border and the corner
+			std::map<std::pair<size_t, size_t>, size_t> block_of_size{};
+			for(size_t row{0}; row < quad_rows; row += tile_size)
+			{
+				for(size_t col{0}; col < quad_cols; col += tile_size)
+				{
+					std::pair<size_t, size_t> size{std::min(tile_size, quad_cols - col), std::min(tile_size, quad_rows - row)};
+					auto [it, inserted]{block_of_size.emplace(size, tiling.blocks.size())};
+					if(inserted)
+					{
+						auto offset{tiling.indices.size()};
+						append_triangles(tiling.indices, size.first, size.second, width, 0);
+						tiling.blocks.push_back({offset, tiling.indices.size() - offset});
+					}
+					tiling.tiles.push_back({it->second, static_cast<int>(row * width + col)});
+				}
+			}
+			return tiling;
+		});
+	}
+
+	size_t max_tile_size(size_t width)
+	{
+		// The last index of a tile is tile_size * width + tile_size, 0xffff stays free for primitive restart
+		return 0xfffe / (width + 1);
+	}
+
+	void clear_cache()
+	{
+		auto& cache{get_cache()};
+		std::lock_guard<std::mutex> lock{cache.mutex};
+		cache.buffers.clear();
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef GRID_INDICES_HPP
+#define GRID_INDICES_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/// Index buffers of a width x height vertex grid in row major order. Every layout produces the same triangles
+/// (row, col), (row + 1, col), (row + 1, col + 1) and (row, col), (row + 1, col + 1), (row, col + 1) per quad.
+/// Results are shared per dimensions while a caller holds them and built again once the last one is released,
+/// all functions are thread safe. Grids without quads get empty buffers.
+namespace cg::grid_indices
+{
+	/// Separates the strips of strips(), enable it with glPrimitiveRestartIndex.
+	constexpr unsigned int restart_index{0xffffffffu};
+
+	/// Index blocks for tiles of a grid, drawn with glDrawElementsBaseVertex and GL_UNSIGNED_SHORT.
+	/// Blocks index relative to the first vertex of their tile with the row stride of the whole grid,
+	/// so every tile of the same size shares one block.
+	struct Tiling
+	{
+		struct Block
+		{
+			size_t offset;
+			size_t count;
+		};
+
+		struct Tile
+		{
+			size_t block;
+			int base_vertex;
+		};
+
+		size_t tile_size;
+		std::vector<unsigned short> indices;
+		std::vector<Block> blocks;
+		std::vector<Tile> tiles;
+	};
+
+	/// Triangle list with six indices per quad.
+	std::shared_ptr<const std::vector<unsigned int>> triangles(size_t width, size_t height);
+
+	/// One GL_TRIANGLE_STRIP per row of quads separated by restart_index, about a third of the triangle list.
+	/// Every strip starts with a degenerate triangle to keep the winding and diagonals of the triangle list.
+	std::shared_ptr<const std::vector<unsigned int>> strips(size_t width, size_t height);
+
+	/// Splits the grid into tiles of tile_size x tile_size quads, tiles at the right and bottom border may be smaller.
+	/// Throws invalid_argument if the indices of a tile do not fit into 16 bits, see max_tile_size.
+	std::shared_ptr<const Tiling> tiles(size_t width, size_t height, size_t tile_size);
+
+	/// Largest tile size whose 16 bit indices fit a grid of the given width.
+	size_t max_tile_size(size_t width);
+
+	/// Forgets all cached buffers, buffers still held by callers stay valid.
+	void clear_cache();
+}
+
+#endif // GRID_INDICES_HPP
@@ -129,6 +129,34 @@ namespace cg
 		return SoupMesh(soup_positions, soup_normals, soup_texture_coordinates, soup_faces);
 	}
 
+	const std::vector<std::unique_ptr<HalfEdgeMesh::Vertex>>& HalfEdgeMesh::get_vertices() const
+	{
+		return vertices;
+	}
+
+	const std::vector<std::unique_ptr<HalfEdgeMesh::Face>>& HalfEdgeMesh::get_faces() const
+	{
+		return faces;
+	}
+
+	size_t HalfEdgeMesh::index_of(const Vertex* vertex) const
+	{
+		auto it{std::lower_bound(vertices.begin(), vertices.end(), vertex, [] (const auto& v1, const Vertex* v2) { return v1.get() < v2; })};
+		if(it == vertices.end() || it->get() != vertex)
+			throw std::invalid_argument{"HalfEdgeMesh: Index of vertex that is not part of the mesh requested."};
+
+		return static_cast<size_t>(std::distance(vertices.begin(), it));
+	}
+
+	size_t HalfEdgeMesh::index_of(const Face* face) const
+	{
+		auto it{std::lower_bound(faces.begin(), faces.end(), face, [] (const auto& f1, const Face* f2) { return f1.get() < f2; })};
+		if(it == faces.end() || it->get() != face)
+			throw std::invalid_argument{"HalfEdgeMesh: Index of face that is not part of the mesh requested."};
+
+		return static_cast<size_t>(std::distance(faces.begin(), it));
+	}
+
 	HalfEdgeMesh::HalfEdge* HalfEdgeMesh::face_loop_next(HalfEdgeMesh::HalfEdge* current)
 	{
 		if(!current)
@@ -310,4 +338,36 @@ namespace cg
 
 	//	return static_cast<float>(half_edges.size()/2) / original_edge_count;
 	//}
+
+	MemoryUsage HalfEdgeMesh::get_memory_usage() const
+	{
+		MemoryUsage usage{"HalfEdgeMesh", {}};
+		usage.add_vector("vertex pointers", vertices);
+		usage.add_vector("face pointers", faces);
+		usage.add("vertices", vertices.size(), vertices.size() * sizeof(Vertex), vertices.size() * sizeof(Vertex));
+		usage.add("faces", faces.size(), faces.size() * sizeof(Face), faces.size() * sizeof(Face));
+		usage.add("half edges", half_edges.size(), half_edges.size() * sizeof(HalfEdge), half_edges.size() * sizeof(HalfEdge));
+
+		// A node holds the next pointer, the key value pair and the cached hash
+		constexpr size_t node_size{sizeof(void*) + sizeof(decltype(half_edges)::value_type) + sizeof(size_t)};
+		usage.add("hash nodes", half_edges.size(), half_edges.size() * node_size, half_edges.size() * node_size);
+		usage.add("hash buckets", half_edges.bucket_count(), half_edges.size() * sizeof(void*), half_edges.bucket_count() * sizeof(void*));
+
+		// Every vertex, face, half edge and node is a separate allocation
+		auto overhead{[] (size_t count, size_t bytes) { return count * (MemoryUsage::allocation_size(bytes) - bytes); }};
+		size_t blocks{vertices.size() + faces.size() + 2 * half_edges.size()};
+		size_t bytes{overhead(vertices.size(), sizeof(Vertex)) + overhead(faces.size(), sizeof(Face))
+			+ overhead(half_edges.size(), sizeof(HalfEdge)) + overhead(half_edges.size(), node_size)};
+		for(auto reserved : {vertices.capacity() * sizeof(Vertex*), faces.capacity() * sizeof(Face*), half_edges.bucket_count() * sizeof(void*)})
+		{
+			if(reserved)
+			{
+				++blocks;
+				bytes += overhead(1, reserved);
+			}
+		}
+		usage.add("allocator overhead", blocks, 0, bytes);
+
+		return usage;
+	}
 }
@@ -1,6 +1,7 @@
 #ifndef HALF_EDGE_MESH_HPP
 #define HALF_EDGE_MESH_HPP
 
+#include "memory_usage.hpp"
 #include "soup_mesh.hpp"
 
 #include "glm/glm.hpp"
@@ -69,6 +70,18 @@ namespace cg
 			explicit HalfEdgeMesh(const SoupMesh& soup);
 			SoupMesh toSoupMesh() const;
 
+			/// Vertices and faces are sorted by address.
+			const std::vector<std::unique_ptr<Vertex>>& get_vertices() const;
+			const std::vector<std::unique_ptr<Face>>& get_faces() const;
+
+			/// Returns the index of vertex in get_vertices() or face in get_faces() using binary search.
+			/// Throws invalid_argument if the vertex or face is not part of this mesh.
+			size_t index_of(const Vertex* vertex) const;
+			size_t index_of(const Face* face) const;
+
+			/// Hash map nodes are estimated from the value type, the bucket array is exact.
+			MemoryUsage get_memory_usage() const;
+
 		private:
 			using EdgeKey = std::pair<Vertex*, Vertex*>;
 			struct Hasher
@@ -0,0 +1,377 @@
+#include "heightfield.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cg
+{
+	namespace
+	{
+		/// Reads the next whitespace separated token of a PGM or PFM header, skipping comments.
+		std::string next_token(const std::uint8_t* data, size_t size, size_t& position)
+		{
+			while(position < size)
+			{
+				if(data[position] == '#')
+					while(position < size && data[position] != '\n')
+						++position;
+				else if(std::isspace(data[position]))
+					++position;
+				else
+					break;
+			}
+
+			std::string token{};
+			while(position < size && !std::isspace(data[position]) && token.size() < 32)
+				token += static_cast<char>(data[position++]);
+			return token;
+		}
+
+		size_t parse_size(const std::string& token, const std::string& file_path)
+		{
+			try
+			{
+				size_t parsed{0};
+				auto value{std::stoull(token, &parsed)};
+				if(parsed == token.size())
+					return static_cast<size_t>(value);
+			}
+			catch(const std::logic_error&)
+			{
+			}
+			std::cerr << "Heightfield: Invalid header value " << token << " in " << file_path << '\n';
+			throw std::runtime_error{"Heightfield: Construction from file failed."};
+		}
+
+		std::uint32_t read_uint32(const std::uint8_t* p, bool little)
+		{
+			return little ? (std::uint32_t{p[0]} | std::uint32_t{p[1]} << 8 | std::uint32_t{p[2]} << 16 | std::uint32_t{p[3]} << 24)
+				: (std::uint32_t{p[3]} | std::uint32_t{p[2]} << 8 | std::uint32_t{p[1]} << 16 | std::uint32_t{p[0]} << 24);
+		}
+
+		float read_float(const std::uint8_t* p, bool little)
+		{
+			auto bits{read_uint32(p, little)};
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	}
+
+	Heightfield::Heightfield(const std::string& file_path)
+	{
+		map(file_path);
+
+		// The destructor does not run for a throwing constructor
+		try
+		{
+			size_t position{0};
+			auto magic{next_token(data, file_size, position)};
+			if(magic == "P5")
+			{
+				width = parse_size(next_token(data, file_size, position), file_path);
+				height = parse_size(next_token(data, file_size, position), file_path);
+				auto max_value{parse_size(next_token(data, file_size, position), file_path)};
+				if(max_value == 0 || max_value > 65535)
+				{
+					std::cerr << "Heightfield: PGM " << file_path << " has an invalid maximum value\n";
+					throw std::runtime_error{"Heightfield: Construction from file failed."};
+				}
+				format = max_value < 256 ? Format::uint8 : Format::uint16_big;
+				sample_bytes = max_value < 256 ? 1 : 2;
+				normalization = 1.f / static_cast<float>(max_value);
+			}
+			else if(magic == "Pf" || magic == "PF")
+			{
+				width = parse_size(next_token(data, file_size, position), file_path);
+				height = parse_size(next_token(data, file_size, position), file_path);
+				auto byte_order{next_token(data, file_size, position)};
+				format = !byte_order.empty() && byte_order[0] == '-' ? Format::float32_little : Format::float32_big;
+				sample_bytes = magic == "Pf" ? 4 : 12;
+				bottom_up = true;
+			}
+			else
+			{
+				std::cerr << "Heightfield: " << file_path << " is neither a binary PGM nor a PFM file, use the raw constructor for headerless rasters\n";
+				throw std::runtime_error{"Heightfield: Construction from file failed."};
+			}
+
+			// Exactly one whitespace character separates header and samples
+			header_bytes = position + 1;
+			row_bytes = width * sample_bytes;
+			check_size(file_path);
+		}
+		catch(...)
+		{
+			unmap();
+			throw;
+		}
+	}
+
+	Heightfield::Heightfield(const std::string& file_path, size_t width, size_t height, Format format, size_t header_bytes)
+		: width{width},
+		  height{height},
+		  format{format},
+		  header_bytes{header_bytes}
+	{
+		map(file_path);
+		sample_bytes = format == Format::uint8 ? 1 : (format == Format::uint16_little || format == Format::uint16_big ? 2 : 4);
+		normalization = format == Format::uint8 ? 1.f / 255.f : (sample_bytes == 2 ? 1.f / 65535.f : 1.f);
+		row_bytes = width * sample_bytes;
+		try
+		{
+			check_size(file_path);
+		}
+		catch(...)
+		{
+			unmap();
+			throw;
+		}
+	}
+
+	Heightfield::~Heightfield()
+	{
+		unmap();
+	}
+
+	Heightfield::Heightfield(Heightfield&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	Heightfield& Heightfield::operator=(Heightfield&& other) noexcept
+	{
+		if(this != &other)
+		{
+			unmap();
+			data = std::exchange(other.data, nullptr);
+			file_size = std::exchange(other.file_size, 0);
+			width = other.width;
+			height = other.height;
+			format = other.format;
+			header_bytes = other.header_bytes;
+			sample_bytes = other.sample_bytes;
+			row_bytes = other.row_bytes;
+			normalization = other.normalization;
+			bottom_up = other.bottom_up;
+			scale = other.scale;
+		}
+		return *this;
+	}
+
+	size_t Heightfield::get_width() const
+	{
+		return width;
+	}
+
+	size_t Heightfield::get_height() const
+	{
+		return height;
+	}
+
+	void Heightfield::set_scale(const glm::vec3& scale)
+	{
+		this->scale = scale;
+	}
+
+	const glm::vec3& Heightfield::get_scale() const
+	{
+		return scale;
+	}
+
+	float Heightfield::sample(size_t col, size_t row) const
+	{
+		if(col >= width || row >= height)
+			throw std::out_of_range{"Heightfield: Sample outside of the raster."};
+
+		float value;
+		read_row(row, col, 1, 1, &value);
+		return value;
+	}
+
+	RegularMesh Heightfield::load_window(size_t col, size_t row, size_t width, size_t height, size_t stride) const
+	{
+		if(width == 0 || height == 0 || stride == 0 || col + (width - 1) * stride >= this->width || row + (height - 1) * stride >= this->height)
+		{
+			std::cerr << "Heightfield: Window of " << width << "x" << height << " vertices at " << col << ", " << row << " with stride " << stride
+				<< " does not fit the " << this->width << "x" << this->height << " raster\n";
+			throw std::out_of_range{"Heightfield: Loading window failed."};
+		}
+
+		// One extra sample around the window for the normals, clamped to the raster
+		auto clamp{[stride] (size_t start, size_t index, size_t size) {
+			auto position{static_cast<long long>(start) + (static_cast<long long>(index) - 1) * static_cast<long long>(stride)};
+			return static_cast<size_t>(std::clamp(position, 0LL, static_cast<long long>(size) - 1));
+		}};
+		std::vector<size_t> sample_cols(width + 2);
+		std::vector<size_t> sample_rows(height + 2);
+		for(size_t i{0}; i < width + 2; ++i)
+			sample_cols[i] = clamp(col, i, this->width);
+		for(size_t i{0}; i < height + 2; ++i)
+			sample_rows[i] = clamp(row, i, this->height);
+
+		auto padded_width{width + 2};
+		std::vector<float> heights(padded_width * (height + 2));
+		ThreadPool::get_global().parallel_for(0, height + 2, 16, [&] (size_t begin, size_t end) {
+			for(auto i{begin}; i < end; ++i)
+			{
+				auto* samples{heights.data() + i * padded_width};
+				read_row(sample_rows[i], col, width, stride, samples + 1);
+				read_row(sample_rows[i], sample_cols[0], 1, 1, samples);
+				read_row(sample_rows[i], sample_cols[width + 1], 1, 1, samples + width + 1);
+			}
+		});
+
+		auto position{[this, &heights, &sample_cols, &sample_rows, padded_width] (size_t i, size_t j) {
+			return glm::vec3{static_cast<float>(sample_cols[j]) * scale.x, -static_cast<float>(sample_rows[i]) * scale.y, heights[i * padded_width + j] * scale.z};
+		}};
+		auto u_scale{this->width > 1 ? 1.f / static_cast<float>(this->width - 1) : 0.f};
+		auto v_scale{this->height > 1 ? 1.f / static_cast<float>(this->height - 1) : 0.f};
+
+		std::vector<glm::vec3> positions(width * height);
+		std::vector<glm::vec3> normals(width * height);
+		std::vector<glm::vec2> texture_coordinates(width * height);
+		ThreadPool::get_global().parallel_for(0, height, 16, [&] (size_t begin, size_t end) {
+			for(auto i{begin}; i < end; ++i)
+			{
+				for(size_t j{0}; j < width; ++j)
+				{
+					auto index{i * width + j};
+					positions[index] = position(i + 1, j + 1);
+
+					auto du{position(i + 1, j + 2) - position(i + 1, j)};
+					auto dv{position(i + 2, j + 1) - position(i, j + 1)};
+					auto normal{glm::cross(dv, du)};
+					auto length{glm::length(normal)};
+					normals[index] = length > 0.f ? normal / length : glm::vec3{0.f, 0.f, 1.f};
+
+					texture_coordinates[index] = glm::vec2{static_cast<float>(sample_cols[j + 1]) * u_scale, static_cast<float>(sample_rows[i + 1]) * v_scale};
+				}
+			}
+		});
+
+		return RegularMesh{width, height, positions, normals, texture_coordinates};
+	}
+
+	size_t Heightfield::get_tile_cols(size_t tile_size, size_t stride) const
+	{
+		if(tile_size < 2 || stride == 0)
+			throw std::invalid_argument{"Heightfield: Tiles need at least 2x2 vertices and a stride above 0."};
+
+		auto vertices{(width - 1) / stride + 1};
+		return std::max(size_t{1}, (vertices - 1 + tile_size - 2) / (tile_size - 1));
+	}
+
+	size_t Heightfield::get_tile_rows(size_t tile_size, size_t stride) const
+	{
+		if(tile_size < 2 || stride == 0)
+			throw std::invalid_argument{"Heightfield: Tiles need at least 2x2 vertices and a stride above 0."};
+
+		auto vertices{(height - 1) / stride + 1};
+		return std::max(size_t{1}, (vertices - 1 + tile_size - 2) / (tile_size - 1));
+	}
+
+	RegularMesh Heightfield::load_tile(size_t tile_col, size_t tile_row, size_t tile_size, size_t stride) const
+	{
+		if(tile_col >= get_tile_cols(tile_size, stride) || tile_row >= get_tile_rows(tile_size, stride))
+		{
+			std::cerr << "Heightfield: Tile " << tile_col << ", " << tile_row << " is outside of the raster\n";
+			throw std::out_of_range{"Heightfield: Loading tile failed."};
+		}
+
+		auto first_col{tile_col * (tile_size - 1)};
+		auto first_row{tile_row * (tile_size - 1)};
+		auto tile_width{std::min(tile_size, (width - 1) / stride + 1 - first_col)};
+		auto tile_height{std::min(tile_size, (height - 1) / stride + 1 - first_row)};
+		return load_window(first_col * stride, first_row * stride, tile_width, tile_height, stride);
+	}
+
+	void Heightfield::map(const std::string& file_path)
+	{
+		auto descriptor{::open(file_path.c_str(), O_RDONLY)};
+		if(descriptor < 0)
+		{
+			std::cerr << "Heightfield: Could not open " << file_path << '\n';
+			throw std::runtime_error{"Heightfield: Construction from file failed."};
+		}
+
+		struct stat status{};
+		if(::fstat(descriptor, &status) != 0 || status.st_size <= 0)
+		{
+			::close(descriptor);
+			std::cerr << "Heightfield: " << file_path << " is empty or can not be inspected\n";
+			throw std::runtime_error{"Heightfield: Construction from file failed."};
+		}
+
+		file_size = static_cast<size_t>(status.st_size);
+		auto* mapping{::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0)};
+		::close(descriptor);
+		if(mapping == MAP_FAILED)
+		{
+			file_size = 0;
+			std::cerr << "Heightfield: Could not map " << file_path << '\n';
+			throw std::runtime_error{"Heightfield: Construction from file failed."};
+		}
+		data = static_cast<const std::uint8_t*>(mapping);
+	}
+
+	void Heightfield::unmap()
+	{
+		if(data)
+			::munmap(const_cast<std::uint8_t*>(data), file_size);
+		data = nullptr;
+		file_size = 0;
+	}
+
+	void Heightfield::check_size(const std::string& file_path) const
+	{
+		if(width == 0 || height == 0 || header_bytes > file_size || (file_size - header_bytes) / row_bytes < height)
+		{
+			std::cerr << "Heightfield: " << file_path << " is too small for " << width << "x" << height << " samples\n";
+			throw std::runtime_error{"Heightfield: Construction from file failed."};
+		}
+
+		std::cout << "Heightfield: Mapped " << width << "x" << height << " samples of " << file_path << '\n';
+	}
+
+	void Heightfield::read_row(size_t row, size_t col, size_t count, size_t stride, float* samples) const
+	{
+		const auto* p{data + header_bytes + (bottom_up ? height - 1 - row : row) * row_bytes + col * sample_bytes};
+		auto step{stride * sample_bytes};
+		switch(format)
+		{
+			case Format::uint8:
+				for(size_t i{0}; i < count; ++i, p += step)
+					samples[i] = static_cast<float>(p[0]) * normalization;
+				break;
+			case Format::uint16_little:
+				for(size_t i{0}; i < count; ++i, p += step)
+					samples[i] = static_cast<float>(p[0] | p[1] << 8) * normalization;
+				break;
+			case Format::uint16_big:
+				for(size_t i{0}; i < count; ++i, p += step)
+					samples[i] = static_cast<float>(p[1] | p[0] << 8) * normalization;
+				break;
+			case Format::float32_little:
+				for(size_t i{0}; i < count; ++i, p += step)
+					samples[i] = read_float(p, true);
+				break;
+			case Format::float32_big:
+				for(size_t i{0}; i < count; ++i, p += step)
+					samples[i] = read_float(p, false);
+				break;
+		}
+	}
+}
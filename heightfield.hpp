@@ -0,0 +1,97 @@
+#ifndef HEIGHTFIELD_HPP
+#define HEIGHTFIELD_HPP
+
+#include "regular_mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cg
+{
+	/// Read only view of a heightfield raster file that is memory mapped instead of loaded, so only the
+	/// pages of the windows that are turned into meshes are ever read. Binary PGM (P5, 8 or 16 bit), PFM
+	/// (Pf and the first channel of PF) and headerless raw files are supported.
+	class Heightfield
+	{
+		public:
+			enum class Format
+			{
+				uint8,
+				uint16_little,
+				uint16_big,
+				float32_little,
+				float32_big
+			};
+
+			/// Detects PGM or PFM from the header. Throws runtime_error if the file can not be mapped or parsed.
+			explicit Heightfield(const std::string& file_path);
+			/// Maps a raw raster of width x height samples in row major order that starts after header_bytes.
+			explicit Heightfield(const std::string& file_path, size_t width, size_t height, Format format, size_t header_bytes = 0);
+			~Heightfield();
+
+			Heightfield(const Heightfield&) = delete;
+			Heightfield& operator=(const Heightfield&) = delete;
+			Heightfield(Heightfield&& other) noexcept;
+			Heightfield& operator=(Heightfield&& other) noexcept;
+
+			size_t get_width() const;
+			size_t get_height() const;
+
+			/// Distance of neighbouring samples in x and y and the factor applied to the samples for z.
+			/// Integer samples are normalized to [0, 1] before scaling. Defaults to (1, 1, 1).
+			void set_scale(const glm::vec3& scale);
+			const glm::vec3& get_scale() const;
+
+			float sample(size_t col, size_t row) const;
+
+			/// Builds a mesh of width x height vertices from every stride-th sample starting at (col, row).
+			/// Sample (c, r) becomes the position (c * scale.x, -r * scale.y, h * scale.z), so windows of the same file
+			/// line up and the triangles of RegularMesh face +z. Normals use central differences over stride samples
+			/// and texture coordinates span the whole file, which keeps neighbouring windows seamless.
+			/// Throws out_of_range if the window does not fit the raster.
+			RegularMesh load_window(size_t col, size_t row, size_t width, size_t height, size_t stride = 1) const;
+
+			/// Number of tiles of tile_size x tile_size vertices per row and column of the raster at stride.
+			/// Neighbouring tiles share their border vertices, the last tiles may be smaller.
+			size_t get_tile_cols(size_t tile_size, size_t stride = 1) const;
+			size_t get_tile_rows(size_t tile_size, size_t stride = 1) const;
+
+			RegularMesh load_tile(size_t tile_col, size_t tile_row, size_t tile_size, size_t stride = 1) const;
+
+			/// Calls function(tile_col, tile_row, mesh) for every tile, each mesh is built only when it is passed on.
+			template<typename Function>
+			void for_each_tile(size_t tile_size, size_t stride, Function function) const
+			{
+				for(size_t tile_row{0}; tile_row < get_tile_rows(tile_size, stride); ++tile_row)
+					for(size_t tile_col{0}; tile_col < get_tile_cols(tile_size, stride); ++tile_col)
+						function(tile_col, tile_row, load_tile(tile_col, tile_row, tile_size, stride));
+			}
+
+		private:
+			void map(const std::string& file_path);
+			void unmap();
+			void check_size(const std::string& file_path) const;
+
+			/// Writes count samples of row starting at col, stride samples apart.
+			void read_row(size_t row, size_t col, size_t count, size_t stride, float* samples) const;
+
+			const std::uint8_t* data{nullptr};
+			size_t file_size{0};
+
+			size_t width{0};
+			size_t height{0};
+			Format format{Format::uint8};
+			size_t header_bytes{0};
+			size_t sample_bytes{1};
+			size_t row_bytes{0};
+			float normalization{1.f};
+			bool bottom_up{false};
+
+			glm::vec3 scale{1.f, 1.f, 1.f};
+	};
+}
+
+#endif // HEIGHTFIELD_HPP
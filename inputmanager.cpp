@@ -1,7 +1,80 @@
 #include "inputmanager.hpp"
 
+#include <algorithm>
+
 namespace cg
 {
+	bool InputManager::post(Event event)
+	{
+		if(event.time == Clock::time_point{})
+			event.time = Clock::now();
+
+		if(!queue.push(event))
+		{
+			dropped_events.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	void InputManager::process_events()
+	{
+		events.clear();
+		Event event{};
+		while(queue.pop(event))
+		{
+			switch(event.type)
+			{
+				case Event::Type::key_pressed:
+					key_pressed(event.keycode);
+					break;
+				case Event::Type::key_released:
+					key_released(event.keycode);
+					break;
+				case Event::Type::cursor_moved:
+					cursor_moved(event.value);
+					break;
+				case Event::Type::scrolled:
+					mouse_scrolled(glm::ivec2{event.value});
+					break;
+				case Event::Type::focus_changed:
+					ignore_cursor_once();
+					break;
+			}
+
+			if(!input_pending || event.time < oldest_input)
+				oldest_input = event.time;
+			input_pending = true;
+			events.push_back(event);
+		}
+	}
+
+	const std::vector<InputManager::Event>& InputManager::get_events() const
+	{
+		return events;
+	}
+
+	size_t InputManager::get_dropped_events() const
+	{
+		return dropped_events.load(std::memory_order_relaxed);
+	}
+
+	void InputManager::presented(Clock::time_point time)
+	{
+		if(!input_pending)
+			return;
+
+		latency.last = std::chrono::duration<double, std::milli>(time - oldest_input).count();
+		latency.max = std::max(latency.max, latency.last);
+		latency.mean += (latency.last - latency.mean) / static_cast<double>(++latency.frames);
+		input_pending = false;
+	}
+
+	const InputManager::Latency& InputManager::get_latency() const
+	{
+		return latency;
+	}
+
 	void InputManager::unstick()
 	{
 		unstick_keys();
@@ -11,33 +84,37 @@ namespace cg
 
 	void InputManager::unstick_keys()
 	{
-		for(auto& key : pressed_keys)
-			key.second = key.second && !released_keys[key.first];
-
-		for(auto& key : released_keys)
-			key.second = key.second || !pressed_keys[key.first];
+		for(int keycode{0}; keycode < key_count; ++keycode)
+			unstick_key(keycode);
 	}
 
 	void InputManager::unstick_key(int keycode)
 	{
+		if(!is_valid(keycode))
+			return;
+
 		pressed_keys[keycode] = pressed_keys[keycode] && !released_keys[keycode];
 		released_keys[keycode] = released_keys[keycode] || !pressed_keys[keycode];
 	}
 
 	void InputManager::key_pressed(int keycode)
 	{
+		if(!is_valid(keycode))
+			return;
+
 		pressed_keys[keycode] = true;
 		released_keys[keycode] = false;
 	}
 
 	void InputManager::key_released(int keycode)
 	{
-		released_keys[keycode] = true;
+		if(is_valid(keycode))
+			released_keys[keycode] = true;
 	}
 
-	bool InputManager::get_key(int keycode)
+	bool InputManager::get_key(int keycode) const
 	{
-		return pressed_keys[keycode];
+		return is_valid(keycode) && pressed_keys[keycode];
 	}
 
 	void InputManager::unstick_cursor()
@@ -60,12 +137,12 @@ namespace cg
 		ignore_cursor = false;
 	}
 
-	glm::vec2 InputManager::get_cursor_position()
+	glm::vec2 InputManager::get_cursor_position() const
 	{
 		return cursor_position;
 	}
 
-	glm::vec2 InputManager::get_cursor_offset()
+	glm::vec2 InputManager::get_cursor_offset() const
 	{
 		return cursor_offset;
 	}
@@ -80,8 +157,18 @@ namespace cg
 		scroll_offset += offset;
 	}
 
-	glm::ivec2 InputManager::get_scroll_offset()
+	glm::ivec2 InputManager::get_scroll_offset() const
 	{
 		return scroll_offset;
 	}
+
+	bool InputManager::is_valid(int keycode)
+	{
+		return keycode >= 0 && keycode < key_count;
+	}
+
+	std::ostream& operator<<(std::ostream& stream, const InputManager::Latency& latency)
+	{
+		return stream << "Input to present latency over " << latency.frames << " frames: mean " << latency.mean << " ms, max " << latency.max << " ms\n";
+	}
 }
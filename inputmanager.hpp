@@ -1,44 +1,114 @@
 #ifndef INPUTMANAGER_HPP
 #define INPUTMANAGER_HPP
 
+#include "spsc_queue.hpp"
+
 #include "glm/glm.hpp"
 
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <vector>
 
 namespace cg
 {
+	/// Key, cursor and scroll state of the render thread. Input arrives as timestamped events in a lock free queue that
+	/// one producer fills, the GLFW callbacks or a dedicated input thread, and process_events applies them once per frame.
+	/// Keys pressed during a frame stay pressed for that frame even if they were released again before it was processed.
 	class InputManager
 	{
 		public:
+			using Clock = std::chrono::steady_clock;
+
+			struct Event
+			{
+				enum class Type
+				{
+					key_pressed,
+					key_released,
+					cursor_moved,
+					scrolled,
+					focus_changed
+				};
+
+				Type type;
+				/// Key or mouse button of key events.
+				int keycode;
+				/// Cursor position or scroll offset.
+				glm::vec2 value;
+				Clock::time_point time;
+			};
+
+			/// Time from the oldest event a frame processed to the present of that frame, over all frames with events.
+			struct Latency
+			{
+				size_t frames{0};
+				double last{0.};
+				double mean{0.};
+				double max{0.};
+			};
+
+			/// Keycodes from 0 up to this, covering the GLFW keys and mouse buttons. Others are ignored.
+			static constexpr int key_count{512};
+			static constexpr size_t queue_capacity{1024};
+
+			/// Producer side, safe to call from one thread other than the render thread. Timestamps the event with the
+			/// current time if it has none. Returns false and counts the event as dropped if the queue is full.
+			bool post(Event event);
+			/// Applies all queued events in the order they were posted, done by Application::poll_events.
+			void process_events();
+			/// Events applied by the last process_events, including presses and releases that cancel each other out.
+			const std::vector<Event>& get_events() const;
+			size_t get_dropped_events() const;
+
+			/// Records the latency of the events processed since the last present, done by Application::swap_buffers.
+			void presented(Clock::time_point time = Clock::now());
+			/// Milliseconds.
+			const Latency& get_latency() const;
+
 			void unstick();
 
 			void unstick_keys();
 			void unstick_key(int keycode);
 			void key_pressed(int keycode);
 			void key_released(int keycode);
-			bool get_key(int keycode);
-			
+			bool get_key(int keycode) const;
+
 			void unstick_cursor();
 			void ignore_cursor_once();
 			void cursor_moved(glm::vec2 position);
-			glm::vec2 get_cursor_position();
-			glm::vec2 get_cursor_offset();
-			
+			glm::vec2 get_cursor_position() const;
+			glm::vec2 get_cursor_offset() const;
+
 			void unstick_scroll();
 			void mouse_scrolled(glm::ivec2 offset);
-			glm::ivec2 get_scroll_offset();
+			glm::ivec2 get_scroll_offset() const;
 
 		private:
+			static bool is_valid(int keycode);
+
 			bool ignore_cursor{true};
 
-			std::unordered_map<int, bool> released_keys;
-			std::unordered_map<int, bool> pressed_keys;
+			std::array<bool, key_count> released_keys{};
+			std::array<bool, key_count> pressed_keys{};
+
+			glm::vec2 cursor_position{0.f};
+			glm::vec2 cursor_offset{0.f};
 
-			glm::vec2 cursor_position;
-			glm::vec2 cursor_offset;
+			glm::ivec2 scroll_offset{0};
 
-			glm::ivec2 scroll_offset;
+			SpscQueue<Event, queue_capacity> queue;
+			std::vector<Event> events;
+			/// Written by the producer.
+			std::atomic<size_t> dropped_events{0};
+			/// Time of the oldest event processed since the last present, if any.
+			bool input_pending{false};
+			Clock::time_point oldest_input{};
+			Latency latency{};
 	};
+
+	std::ostream& operator<<(std::ostream& stream, const InputManager::Latency& latency);
 }
 
 #endif // INPUTMANAGER_HPP
@@ -0,0 +1,135 @@
+#include "instance_buffer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace cg
+{
+	InstanceBuffer::InstanceBuffer(Usage usage)
+		: usage{usage},
+		  buffer{GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW}
+	{
+	}
+
+	size_t InstanceBuffer::add(const glm::mat4& model)
+	{
+		instances.push_back({model, glm::transpose(glm::inverse(glm::mat3{model}))});
+		is_changed.push_back(false);
+		resized = true;
+		return instances.size() - 1;
+	}
+
+	void InstanceBuffer::set(size_t index, const glm::mat4& model)
+	{
+		if(index >= instances.size())
+		{
+			std::cerr << "InstanceBuffer: Instance " << index << " does not exist, there are " << instances.size() << '\n';
+			throw std::out_of_range{"Setting instance failed."};
+		}
+
+		instances[index] = {model, glm::transpose(glm::inverse(glm::mat3{model}))};
+		if(!is_changed[index])
+		{
+			is_changed[index] = true;
+			changed.push_back(index);
+		}
+	}
+
+	const glm::mat4& InstanceBuffer::get(size_t index) const
+	{
+		return instances.at(index).model;
+	}
+
+	void InstanceBuffer::clear()
+	{
+		instances.clear();
+		changed.clear();
+		is_changed.clear();
+		resized = true;
+	}
+
+	void InstanceBuffer::sync()
+	{
+		uploaded = 0;
+		if(usage == Usage::stream)
+		{
+			if(resized || !changed.empty())
+				stream();
+		}
+		else if(resized || 2 * changed.size() > instances.size())
+		{
+			buffer.upload(instances);
+			uploaded = instances.size();
+		}
+		else if(!changed.empty())
+		{
+			std::sort(changed.begin(), changed.end());
+			for(size_t i{0}; i < changed.size();)
+			{
+				auto first{changed[i]};
+				auto last{first};
+				while(++i < changed.size() && changed[i] == last + 1)
+					last = changed[i];
+
+				auto count{last - first + 1};
+				buffer.update(first * sizeof(Instance), &instances[first], count * sizeof(Instance));
+				uploaded += count;
+			}
+		}
+
+		for(auto index : changed)
+			is_changed[index] = false;
+		changed.clear();
+		resized = false;
+	}
+
+	void InstanceBuffer::bind() const
+	{
+		if(usage == Usage::stream && stream_buffer)
+			stream_buffer->bind();
+		else
+			buffer.bind();
+	}
+
+	size_t InstanceBuffer::get_offset() const
+	{
+		return usage == Usage::stream ? stream_offset : 0;
+	}
+
+	InstanceBuffer::Usage InstanceBuffer::get_usage() const
+	{
+		return usage;
+	}
+
+	void InstanceBuffer::stream()
+	{
+		if(instances.empty())
+			return;
+
+		auto bytes{sizeof(Instance) * instances.size()};
+		if(!stream_buffer || bytes > stream_buffer->get_region_bytes())
+		{
+			// Draws still reading the old buffer keep it alive in the driver
+			auto region_bytes{std::max(bytes, stream_buffer ? 2 * stream_buffer->get_region_bytes() : 0)};
+			stream_buffer.reset();
+			stream_buffer.emplace(GL_ARRAY_BUFFER, region_bytes);
+		}
+		else
+			// The draws of the last sync were issued since, so the region they read can be fenced
+			stream_buffer->next_region();
+
+		stream_offset = stream_buffer->write(instances);
+		uploaded = instances.size();
+	}
+
+	size_t InstanceBuffer::size() const
+	{
+		return instances.size();
+	}
+
+	size_t InstanceBuffer::get_uploaded() const
+	{
+		return uploaded;
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef INSTANCE_BUFFER_HPP
+#define INSTANCE_BUFFER_HPP
+
+#include "gpu_buffer.hpp"
+
+#include "glm/glm.hpp"
+
+#include <optional>
+#include <vector>
+
+namespace cg
+{
+	/// Model matrices of the copies of one mesh, drawn with MeshRenderer::draw in a single instanced call.
+	/// Changes are kept on the CPU until sync. Incremental buffers only upload the instances that changed since the last
+	/// sync, stream buffers are meant for instances that move every frame and write all of them to the next region of a
+	/// StreamBuffer instead, so the upload never waits for draws of earlier frames.
+	class InstanceBuffer
+	{
+		public:
+			enum class Usage
+			{
+				incremental,
+				stream
+			};
+
+			/// Layout of the buffer, the columns of model are bound to attribute locations 3 to 6 and the columns of
+			/// normal_matrix to 7 to 9, advancing once per instance.
+			struct Instance
+			{
+				glm::mat4 model;
+				glm::mat3 normal_matrix;
+			};
+
+			explicit InstanceBuffer(Usage usage = Usage::incremental);
+
+			/// Appends an instance and returns its index.
+			size_t add(const glm::mat4& model);
+			/// Throws out_of_range for indices past the last instance.
+			void set(size_t index, const glm::mat4& model);
+			const glm::mat4& get(size_t index) const;
+			void clear();
+
+			/// Uploads the changes since the last sync. Stream buffers upload all instances if any changed. Incremental
+			/// buffers upload all instances if instances were added or removed or more than half of them changed, otherwise
+			/// every run of consecutive changed instances is updated in place.
+			void sync();
+
+			/// Binds the buffer holding the instances of the last sync to GL_ARRAY_BUFFER.
+			void bind() const;
+			/// Byte offset of the first instance in the bound buffer.
+			size_t get_offset() const;
+			Usage get_usage() const;
+			size_t size() const;
+			/// Instances uploaded by the last sync.
+			size_t get_uploaded() const;
+
+		private:
+			void stream();
+
+			Usage usage;
+			std::vector<Instance> instances;
+			GpuBuffer buffer;
+			/// Created on the first stream sync and again whenever the instances outgrow a region.
+			std::optional<StreamBuffer> stream_buffer;
+			size_t stream_offset{0};
+			/// Changed instances that are not uploaded yet, each at most once.
+			std::vector<size_t> changed;
+			std::vector<bool> is_changed;
+			bool resized{false};
+			size_t uploaded{0};
+	};
+}
+
+#endif // INSTANCE_BUFFER_HPP
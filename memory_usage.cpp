@@ -0,0 +1,97 @@
+#include "memory_usage.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace cg
+{
+	namespace
+	{
+		std::string escape(const std::string& text)
+		{
+			std::string escaped{};
+			for(auto c : text)
+			{
+				if(c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		std::string format_bytes(size_t bytes)
+		{
+			std::ostringstream stream{};
+			stream << std::fixed << std::setprecision(2);
+			if(bytes >= size_t{1} << 30)
+				stream << static_cast<double>(bytes) / (1 << 30) << " GiB";
+			else if(bytes >= size_t{1} << 20)
+				stream << static_cast<double>(bytes) / (1 << 20) << " MiB";
+			else if(bytes >= size_t{1} << 10)
+				stream << static_cast<double>(bytes) / (1 << 10) << " KiB";
+			else
+				stream << bytes << " B";
+			return stream.str();
+		}
+	}
+
+	void MemoryUsage::add(const std::string& component, size_t count, size_t used, size_t reserved)
+	{
+		components.push_back({component, count, used, reserved});
+	}
+
+	size_t MemoryUsage::get_used() const
+	{
+		size_t used{0};
+		for(const auto& component : components)
+			used += component.used;
+		return used;
+	}
+
+	size_t MemoryUsage::get_reserved() const
+	{
+		size_t reserved{0};
+		for(const auto& component : components)
+			reserved += component.reserved;
+		return reserved;
+	}
+
+	std::string MemoryUsage::to_json() const
+	{
+		std::ostringstream stream{};
+		stream << "{\"name\":\"" << escape(name) << "\",\"used\":" << get_used() << ",\"reserved\":" << get_reserved() << ",\"components\":[";
+		for(size_t i{0}; i < components.size(); ++i)
+		{
+			const auto& component{components[i]};
+			stream << (i ? "," : "") << "{\"name\":\"" << escape(component.name) << "\",\"count\":" << component.count
+				<< ",\"used\":" << component.used << ",\"reserved\":" << component.reserved << '}';
+		}
+		stream << "]}";
+		return stream.str();
+	}
+
+	size_t MemoryUsage::allocation_size(size_t bytes)
+	{
+		constexpr size_t header{sizeof(size_t)};
+		constexpr size_t alignment{16};
+		constexpr size_t minimum{4 * sizeof(size_t)};
+		auto size{(bytes + header + alignment - 1) / alignment * alignment};
+		return size < minimum ? minimum : size;
+	}
+
+	std::ostream& operator<<(std::ostream& stream, const MemoryUsage& usage)
+	{
+		stream << usage.name << " memory usage:\n";
+		for(const auto& component : usage.components)
+		{
+			stream << "  " << std::left << std::setw(22) << component.name << std::right
+				<< std::setw(12) << component.count << "  "
+				<< std::setw(12) << format_bytes(component.used) << " used  "
+				<< std::setw(12) << format_bytes(component.reserved) << " reserved\n";
+		}
+		stream << "  " << std::left << std::setw(22) << "total" << std::right << std::setw(12) << "" << "  "
+			<< std::setw(12) << format_bytes(usage.get_used()) << " used  "
+			<< std::setw(12) << format_bytes(usage.get_reserved()) << " reserved\n";
+		return stream;
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cg
+{
+	/// Heap memory held by a mesh, broken down into its components.
+	/// Used bytes are the elements in use, reserved bytes include unused capacity and allocator overhead.
+	struct MemoryUsage
+	{
+		struct Component
+		{
+			std::string name;
+			size_t count{0};
+			size_t used{0};
+			size_t reserved{0};
+		};
+
+		std::string name;
+		std::vector<Component> components;
+
+		void add(const std::string& component, size_t count, size_t used, size_t reserved);
+
+		/// Adds the buffer of a vector, the vector object itself is counted by its owner.
+		template<typename T>
+		void add_vector(const std::string& component, const std::vector<T>& vector)
+		{
+			add(component, vector.size(), vector.size() * sizeof(T), vector.capacity() * sizeof(T));
+		}
+
+		size_t get_used() const;
+		size_t get_reserved() const;
+
+		std::string to_json() const;
+
+		/// Estimated size of a heap block for a request of bytes, based on a glibc style malloc
+		/// with one size word in front and 16 byte granularity.
+		static size_t allocation_size(size_t bytes);
+	};
+
+	std::ostream& operator<<(std::ostream& stream, const MemoryUsage& usage);
+}
+
+#endif // MEMORY_USAGE_HPP
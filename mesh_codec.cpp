@@ -0,0 +1,1073 @@
+#include "mesh_codec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+namespace cg
+{
+	namespace
+	{
+		constexpr std::array<std::uint8_t, 4> magic{{'C', 'G', 'M', 'C'}};
+		constexpr std::uint8_t format_version{1};
+		constexpr size_t none{static_cast<size_t>(-1)};
+
+		// Attribute channels in the order they are quantized and stored
+		constexpr size_t channel_count{8};
+		constexpr std::array<size_t, 3> channel_begin{{0, 3, 6}};
+		constexpr std::array<size_t, 3> channel_end{{3, 6, 8}};
+
+		enum class Symbol { C, L, R, E, S, M };
+
+		size_t next_corner(size_t c) { return c % 3 == 2 ? c - 2 : c + 1; }
+		size_t prev_corner(size_t c) { return c % 3 == 0 ? c + 2 : c - 1; }
+
+		unsigned int bit_length(std::uint32_t value)
+		{
+			return value == 0 ? 0 : 32 - static_cast<unsigned int>(__builtin_clz(value));
+		}
+
+		class BitWriter
+		{
+			public:
+				void write(std::uint32_t value, unsigned int bits)
+				{
+					if(bits == 0)
+						return;
+					buffer = (buffer << bits) | (value & ((std::uint64_t{1} << bits) - 1));
+					count += bits;
+					while(count >= 8)
+					{
+						count -= 8;
+						bytes.push_back(static_cast<std::uint8_t>(buffer >> count));
+					}
+				}
+
+				/// Elias gamma code, value has to be at least 1.
+				void write_gamma(std::uint32_t value)
+				{
+					auto length{bit_length(value)};
+					write(0, length - 1);
+					write(value, length);
+				}
+
+				/// Exponential golomb code of order k.
+				void write_exp_golomb(std::uint32_t value, unsigned int k)
+				{
+					write_gamma((value >> k) + 1);
+					write(value, k);
+				}
+
+				void write_symbol(Symbol symbol)
+				{
+					switch(symbol)
+					{
+						case Symbol::C: write(0b0, 1); break;
+						case Symbol::R: write(0b10, 2); break;
+						case Symbol::L: write(0b110, 3); break;
+						case Symbol::S: write(0b1110, 4); break;
+						case Symbol::E: write(0b11110, 5); break;
+						case Symbol::M: write(0b11111, 5); break;
+					}
+				}
+
+				std::vector<std::uint8_t> finish()
+				{
+					if(count > 0)
+						write(0, 8 - count);
+					return std::move(bytes);
+				}
+
+			private:
+				std::vector<std::uint8_t> bytes;
+				std::uint64_t buffer{0};
+				unsigned int count{0};
+		};
+
+		class BitReader
+		{
+			public:
+				BitReader(const std::uint8_t* data, size_t size)
+					: data{data},
+					  size{size}
+				{}
+
+				std::uint32_t read(unsigned int bits)
+				{
+					if(bits == 0)
+						return 0;
+					auto value{static_cast<std::uint32_t>((peek() << (position & 7)) >> (64 - bits))};
+					position += bits;
+					if(position > size * 8)
+						throw std::runtime_error{"MeshCodec: Unexpected end of stream."};
+					return value;
+				}
+
+				std::uint32_t read_gamma()
+				{
+					auto window{peek() << (position & 7)};
+					if(window == 0)
+						throw std::runtime_error{"MeshCodec: Invalid gamma code in stream."};
+					auto zeros{static_cast<unsigned int>(__builtin_clzll(window))};
+					if(zeros > 31)
+						throw std::runtime_error{"MeshCodec: Invalid gamma code in stream."};
+					position += zeros;
+					return read(zeros + 1);
+				}
+
+				std::uint32_t read_exp_golomb(unsigned int k)
+				{
+					auto high{read_gamma() - 1};
+					return (high << k) | read(k);
+				}
+
+				Symbol read_symbol()
+				{
+					auto window{static_cast<unsigned int>((peek() << (position & 7)) >> 59)};
+					if(window < 0b10000) { position += 1; return Symbol::C; }
+					if(window < 0b11000) { position += 2; return Symbol::R; }
+					if(window < 0b11100) { position += 3; return Symbol::L; }
+					if(window < 0b11110) { position += 4; return Symbol::S; }
+					position += 5;
+					if(position > size * 8)
+						throw std::runtime_error{"MeshCodec: Unexpected end of stream."};
+					return window == 0b11110 ? Symbol::E : Symbol::M;
+				}
+
+			private:
+				// Returns the 64 bits starting at the byte containing the current position
+				std::uint64_t peek() const
+				{
+					auto byte{position >> 3};
+					std::uint64_t window{0};
+					if(byte + 8 <= size)
+					{
+						std::memcpy(&window, data + byte, sizeof(window));
+						window = __builtin_bswap64(window);
+					}
+					else
+					{
+						for(size_t i{0}; i < 8; ++i)
+							window = (window << 8) | (byte + i < size ? data[byte + i] : 0);
+					}
+					return window;
+				}
+
+				const std::uint8_t* data;
+				size_t size;
+				size_t position{0};
+		};
+
+		/// Adaptive order of the exponential golomb code for one attribute component.
+		struct ResidualModel
+		{
+			std::uint32_t sum{0};
+
+			unsigned int order() const
+			{
+				return std::min(bit_length(sum >> 4), 20u);
+			}
+
+			void update(std::uint32_t value)
+			{
+				sum = sum - (sum >> 4) + std::min(value, 1u << 24);
+			}
+		};
+
+		std::uint32_t zigzag(std::int32_t value)
+		{
+			return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+		}
+
+		std::int32_t unzigzag(std::uint32_t value)
+		{
+			return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+		}
+
+		/// Vertices (in decoded order) that are used to predict a new vertex.
+		struct Prediction
+		{
+			size_t a{none};
+			size_t b{none};
+			size_t opposite{none};
+		};
+
+		/// Predicts the quantized value of a component from already decoded vertices.
+		/// Dummy vertices carry no attributes and are skipped.
+		std::int32_t predict(const Prediction& prediction, const std::vector<std::int32_t>& values, const std::vector<bool>& is_dummy,
+				size_t component, size_t last_real, std::int32_t max_value)
+		{
+			auto real{[&] (size_t v) { return v != none && !is_dummy[v]; }};
+			std::int32_t result{0};
+			if(real(prediction.a) && real(prediction.b) && real(prediction.opposite))
+				result = values[prediction.a * channel_count + component] + values[prediction.b * channel_count + component] - values[prediction.opposite * channel_count + component];
+			else if(real(prediction.a) && real(prediction.b))
+				result = (values[prediction.a * channel_count + component] + values[prediction.b * channel_count + component]) / 2;
+			else if(real(prediction.a))
+				result = values[prediction.a * channel_count + component];
+			else if(real(prediction.b))
+				result = values[prediction.b * channel_count + component];
+			else if(last_real != none)
+				result = values[last_real * channel_count + component];
+
+			return std::clamp(result, 0, max_value);
+		}
+
+		/// Triangle corner table of a closed manifold mesh.
+		struct CornerTable
+		{
+			std::vector<size_t> vertex;
+			std::vector<size_t> opposite;
+			// Index of the HalfEdgeMesh vertex each (possibly split) vertex was created from, none for dummy vertices
+			std::vector<size_t> source;
+			size_t real_triangles{0};
+		};
+
+		/// Triangulates the faces, pairs opposite corners, splits non-manifold vertices and closes
+		/// every boundary loop with a dummy vertex.
+		CornerTable build_corner_table(const HalfEdgeMesh& mesh)
+		{
+			CornerTable table{};
+			auto& V{table.vertex};
+			auto& O{table.opposite};
+
+			std::vector<size_t> loop{};
+			for(const auto& face : mesh.get_faces())
+			{
+				if(!face->edge)
+					continue;
+
+				loop.clear();
+				HalfEdgeMesh::HalfEdge* current{face->edge};
+				do {
+					loop.push_back(mesh.index_of(current->next_vertex));
+					current = HalfEdgeMesh::face_loop_next(current);
+				} while(current && current != face->edge);
+
+				if(!current)
+					throw std::runtime_error{"MeshCodec: Faceloop reached nullptr during encoding."};
+
+				for(size_t i{1}; i + 1 < loop.size(); ++i)
+				{
+					// Skip degenerate triangles
+					if(loop[0] == loop[i] || loop[i] == loop[i + 1] || loop[0] == loop[i + 1])
+						continue;
+					V.push_back(loop[0]);
+					V.push_back(loop[i]);
+					V.push_back(loop[i + 1]);
+				}
+			}
+			table.real_triangles = V.size() / 3;
+			table.source.resize(mesh.get_vertices().size());
+			std::iota(table.source.begin(), table.source.end(), size_t{0});
+
+			// Pair corners opposite of the same edge in reverse direction, edges used more than once stay unpaired
+			auto edge_key{[&V] (size_t c) { return (static_cast<std::uint64_t>(V[next_corner(c)]) << 32) | V[prev_corner(c)]; }};
+			std::vector<std::pair<std::uint64_t, size_t>> edges(V.size());
+			for(size_t c{0}; c < V.size(); ++c)
+				edges[c] = {edge_key(c), c};
+			std::sort(edges.begin(), edges.end());
+
+			auto unique_edge{[&edges] (std::uint64_t key) {
+				auto range{std::equal_range(edges.begin(), edges.end(), std::make_pair(key, size_t{0}),
+						[] (const auto& a, const auto& b) { return a.first < b.first; })};
+				return range.second - range.first == 1 ? range.first->second : none;
+			}};
+
+			O.assign(V.size(), none);
+			for(size_t c{0}; c < V.size(); ++c)
+			{
+				auto key{edge_key(c)};
+				if(unique_edge(key) == c)
+				{
+					auto o{unique_edge((key << 32) | (key >> 32))};
+					if(o != none)
+						O[c] = o;
+				}
+			}
+
+			// Split vertices whose corners form more than one fan
+			std::vector<bool> has_fan(table.source.size(), false);
+			std::vector<bool> in_fan(V.size(), false);
+			for(size_t c{0}; c < V.size(); ++c)
+			{
+				if(in_fan[c])
+					continue;
+
+				auto id{V[c]};
+				if(has_fan[id])
+				{
+					table.source.push_back(table.source[id]);
+					id = table.source.size() - 1;
+				}
+				else
+					has_fan[id] = true;
+
+				// Swing forward, and backward if the fan is open
+				size_t k{c};
+				do {
+					in_fan[k] = true;
+					V[k] = id;
+					k = O[prev_corner(k)] == none ? none : prev_corner(O[prev_corner(k)]);
+				} while(k != none && k != c);
+
+				if(k == none)
+				{
+					k = c;
+					while(O[next_corner(k)] != none && (k = next_corner(O[next_corner(k)])) != c)
+					{
+						in_fan[k] = true;
+						V[k] = id;
+					}
+				}
+			}
+
+			// Close boundary loops with a fan around a dummy vertex
+			auto real_corners{V.size()};
+			std::vector<bool> closed(real_corners, false);
+			std::vector<size_t> loop_triangles{};
+			for(size_t c{0}; c < real_corners; ++c)
+			{
+				if(O[c] != none || closed[c])
+					continue;
+
+				auto dummy{table.source.size()};
+				table.source.push_back(none);
+				loop_triangles.clear();
+
+				size_t boundary{c};
+				do {
+					closed[boundary] = true;
+					// Triangle (b, a, dummy) for boundary edge a -> b
+					auto base{V.size()};
+					V.push_back(V[prev_corner(boundary)]);
+					V.push_back(V[next_corner(boundary)]);
+					V.push_back(dummy);
+					O.insert(O.end(), {none, none, boundary});
+					O[boundary] = base + 2;
+					loop_triangles.push_back(base);
+
+					// Find the boundary edge starting at b, corners of this loop are already paired with the dummy fan
+					auto k{prev_corner(boundary)};
+					while(O[prev_corner(k)] != none && O[prev_corner(k)] < real_corners)
+						k = prev_corner(O[prev_corner(k)]);
+					boundary = prev_corner(k);
+				} while(boundary != c);
+
+				for(size_t i{0}; i < loop_triangles.size(); ++i)
+				{
+					auto current{loop_triangles[i]};
+					auto following{loop_triangles[(i + 1) % loop_triangles.size()]};
+					O[current + 1] = following;
+					O[following] = current + 1;
+				}
+			}
+
+			return table;
+		}
+
+		void write_u32(std::vector<std::uint8_t>& out, std::uint32_t value)
+		{
+			for(int i{0}; i < 4; ++i)
+				out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+
+		void write_float(std::vector<std::uint8_t>& out, float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			write_u32(out, bits);
+		}
+
+		std::uint32_t read_u32(const std::vector<std::uint8_t>& in, size_t& offset)
+		{
+			if(offset + 4 > in.size())
+				throw std::runtime_error{"MeshCodec: Unexpected end of stream."};
+			std::uint32_t value{0};
+			for(int i{0}; i < 4; ++i)
+				value |= static_cast<std::uint32_t>(in[offset++]) << (8 * i);
+			return value;
+		}
+
+		float read_float(const std::vector<std::uint8_t>& in, size_t& offset)
+		{
+			auto bits{read_u32(in, offset)};
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		using Clock = std::chrono::steady_clock;
+
+		double seconds_since(Clock::time_point start)
+		{
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		}
+	}
+
+	MeshCodec::MeshCodec(int position_bits, int normal_bits, int texture_coordinate_bits)
+		: position_bits{position_bits},
+		  normal_bits{normal_bits},
+		  texture_coordinate_bits{texture_coordinate_bits}
+	{
+		for(int bits : {position_bits, normal_bits, texture_coordinate_bits})
+		{
+			if(bits < 1 || bits > 24)
+			{
+				std::cerr << "MeshCodec: Quantization bits have to be between 1 and 24\n";
+				throw std::invalid_argument{"MeshCodec: Construction failed."};
+			}
+		}
+	}
+
+	std::vector<std::uint8_t> MeshCodec::encode(const HalfEdgeMesh& mesh)
+	{
+		std::cout << "MeshCodec: Started encoding of HalfEdgeMesh\n";
+		auto start{Clock::now()};
+
+		auto table{build_corner_table(mesh)};
+		const auto& V{table.vertex};
+		const auto& O{table.opposite};
+		if(table.real_triangles == 0)
+		{
+			std::cerr << "MeshCodec: Encoded mesh does not contain triangles\n";
+			throw std::invalid_argument{"MeshCodec: Encoding failed."};
+		}
+
+		auto triangle_count{V.size() / 3};
+		std::vector<bool> processed(triangle_count, false);
+		std::vector<size_t> decoded_id(table.source.size(), none);
+		std::vector<size_t> order{};
+		std::vector<Prediction> predictions{};
+		order.reserve(table.source.size());
+		predictions.reserve(table.source.size());
+
+		auto visit{[&] (size_t vertex, Prediction prediction) {
+			decoded_id[vertex] = order.size();
+			order.push_back(vertex);
+			predictions.push_back(prediction);
+			return decoded_id[vertex];
+		}};
+
+		// Active boundary loops as doubly linked lists of slots.
+		// The loop edge from a slot to its successor borders the unprocessed triangle of corner slot_corner.
+		std::vector<size_t> slot_next{}, slot_prev{}, slot_vertex{}, slot_corner{}, slot_opposite{};
+		std::vector<size_t> slot_of_corner(V.size(), none);
+		auto new_slot{[&] (size_t vertex, size_t corner, size_t opposite) {
+			slot_next.push_back(none);
+			slot_prev.push_back(none);
+			slot_vertex.push_back(vertex);
+			slot_corner.push_back(corner);
+			slot_opposite.push_back(opposite);
+			slot_of_corner[corner] = slot_vertex.size() - 1;
+			return slot_vertex.size() - 1;
+		}};
+		auto set_edge{[&] (size_t slot, size_t corner, size_t opposite) {
+			slot_corner[slot] = corner;
+			slot_opposite[slot] = opposite;
+			slot_of_corner[corner] = slot;
+		}};
+		auto link{[&] (size_t from, size_t to) {
+			slot_next[from] = to;
+			slot_prev[to] = from;
+		}};
+
+		BitWriter connectivity{};
+		std::array<size_t, 6> symbol_counts{};
+		std::vector<size_t> loop_stack{};
+		size_t component_count{0};
+
+		for(size_t t0{0}; t0 < triangle_count; ++t0)
+		{
+			if(processed[t0])
+				continue;
+
+			++component_count;
+			processed[t0] = true;
+			auto c0{t0 * 3};
+			if(decoded_id[V[c0]] != none || decoded_id[V[c0 + 1]] != none || decoded_id[V[c0 + 2]] != none)
+			{
+				std::cerr << "MeshCodec: Unexpected Error during encoding. Component shares vertices with a previous one\n";
+				throw std::runtime_error{"MeshCodec: Encoding failed."};
+			}
+			auto v0{visit(V[c0], {})};
+			auto v1{visit(V[c0 + 1], {v0, none, none})};
+			auto v2{visit(V[c0 + 2], {v0, v1, none})};
+
+			auto s2{new_slot(v2, O[c0], v0)};
+			auto s1{new_slot(v1, O[c0 + 2], v2)};
+			auto s0{new_slot(v0, O[c0 + 1], v1)};
+			link(s2, s1);
+			link(s1, s0);
+			link(s0, s2);
+			size_t gate{s2};
+
+			while(true)
+			{
+				auto k{slot_corner[gate]};
+				auto n{slot_next[gate]};
+				processed[k / 3] = true;
+
+				if(decoded_id[V[k]] == none)
+				{
+					auto x{visit(V[k], {slot_vertex[gate], slot_vertex[n], slot_opposite[gate]})};
+					auto xs{new_slot(x, O[next_corner(k)], slot_vertex[gate])};
+					set_edge(gate, O[prev_corner(k)], slot_vertex[n]);
+					link(gate, xs);
+					link(xs, n);
+					gate = xs;
+					connectivity.write_symbol(Symbol::C);
+					++symbol_counts[static_cast<size_t>(Symbol::C)];
+					continue;
+				}
+
+				auto left{processed[O[prev_corner(k)] / 3]};
+				auto right{processed[O[next_corner(k)] / 3]};
+				if(left && right)
+				{
+					connectivity.write_symbol(Symbol::E);
+					++symbol_counts[static_cast<size_t>(Symbol::E)];
+					if(loop_stack.empty())
+						break;
+					gate = loop_stack.back();
+					loop_stack.pop_back();
+				}
+				else if(left)
+				{
+					auto p{slot_prev[gate]};
+					set_edge(p, O[next_corner(k)], slot_vertex[gate]);
+					link(p, n);
+					gate = p;
+					connectivity.write_symbol(Symbol::L);
+					++symbol_counts[static_cast<size_t>(Symbol::L)];
+				}
+				else if(right)
+				{
+					auto nn{slot_next[n]};
+					set_edge(gate, O[prev_corner(k)], slot_vertex[n]);
+					link(gate, nn);
+					connectivity.write_symbol(Symbol::R);
+					++symbol_counts[static_cast<size_t>(Symbol::R)];
+				}
+				else
+				{
+					// The third vertex lies on a loop, swing around it through unprocessed triangles
+					// until the loop edge leaving it is found
+					auto m{k};
+					while(!processed[O[prev_corner(m)] / 3])
+						m = prev_corner(O[prev_corner(m)]);
+					auto target{slot_of_corner[prev_corner(m)]};
+
+					// Locate the slot on the current loop or on a loop on the stack before relinking
+					size_t offset{0};
+					bool split{false};
+					auto s{gate};
+					do {
+						if(s == target)
+						{
+							split = true;
+							break;
+						}
+						s = slot_next[s];
+						++offset;
+					} while(s != gate);
+
+					size_t depth{0};
+					if(!split)
+					{
+						bool found{false};
+						for(; depth < loop_stack.size() && !found; ++depth)
+						{
+							auto head{loop_stack[loop_stack.size() - 1 - depth]};
+							offset = 0;
+							s = head;
+							do {
+								if(s == target)
+								{
+									found = true;
+									break;
+								}
+								s = slot_next[s];
+								++offset;
+							} while(s != head);
+						}
+
+						if(!found)
+						{
+							std::cerr << "MeshCodec: Unexpected Error during encoding. Vertex not found on any boundary loop\n";
+							throw std::runtime_error{"MeshCodec: Encoding failed."};
+						}
+					}
+
+					auto target_prev{slot_prev[target]};
+					auto xs{new_slot(slot_vertex[target], O[next_corner(k)], slot_vertex[gate])};
+					set_edge(gate, O[prev_corner(k)], slot_vertex[n]);
+					link(target_prev, xs);
+					link(xs, n);
+					link(gate, target);
+
+					if(split)
+					{
+						// Split the loop, the part behind the new vertex slot is resumed later
+						connectivity.write_symbol(Symbol::S);
+						connectivity.write_gamma(static_cast<std::uint32_t>(offset));
+						++symbol_counts[static_cast<size_t>(Symbol::S)];
+						loop_stack.push_back(xs);
+					}
+					else
+					{
+						// Merge with a loop on the stack, depth was incremented past the found loop
+						connectivity.write_symbol(Symbol::M);
+						connectivity.write_gamma(static_cast<std::uint32_t>(depth));
+						connectivity.write_gamma(static_cast<std::uint32_t>(offset + 1));
+						++symbol_counts[static_cast<size_t>(Symbol::M)];
+						loop_stack.erase(loop_stack.begin() + static_cast<std::ptrdiff_t>(loop_stack.size() - depth));
+					}
+				}
+			}
+		}
+
+		// Dummy vertices in decoded order
+		std::vector<bool> is_dummy(order.size(), false);
+		size_t dummy_count{0};
+		size_t last_dummy{0};
+		for(size_t i{0}; i < order.size(); ++i)
+		{
+			if(table.source[order[i]] == none)
+			{
+				is_dummy[i] = true;
+				connectivity.write_gamma(static_cast<std::uint32_t>(i - last_dummy + 1));
+				last_dummy = i;
+				++dummy_count;
+			}
+		}
+		auto connectivity_bytes{connectivity.finish()};
+
+		// Vertices that are not referenced by any triangle are appended after the traversal
+		const auto& vertices{mesh.get_vertices()};
+		std::vector<bool> referenced(vertices.size(), false);
+		for(auto v : order)
+			if(table.source[v] != none)
+				referenced[table.source[v]] = true;
+		std::vector<size_t> isolated{};
+		for(size_t v{0}; v < vertices.size(); ++v)
+			if(!referenced[v])
+				isolated.push_back(v);
+
+		// Attribute bounds for quantization
+		auto components{[] (const HalfEdgeMesh::Vertex& v) {
+			return std::array<float, channel_count>{{v.position.x, v.position.y, v.position.z,
+				v.normal.x, v.normal.y, v.normal.z, v.texture_coordinate.x, v.texture_coordinate.y}};
+		}};
+		std::array<float, channel_count> minimum{}, maximum{};
+		minimum.fill(std::numeric_limits<float>::max());
+		maximum.fill(std::numeric_limits<float>::lowest());
+		for(const auto& v : vertices)
+		{
+			auto values{components(*v)};
+			for(size_t i{0}; i < channel_count; ++i)
+			{
+				minimum[i] = std::min(minimum[i], values[i]);
+				maximum[i] = std::max(maximum[i], values[i]);
+			}
+		}
+
+		// Channels that are zero everywhere are not stored
+		std::uint8_t flags{0};
+		for(size_t group{1}; group < 3; ++group)
+			for(size_t i{channel_begin[group]}; i < channel_end[group]; ++i)
+				if(minimum[i] != 0.f || maximum[i] != 0.f)
+					flags |= static_cast<std::uint8_t>(1 << (group - 1));
+
+		std::array<int, 3> bits{{position_bits, normal_bits, texture_coordinate_bits}};
+		std::array<std::int32_t, channel_count> max_value{};
+		std::array<float, channel_count> scale{};
+		for(size_t group{0}; group < 3; ++group)
+		{
+			for(size_t i{channel_begin[group]}; i < channel_end[group]; ++i)
+			{
+				max_value[i] = (1 << bits[group]) - 1;
+				scale[i] = maximum[i] > minimum[i] ? static_cast<float>(max_value[i]) / (maximum[i] - minimum[i]) : 0.f;
+			}
+		}
+		auto stored{[flags] (size_t group) { return group == 0 || (flags & (1 << (group - 1))); }};
+
+		// Geometry
+		BitWriter geometry{};
+		std::vector<std::int32_t> values((order.size() + isolated.size()) * channel_count, 0);
+		std::array<ResidualModel, channel_count> models{};
+		size_t last_real{none};
+		auto encode_vertex{[&] (size_t decoded, size_t source, const Prediction& prediction) {
+			auto attributes{components(*vertices[source])};
+			for(size_t group{0}; group < 3; ++group)
+			{
+				if(!stored(group))
+					continue;
+				for(size_t i{channel_begin[group]}; i < channel_end[group]; ++i)
+				{
+					auto quantized{static_cast<std::int32_t>(std::lround((attributes[i] - minimum[i]) * scale[i]))};
+					quantized = std::clamp(quantized, 0, max_value[i]);
+					values[decoded * channel_count + i] = quantized;
+
+					auto residual{zigzag(quantized - predict(prediction, values, is_dummy, i, last_real, max_value[i]))};
+					geometry.write_exp_golomb(residual, models[i].order());
+					models[i].update(residual);
+				}
+			}
+			last_real = decoded;
+		}};
+
+		for(size_t i{0}; i < order.size(); ++i)
+			if(!is_dummy[i])
+				encode_vertex(i, table.source[order[i]], predictions[i]);
+		is_dummy.resize(order.size() + isolated.size(), false);
+		for(size_t i{0}; i < isolated.size(); ++i)
+			encode_vertex(order.size() + i, isolated[i], {});
+		auto geometry_bytes{geometry.finish()};
+
+		// Header
+		std::vector<std::uint8_t> data(magic.begin(), magic.end());
+		data.push_back(format_version);
+		data.push_back(flags);
+		for(auto b : bits)
+			data.push_back(static_cast<std::uint8_t>(b));
+		write_u32(data, static_cast<std::uint32_t>(order.size() - dummy_count + isolated.size()));
+		write_u32(data, static_cast<std::uint32_t>(order.size()));
+		write_u32(data, static_cast<std::uint32_t>(dummy_count));
+		write_u32(data, static_cast<std::uint32_t>(triangle_count));
+		write_u32(data, static_cast<std::uint32_t>(component_count));
+		for(size_t i{0}; i < channel_count; ++i)
+		{
+			write_float(data, minimum[i]);
+			write_float(data, maximum[i]);
+		}
+		write_u32(data, static_cast<std::uint32_t>(connectivity_bytes.size()));
+		write_u32(data, static_cast<std::uint32_t>(geometry_bytes.size()));
+		auto header_size{data.size()};
+		data.insert(data.end(), connectivity_bytes.begin(), connectivity_bytes.end());
+		data.insert(data.end(), geometry_bytes.begin(), geometry_bytes.end());
+
+		report.vertices = vertices.size();
+		report.triangles = table.real_triangles;
+		report.raw_bytes = vertices.size() * (2 * sizeof(glm::vec3) + sizeof(glm::vec2)) + table.real_triangles * 3 * sizeof(unsigned int);
+		report.encoded_bytes = data.size();
+		report.connectivity_bytes = header_size + connectivity_bytes.size();
+		report.geometry_bytes = geometry_bytes.size();
+		report.encode_seconds = seconds_since(start);
+
+		std::cout << "MeshCodec: Successfully encoded " << table.real_triangles << " triangles and " << vertices.size() << " vertices into " << data.size() << " bytes"
+			<< " (C " << symbol_counts[0] << ", L " << symbol_counts[1] << ", R " << symbol_counts[2] << ", E " << symbol_counts[3]
+			<< ", S " << symbol_counts[4] << ", M " << symbol_counts[5] << ", " << component_count << " components)\n";
+
+		return data;
+	}
+
+	SoupMesh MeshCodec::decode(const std::vector<std::uint8_t>& data)
+	{
+		auto start{Clock::now()};
+
+		if(data.size() < magic.size() + 5 || !std::equal(magic.begin(), magic.end(), data.begin()) || data[4] != format_version)
+		{
+			std::cerr << "MeshCodec: Decoded data is not a mesh stream of version " << static_cast<int>(format_version) << '\n';
+			throw std::runtime_error{"MeshCodec: Decoding failed."};
+		}
+
+		size_t offset{5};
+		auto flags{data[offset++]};
+		std::array<int, 3> bits{};
+		for(auto& b : bits)
+			b = data[offset++];
+		auto vertex_count{read_u32(data, offset)};
+		auto decoded_count{read_u32(data, offset)};
+		auto dummy_count{read_u32(data, offset)};
+		auto triangle_count{read_u32(data, offset)};
+		auto component_count{read_u32(data, offset)};
+		std::array<float, channel_count> minimum{}, maximum{};
+		for(size_t i{0}; i < channel_count; ++i)
+		{
+			minimum[i] = read_float(data, offset);
+			maximum[i] = read_float(data, offset);
+		}
+		auto connectivity_size{read_u32(data, offset)};
+		auto geometry_size{read_u32(data, offset)};
+		if(offset + connectivity_size + geometry_size > data.size() || decoded_count < dummy_count
+				|| vertex_count < decoded_count - dummy_count || triangle_count == 0 || triangle_count > connectivity_size * 8 + 1)
+			throw std::runtime_error{"MeshCodec: Corrupt mesh stream header."};
+		// Bound the counts before allocating, every stored vertex takes at least one bit per position component and every
+		// decoded vertex comes with a triangle except for the first two of each component
+		if(static_cast<std::uint64_t>(vertex_count) * 3 > static_cast<std::uint64_t>(geometry_size) * 8
+				|| decoded_count > static_cast<std::uint64_t>(triangle_count) * 3)
+			throw std::runtime_error{"MeshCodec: Corrupt mesh stream header."};
+
+		// Connectivity
+		BitReader connectivity{data.data() + offset, connectivity_size};
+		std::vector<unsigned int> triangles{};
+		std::vector<Prediction> predictions{};
+		triangles.reserve(static_cast<size_t>(triangle_count) * 3);
+		predictions.reserve(decoded_count);
+		size_t vertex_counter{0};
+
+		std::vector<size_t> slot_next{}, slot_prev{}, slot_vertex{}, slot_opposite{};
+		auto new_slot{[&] (size_t vertex, size_t opposite) {
+			slot_next.push_back(none);
+			slot_prev.push_back(none);
+			slot_vertex.push_back(vertex);
+			slot_opposite.push_back(opposite);
+			return slot_vertex.size() - 1;
+		}};
+		auto link{[&] (size_t from, size_t to) {
+			slot_next[from] = to;
+			slot_prev[to] = from;
+		}};
+		auto new_vertex{[&] (Prediction prediction) {
+			if(vertex_counter >= decoded_count)
+				throw std::runtime_error{"MeshCodec: Corrupt connectivity in mesh stream."};
+			predictions.push_back(prediction);
+			return vertex_counter++;
+		}};
+		auto add_triangle{[&] (size_t a, size_t b, size_t c) {
+			if(triangles.size() >= static_cast<size_t>(triangle_count) * 3)
+				throw std::runtime_error{"MeshCodec: Corrupt connectivity in mesh stream."};
+			triangles.insert(triangles.end(), {static_cast<unsigned int>(a), static_cast<unsigned int>(b), static_cast<unsigned int>(c)});
+		}};
+
+		std::vector<size_t> loop_stack{};
+		for(std::uint32_t component{0}; component < component_count; ++component)
+		{
+			auto v0{new_vertex({})};
+			auto v1{new_vertex({v0, none, none})};
+			auto v2{new_vertex({v0, v1, none})};
+			add_triangle(v0, v1, v2);
+
+			auto s2{new_slot(v2, v0)};
+			auto s1{new_slot(v1, v2)};
+			auto s0{new_slot(v0, v1)};
+			link(s2, s1);
+			link(s1, s0);
+			link(s0, s2);
+			size_t gate{s2};
+
+			while(true)
+			{
+				auto n{slot_next[gate]};
+				auto symbol{connectivity.read_symbol()};
+				if(symbol == Symbol::C)
+				{
+					auto x{new_vertex({slot_vertex[gate], slot_vertex[n], slot_opposite[gate]})};
+					add_triangle(slot_vertex[gate], slot_vertex[n], x);
+					auto xs{new_slot(x, slot_vertex[gate])};
+					slot_opposite[gate] = slot_vertex[n];
+					link(gate, xs);
+					link(xs, n);
+					gate = xs;
+				}
+				else if(symbol == Symbol::E)
+				{
+					add_triangle(slot_vertex[gate], slot_vertex[n], slot_vertex[slot_prev[gate]]);
+					if(loop_stack.empty())
+						break;
+					gate = loop_stack.back();
+					loop_stack.pop_back();
+				}
+				else if(symbol == Symbol::L)
+				{
+					auto p{slot_prev[gate]};
+					add_triangle(slot_vertex[gate], slot_vertex[n], slot_vertex[p]);
+					slot_opposite[p] = slot_vertex[gate];
+					link(p, n);
+					gate = p;
+				}
+				else if(symbol == Symbol::R)
+				{
+					auto nn{slot_next[n]};
+					add_triangle(slot_vertex[gate], slot_vertex[n], slot_vertex[nn]);
+					slot_opposite[gate] = slot_vertex[n];
+					link(gate, nn);
+				}
+				else
+				{
+					size_t target{gate};
+					if(symbol == Symbol::S)
+					{
+						auto steps{connectivity.read_gamma()};
+						for(std::uint32_t i{0}; i < steps; ++i)
+							target = slot_next[target];
+					}
+					else
+					{
+						auto depth{connectivity.read_gamma()};
+						auto steps{connectivity.read_gamma() - 1};
+						if(depth > loop_stack.size())
+							throw std::runtime_error{"MeshCodec: Corrupt connectivity in mesh stream."};
+						auto position{loop_stack.size() - depth};
+						target = loop_stack[position];
+						loop_stack.erase(loop_stack.begin() + static_cast<std::ptrdiff_t>(position));
+						for(std::uint32_t i{0}; i < steps; ++i)
+							target = slot_next[target];
+					}
+					if(target == gate || target == n)
+						throw std::runtime_error{"MeshCodec: Corrupt connectivity in mesh stream."};
+
+					add_triangle(slot_vertex[gate], slot_vertex[n], slot_vertex[target]);
+					auto target_prev{slot_prev[target]};
+					auto xs{new_slot(slot_vertex[target], slot_vertex[gate])};
+					slot_opposite[gate] = slot_vertex[n];
+					link(target_prev, xs);
+					link(xs, n);
+					link(gate, target);
+
+					if(symbol == Symbol::S)
+						loop_stack.push_back(xs);
+				}
+			}
+		}
+
+		if(vertex_counter != decoded_count || triangles.size() != static_cast<size_t>(triangle_count) * 3)
+			throw std::runtime_error{"MeshCodec: Corrupt connectivity in mesh stream."};
+
+		std::vector<bool> is_dummy(static_cast<size_t>(vertex_count) + dummy_count, false);
+		size_t last_dummy{0};
+		for(std::uint32_t i{0}; i < dummy_count; ++i)
+		{
+			auto delta{connectivity.read_gamma() - 1};
+			last_dummy += delta;
+			// Dummy indices strictly increase, only the first one may be 0
+			if((i > 0 && delta == 0) || last_dummy >= decoded_count)
+				throw std::runtime_error{"MeshCodec: Corrupt dummy vertices in mesh stream."};
+			is_dummy[last_dummy] = true;
+		}
+
+		// Geometry
+		BitReader geometry{data.data() + offset + connectivity_size, geometry_size};
+		auto stored{[flags] (size_t group) { return group == 0 || (flags & (1 << (group - 1))); }};
+		std::array<std::int32_t, channel_count> max_value{};
+		std::array<float, channel_count> step{};
+		for(size_t group{0}; group < 3; ++group)
+		{
+			if(bits[group] < 1 || bits[group] > 24)
+				throw std::runtime_error{"MeshCodec: Corrupt mesh stream header."};
+			for(size_t i{channel_begin[group]}; i < channel_end[group]; ++i)
+			{
+				max_value[i] = (1 << bits[group]) - 1;
+				step[i] = (maximum[i] - minimum[i]) / static_cast<float>(max_value[i]);
+			}
+		}
+
+		auto total{static_cast<size_t>(vertex_count) + dummy_count};
+		std::vector<std::int32_t> values(total * channel_count, 0);
+		std::vector<unsigned int> real_index(total, 0);
+		std::vector<glm::vec3> positions(vertex_count);
+		std::vector<glm::vec3> normals(vertex_count);
+		std::vector<glm::vec2> texture_coordinates(vertex_count);
+		std::array<ResidualModel, channel_count> models{};
+		size_t last_real{none};
+		unsigned int real_counter{0};
+		for(size_t v{0}; v < total; ++v)
+		{
+			if(is_dummy[v])
+				continue;
+			if(real_counter >= vertex_count)
+				throw std::runtime_error{"MeshCodec: Corrupt dummy vertices in mesh stream."};
+
+			std::array<float, channel_count> attributes{};
+			const Prediction& prediction{v < predictions.size() ? predictions[v] : Prediction{}};
+			for(size_t group{0}; group < 3; ++group)
+			{
+				if(!stored(group))
+					continue;
+				for(size_t i{channel_begin[group]}; i < channel_end[group]; ++i)
+				{
+					auto residual{geometry.read_exp_golomb(models[i].order())};
+					models[i].update(residual);
+					auto quantized{predict(prediction, values, is_dummy, i, last_real, max_value[i]) + unzigzag(residual)};
+					values[v * channel_count + i] = quantized;
+					attributes[i] = minimum[i] + static_cast<float>(quantized) * step[i];
+				}
+			}
+			positions[real_counter] = glm::vec3{attributes[0], attributes[1], attributes[2]};
+			normals[real_counter] = glm::vec3{attributes[3], attributes[4], attributes[5]};
+			texture_coordinates[real_counter] = glm::vec2{attributes[6], attributes[7]};
+			real_index[v] = real_counter++;
+			last_real = v;
+		}
+
+		// Drop triangles of the dummy fans
+		std::vector<std::vector<unsigned int>> faces{};
+		faces.reserve(triangle_count);
+		for(size_t t{0}; t < triangles.size(); t += 3)
+		{
+			if(is_dummy[triangles[t]] || is_dummy[triangles[t + 1]] || is_dummy[triangles[t + 2]])
+				continue;
+			faces.push_back({real_index[triangles[t]], real_index[triangles[t + 1]], real_index[triangles[t + 2]]});
+		}
+
+		report.vertices = vertex_count;
+		report.triangles = faces.size();
+		report.raw_bytes = vertex_count * (2 * sizeof(glm::vec3) + sizeof(glm::vec2)) + faces.size() * 3 * sizeof(unsigned int);
+		report.encoded_bytes = data.size();
+		report.decode_seconds = seconds_since(start);
+
+		std::cout << "MeshCodec: Successfully decoded " << faces.size() << " triangles and " << vertex_count << " vertices from " << data.size() << " bytes\n";
+
+		return SoupMesh{positions, normals, texture_coordinates, faces};
+	}
+
+	void MeshCodec::write_file(const HalfEdgeMesh& mesh, const std::string& file_path)
+	{
+		auto data{encode(mesh)};
+		std::ofstream ofs{file_path, std::ios::binary};
+		ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if(!ofs)
+		{
+			std::cerr << "MeshCodec: Failed to write file " << file_path << '\n';
+			throw std::runtime_error{"MeshCodec: Writing file failed."};
+		}
+	}
+
+	SoupMesh MeshCodec::read_file(const std::string& file_path)
+	{
+		std::ifstream ifs{file_path, std::ios::binary};
+		if(!ifs)
+		{
+			std::cerr << "MeshCodec: Failed to open file " << file_path << '\n';
+			throw std::runtime_error{"MeshCodec: Reading file failed."};
+		}
+		std::vector<std::uint8_t> data{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+		return decode(data);
+	}
+
+	const MeshCodec::Report& MeshCodec::get_report() const
+	{
+		return report;
+	}
+
+	double MeshCodec::Report::ratio() const
+	{
+		return encoded_bytes > 0 ? static_cast<double>(raw_bytes) / static_cast<double>(encoded_bytes) : 0.;
+	}
+
+	double MeshCodec::Report::encode_throughput() const
+	{
+		return encode_seconds > 0. ? static_cast<double>(raw_bytes) / encode_seconds / 1e6 : 0.;
+	}
+
+	double MeshCodec::Report::decode_throughput() const
+	{
+		return decode_seconds > 0. ? static_cast<double>(raw_bytes) / decode_seconds / 1e6 : 0.;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const MeshCodec::Report& report)
+	{
+		return os << "MeshCodec: " << report.triangles << " triangles, " << report.vertices << " vertices, "
+			<< report.raw_bytes << " raw bytes, " << report.encoded_bytes << " encoded bytes ("
+			<< report.connectivity_bytes << " connectivity, " << report.geometry_bytes << " geometry), ratio " << report.ratio()
+			<< ", encode " << report.encode_throughput() << " MB/s, decode " << report.decode_throughput() << " MB/s\n";
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef MESH_CODEC_HPP
+#define MESH_CODEC_HPP
+
+#include "half_edge_mesh.hpp"
+#include "soup_mesh.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cg
+{
+	/// Compresses HalfEdgeMeshes into a compact byte stream and back.
+	/// Connectivity is encoded with an Edgebreaker style traversal (CLERS symbols plus a merge symbol for handles),
+	/// vertex attributes are quantized and predicted with the parallelogram rule.
+	/// Polygons are fan triangulated, boundaries are closed with dummy vertices that are dropped when decoding
+	/// and non-manifold vertices are split, so the decoded SoupMesh may contain duplicated vertices.
+	class MeshCodec
+	{
+		public:
+			struct Report
+			{
+				size_t raw_bytes{0};
+				size_t encoded_bytes{0};
+				size_t connectivity_bytes{0};
+				size_t geometry_bytes{0};
+				size_t triangles{0};
+				size_t vertices{0};
+				double encode_seconds{0.};
+				double decode_seconds{0.};
+
+				/// Returns raw_bytes / encoded_bytes.
+				double ratio() const;
+				/// Returns raw megabytes per second, 0 if the operation has not run yet.
+				double encode_throughput() const;
+				double decode_throughput() const;
+			};
+
+			/// Number of quantization bits for each attribute, between 1 and 24.
+			/// Throws invalid_argument otherwise.
+			explicit MeshCodec(int position_bits = 14, int normal_bits = 10, int texture_coordinate_bits = 12);
+
+			std::vector<std::uint8_t> encode(const HalfEdgeMesh& mesh);
+			/// Throws runtime_error if the data is not a valid mesh stream.
+			SoupMesh decode(const std::vector<std::uint8_t>& data);
+
+			void write_file(const HalfEdgeMesh& mesh, const std::string& file_path);
+			SoupMesh read_file(const std::string& file_path);
+
+			/// Statistics of the last encode and decode calls.
+			const Report& get_report() const;
+
+		private:
+			int position_bits;
+			int normal_bits;
+			int texture_coordinate_bits;
+
+			Report report;
+	};
+
+	std::ostream& operator<<(std::ostream& os, const MeshCodec::Report& report);
+}
+
+#endif // MESH_CODEC_HPP
@@ -0,0 +1,273 @@
+#include "mesh_components.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+
+namespace cg
+{
+	namespace
+	{
+		/// Lock free disjoint set forest, roots are always linked below the smaller index.
+		class UnionFind
+		{
+			public:
+				explicit UnionFind(size_t size) : parent(size)
+				{
+					ThreadPool::get_global().parallel_for(0, size, 65536, [this] (size_t begin, size_t end) {
+						for(size_t i{begin}; i < end; ++i)
+							parent[i].store(static_cast<unsigned int>(i), std::memory_order_relaxed);
+					});
+				}
+
+				unsigned int find(unsigned int x)
+				{
+					while(true)
+					{
+						auto p{parent[x].load(std::memory_order_relaxed)};
+						if(p == x)
+							return x;
+
+						// Path halving, losing the race only means the path stays longer
+						auto grandparent{parent[p].load(std::memory_order_relaxed)};
+						if(p != grandparent)
+							parent[x].compare_exchange_weak(p, grandparent, std::memory_order_relaxed);
+						x = grandparent;
+					}
+				}
+
+				void unite(unsigned int a, unsigned int b)
+				{
+					while(true)
+					{
+						a = find(a);
+						b = find(b);
+						if(a == b)
+							return;
+						if(a < b)
+							std::swap(a, b);
+
+						// Fails if a stopped being a root in the meantime, then search again
+						auto expected{a};
+						if(parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+							return;
+					}
+				}
+
+			private:
+				std::vector<std::atomic<unsigned int>> parent;
+		};
+
+		constexpr size_t face_grain{4096};
+	}
+
+	MeshComponents::MeshComponents(const SoupMesh& soup)
+	{
+		std::cout << "MeshComponents: Started labeling SoupMesh components\n";
+		const auto& faces{soup.get_faces()};
+		auto vertex_count{soup.get_positions().size()};
+		if(vertex_count + faces.size() > std::numeric_limits<unsigned int>::max())
+			throw std::invalid_argument{"MeshComponents: SoupMesh is too large."};
+
+		UnionFind sets{vertex_count};
+		auto& pool{ThreadPool::get_global()};
+		pool.parallel_for(0, faces.size(), face_grain, [&] (size_t begin, size_t end) {
+			for(size_t fi{begin}; fi < end; ++fi)
+			{
+				for(auto index : faces[fi])
+				{
+					if(index >= vertex_count)
+					{
+						std::cerr << "MeshComponents: Face " << fi << " references vertex " << index << " out of " << vertex_count << '\n';
+						throw std::invalid_argument{"MeshComponents: Labeling SoupMesh failed."};
+					}
+					sets.unite(faces[fi].front(), index);
+				}
+			}
+		});
+
+		// Faces without vertices form components of their own
+		std::vector<unsigned int> roots(faces.size());
+		pool.parallel_for(0, faces.size(), face_grain, [&] (size_t begin, size_t end) {
+			for(size_t fi{begin}; fi < end; ++fi)
+				roots[fi] = faces[fi].empty() ? static_cast<unsigned int>(vertex_count + fi) : sets.find(faces[fi].front());
+		});
+
+		assign_labels(roots);
+	}
+
+	MeshComponents::MeshComponents(const HalfEdgeMesh& mesh)
+	{
+		std::cout << "MeshComponents: Started labeling HalfEdgeMesh components\n";
+		const auto& faces{mesh.get_faces()};
+		if(faces.size() > std::numeric_limits<unsigned int>::max())
+			throw std::invalid_argument{"MeshComponents: HalfEdgeMesh is too large."};
+
+		UnionFind sets{faces.size()};
+		auto& pool{ThreadPool::get_global()};
+		pool.parallel_for(0, faces.size(), face_grain, [&] (size_t begin, size_t end) {
+			for(size_t fi{begin}; fi < end; ++fi)
+			{
+				HalfEdgeMesh::HalfEdge* current{faces[fi]->edge};
+				if(!current)
+					continue;
+
+				do {
+					// Every interior edge is seen from both sides, uniting once is enough
+					auto* neighbour{current->companion_edge->face};
+					if(neighbour && neighbour < faces[fi].get())
+						sets.unite(static_cast<unsigned int>(fi), static_cast<unsigned int>(mesh.index_of(neighbour)));
+					current = HalfEdgeMesh::face_loop_next(current);
+				} while(current && current != faces[fi]->edge);
+
+				if(!current)
+					throw std::runtime_error{"MeshComponents: Faceloop reached nullptr during labeling."};
+			}
+		});
+
+		std::vector<unsigned int> roots(faces.size());
+		pool.parallel_for(0, faces.size(), face_grain, [&] (size_t begin, size_t end) {
+			for(size_t fi{begin}; fi < end; ++fi)
+				roots[fi] = sets.find(static_cast<unsigned int>(fi));
+		});
+
+		assign_labels(roots);
+	}
+
+	size_t MeshComponents::get_component_count() const
+	{
+		return face_counts.size();
+	}
+
+	const std::vector<unsigned int>& MeshComponents::get_face_labels() const
+	{
+		return face_labels;
+	}
+
+	const std::vector<size_t>& MeshComponents::get_face_counts() const
+	{
+		return face_counts;
+	}
+
+	std::vector<SoupMesh> MeshComponents::split(const SoupMesh& soup, size_t min_faces, size_t max_faces) const
+	{
+		const auto& faces{soup.get_faces()};
+		if(faces.size() != face_labels.size())
+		{
+			std::cerr << "MeshComponents: Split called with " << faces.size() << " faces but " << face_labels.size() << " were labeled\n";
+			throw std::invalid_argument{"MeshComponents: Split failed."};
+		}
+
+		std::cout << "MeshComponents: Started splitting into components with " << min_faces << " to " << max_faces << " faces\n";
+
+		// Group the faces by component, labels are sorted by size so the selection is a contiguous range
+		std::vector<size_t> offsets(face_counts.size() + 1, 0);
+		std::partial_sum(face_counts.begin(), face_counts.end(), offsets.begin() + 1);
+		std::vector<unsigned int> grouped(faces.size());
+		{
+			auto fill{offsets};
+			for(size_t fi{0}; fi < faces.size(); ++fi)
+				grouped[fill[face_labels[fi]]++] = static_cast<unsigned int>(fi);
+		}
+
+		auto first{static_cast<size_t>(std::find_if(face_counts.begin(), face_counts.end(), [max_faces] (size_t count) { return count <= max_faces; }) - face_counts.begin())};
+		auto last{static_cast<size_t>(std::find_if(face_counts.begin() + first, face_counts.end(), [min_faces] (size_t count) { return count < min_faces; }) - face_counts.begin())};
+
+		const auto& positions{soup.get_positions()};
+		const auto& normals{soup.get_normals()};
+		const auto& texture_coordinates{soup.get_texture_coordinates()};
+		bool has_normals{normals.size() == positions.size()};
+		bool has_texture_coordinates{texture_coordinates.size() == positions.size()};
+
+		std::vector<std::optional<SoupMesh>> parts(last - first);
+		ThreadPool::get_global().parallel_for(first, last, 1, [&] (size_t begin, size_t end) {
+			for(size_t component{begin}; component < end; ++component)
+			{
+				// Components of a HalfEdgeMesh may share vertices, so every part searches its own sorted vertex list
+				std::vector<unsigned int> used{};
+				for(auto i{offsets[component]}; i < offsets[component + 1]; ++i)
+					used.insert(used.end(), faces[grouped[i]].begin(), faces[grouped[i]].end());
+				std::sort(used.begin(), used.end());
+				used.erase(std::unique(used.begin(), used.end()), used.end());
+
+				std::vector<glm::vec3> part_positions(used.size());
+				std::vector<glm::vec3> part_normals(has_normals ? used.size() : 0);
+				std::vector<glm::vec2> part_texture_coordinates(has_texture_coordinates ? used.size() : 0);
+				for(size_t i{0}; i < used.size(); ++i)
+				{
+					part_positions[i] = positions[used[i]];
+					if(has_normals)
+						part_normals[i] = normals[used[i]];
+					if(has_texture_coordinates)
+						part_texture_coordinates[i] = texture_coordinates[used[i]];
+				}
+
+				std::vector<std::vector<unsigned int>> part_faces{};
+				part_faces.reserve(offsets[component + 1] - offsets[component]);
+				for(auto i{offsets[component]}; i < offsets[component + 1]; ++i)
+				{
+					part_faces.emplace_back(faces[grouped[i]].size());
+					std::transform(faces[grouped[i]].begin(), faces[grouped[i]].end(), part_faces.back().begin(), [&used] (unsigned int index) {
+						return static_cast<unsigned int>(std::lower_bound(used.begin(), used.end(), index) - used.begin());
+					});
+				}
+
+				parts[component - first].emplace(part_positions, part_normals, part_texture_coordinates, part_faces);
+			}
+		});
+
+		std::vector<SoupMesh> meshes{};
+		meshes.reserve(parts.size());
+		for(auto& part : parts)
+			meshes.push_back(std::move(*part));
+
+		std::cout << "MeshComponents: Successfully split into " << meshes.size() << " of " << face_counts.size() << " components\n";
+
+		return meshes;
+	}
+
+	void MeshComponents::assign_labels(const std::vector<unsigned int>& roots)
+	{
+		// Number the roots by their first face
+		std::vector<unsigned int> root_labels(roots.empty() ? 0 : *std::max_element(roots.begin(), roots.end()) + size_t{1}, std::numeric_limits<unsigned int>::max());
+		std::vector<size_t> counts{};
+		face_labels.resize(roots.size());
+		for(size_t fi{0}; fi < roots.size(); ++fi)
+		{
+			auto& label{root_labels[roots[fi]]};
+			if(label == std::numeric_limits<unsigned int>::max())
+			{
+				label = static_cast<unsigned int>(counts.size());
+				counts.push_back(0);
+			}
+			face_labels[fi] = label;
+			++counts[label];
+		}
+
+		// Renumber by decreasing size, stable so equal sizes keep the order of their first face
+		std::vector<unsigned int> order(counts.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&counts] (unsigned int a, unsigned int b) { return counts[a] > counts[b]; });
+
+		std::vector<unsigned int> rank(counts.size());
+		face_counts.resize(counts.size());
+		for(size_t i{0}; i < order.size(); ++i)
+		{
+			rank[order[i]] = static_cast<unsigned int>(i);
+			face_counts[i] = counts[order[i]];
+		}
+
+		ThreadPool::get_global().parallel_for(0, face_labels.size(), face_grain, [this, &rank] (size_t begin, size_t end) {
+			for(size_t fi{begin}; fi < end; ++fi)
+				face_labels[fi] = rank[face_labels[fi]];
+		});
+
+		std::cout << "MeshComponents: Successfully labeled " << face_counts.size() << " components in " << face_labels.size() << " faces\n";
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef MESH_COMPONENTS_HPP
+#define MESH_COMPONENTS_HPP
+
+#include "half_edge_mesh.hpp"
+#include "soup_mesh.hpp"
+
+#include <vector>
+
+namespace cg
+{
+	/// Labels the connected components of a mesh's faces with a parallel union-find.
+	/// Components are numbered by decreasing face count, ties are broken by their first face.
+	class MeshComponents
+	{
+		public:
+			/// Faces sharing a vertex belong to the same component.
+			explicit MeshComponents(const SoupMesh& soup);
+			/// Faces sharing an edge belong to the same component, labels follow the order of get_faces()
+			/// which is also the face order of toSoupMesh().
+			explicit MeshComponents(const HalfEdgeMesh& mesh);
+
+			size_t get_component_count() const;
+			/// Component of every face.
+			const std::vector<unsigned int>& get_face_labels() const;
+			/// Number of faces of every component, decreasing.
+			const std::vector<size_t>& get_face_counts() const;
+
+			/// Splits soup into one mesh per component with compacted vertices, keeping only components
+			/// with at least min_faces and at most max_faces faces. soup has to be the labeled mesh or
+			/// the result of toSoupMesh() on it, otherwise invalid_argument is thrown.
+			std::vector<SoupMesh> split(const SoupMesh& soup, size_t min_faces = 1, size_t max_faces = static_cast<size_t>(-1)) const;
+
+		private:
+			/// Turns per face union-find roots into dense labels sorted by component size.
+			void assign_labels(const std::vector<unsigned int>& roots);
+
+			std::vector<unsigned int> face_labels;
+			std::vector<size_t> face_counts;
+	};
+}
+
+#endif // MESH_COMPONENTS_HPP
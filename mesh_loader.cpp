@@ -0,0 +1,107 @@
+#include "mesh_loader.hpp"
+
+#include <chrono>
+#include <iostream>
+
+namespace cg
+{
+	MeshLoader::MeshLoader(std::string file_path, Process process)
+		: file_path{std::move(file_path)},
+		  worker{&MeshLoader::run, this, std::move(process)}
+	{
+	}
+
+	MeshLoader::~MeshLoader()
+	{
+		if(worker.joinable())
+			worker.join();
+	}
+
+	MeshLoader::Stage MeshLoader::get_stage() const
+	{
+		return stage.load();
+	}
+
+	float MeshLoader::get_progress() const
+	{
+		auto current{stage.load()};
+		if(current == Stage::failed)
+			return 0.f;
+		return static_cast<float>(current) / static_cast<float>(Stage::finished);
+	}
+
+	const char* MeshLoader::get_stage_name(Stage stage)
+	{
+		switch(stage)
+		{
+			case Stage::importing:
+				return "importing";
+			case Stage::converting:
+				return "converting to half edges";
+			case Stage::processing:
+				return "processing";
+			case Stage::converting_back:
+				return "converting to triangle soup";
+			case Stage::preparing:
+				return "preparing buffers";
+			case Stage::finished:
+				return "finished";
+			case Stage::failed:
+				return "failed";
+		}
+		return "";
+	}
+
+	void MeshLoader::wait()
+	{
+		if(worker.joinable())
+			worker.join();
+	}
+
+	std::optional<MeshRenderer::Geometry> MeshLoader::take()
+	{
+		auto current{stage.load()};
+		if(taken || (current != Stage::finished && current != Stage::failed))
+			return std::nullopt;
+
+		wait();
+		taken = true;
+		if(error)
+			std::rethrow_exception(error);
+		return std::move(geometry);
+	}
+
+	void MeshLoader::run(Process process)
+	{
+		using Clock = std::chrono::steady_clock;
+		auto start{Clock::now()};
+		auto advance{[this, &start] (Stage next) {
+			auto now{Clock::now()};
+			std::cout << "MeshLoader: " << get_stage_name(stage.load()) << ' ' << file_path << " took "
+				<< std::chrono::duration<double, std::milli>(now - start).count() << " ms\n";
+			start = now;
+			stage.store(next);
+		}};
+
+		try
+		{
+			SoupMesh mesh{file_path};
+			advance(Stage::converting);
+			HalfEdgeMesh hemesh{mesh};
+			advance(Stage::processing);
+			if(process)
+				process(mesh, hemesh);
+			advance(Stage::converting_back);
+			mesh = hemesh.toSoupMesh();
+			advance(Stage::preparing);
+			geometry = MeshRenderer::build_geometry(mesh);
+			advance(Stage::finished);
+		}
+		catch(...)
+		{
+			std::cerr << "MeshLoader: Loading " << file_path << " failed while " << get_stage_name(stage.load()) << '\n';
+			error = std::current_exception();
+			stage.store(Stage::failed);
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef MESH_LOADER_HPP
+#define MESH_LOADER_HPP
+
+#include "half_edge_mesh.hpp"
+#include "mesh_renderer.hpp"
+#include "soup_mesh.hpp"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace cg
+{
+	/// Loads a mesh file on a background thread: imports it, converts it to a HalfEdgeMesh, optionally processes it,
+	/// converts it back and builds the geometry of a MeshRenderer. The render thread polls take and only uploads.
+	class MeshLoader
+	{
+		public:
+			enum class Stage
+			{
+				importing,
+				converting,
+				processing,
+				converting_back,
+				preparing,
+				finished,
+				failed
+			};
+
+			/// Runs on the loader thread with the imported mesh and its half edge version, e.g. to simplify it.
+			using Process = std::function<void(const SoupMesh& mesh, HalfEdgeMesh& hemesh)>;
+
+			explicit MeshLoader(std::string file_path, Process process = {});
+			/// Waits for the loader thread, a running import cannot be interrupted.
+			~MeshLoader();
+
+			MeshLoader(const MeshLoader&) = delete;
+			MeshLoader& operator=(const MeshLoader&) = delete;
+
+			Stage get_stage() const;
+			/// Fraction of the stages done, in [0, 1].
+			float get_progress() const;
+			static const char* get_stage_name(Stage stage);
+
+			/// Blocks until the mesh is loaded or loading failed.
+			void wait();
+			/// Returns the geometry once loading finished and nothing before or after.
+			/// Rethrows the exception that made loading fail.
+			std::optional<MeshRenderer::Geometry> take();
+
+		private:
+			void run(Process process);
+
+			std::string file_path;
+			std::atomic<Stage> stage{Stage::importing};
+			/// Written by the loader thread before stage becomes finished or failed.
+			std::optional<MeshRenderer::Geometry> geometry{};
+			std::exception_ptr error{};
+			bool taken{false};
+			std::thread worker;
+	};
+}
+
+#endif // MESH_LOADER_HPP
@@ -0,0 +1,479 @@
+#include "mesh_renderer.hpp"
+
+#include "grid_indices.hpp"
+#include "program_manager.hpp"
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace cg
+{
+	namespace
+	{
+		struct Program
+		{
+			bool loaded{false};
+			ProgramManager::Handle handle{0};
+			size_t version{0};
+			GLint mvp_uniform{-1};
+			GLint normal_matrix_uniform{-1};
+		};
+
+		/// GL state shared by all renderers of the one context.
+		struct SharedState
+		{
+			size_t renderers{0};
+			Program lit{};
+			Program instanced{};
+			GLint mvp_uniform{-1};
+			GLint normal_matrix_uniform{-1};
+
+			GLuint bound_program{0};
+			GLuint bound_vao{0};
+			bool restart_enabled{false};
+			bool restart_known{false};
+		};
+
+		SharedState state{};
+
+		/// Uniform locations change with every reload of the program.
+		void use_program(Program& current, const char* vertex_shader)
+		{
+			auto& programs{ProgramManager::get_global()};
+			if(!current.loaded)
+			{
+				current.handle = programs.load({vertex_shader}, {"shaders/fragment_shader.glsl"});
+				current.loaded = true;
+				current.version = programs.get_version(current.handle) + 1;
+			}
+
+			auto program{programs.get_program(current.handle)};
+			if(state.bound_program != program)
+			{
+				glUseProgram(program);
+				state.bound_program = program;
+			}
+
+			if(current.version != programs.get_version(current.handle))
+			{
+				current.version = programs.get_version(current.handle);
+				current.mvp_uniform = glGetUniformLocation(program, "mvp");
+				current.normal_matrix_uniform = glGetUniformLocation(program, "normal_matrix");
+				glUniform3fv(glGetUniformLocation(program, "light_direction"), 1, glm::value_ptr(glm::normalize(glm::vec3{.3f, .5f, 1.f})));
+			}
+			state.mvp_uniform = current.mvp_uniform;
+			state.normal_matrix_uniform = current.normal_matrix_uniform;
+		}
+
+		/// Bounds of the vertices referenced by indices[first, first + count), skipping restart indices.
+		void bound_chunk(const std::vector<MeshRenderer::Vertex>& vertices, const std::vector<unsigned int>& indices, MeshRenderer::Chunk& chunk)
+		{
+			chunk.bounds_min = glm::vec3{std::numeric_limits<float>::max()};
+			chunk.bounds_max = glm::vec3{std::numeric_limits<float>::lowest()};
+			for(auto i{chunk.first}; i < chunk.first + chunk.count; ++i)
+			{
+				if(indices[i] == grid_indices::restart_index)
+					continue;
+				chunk.bounds_min = glm::min(chunk.bounds_min, vertices[indices[i]].position);
+				chunk.bounds_max = glm::max(chunk.bounds_max, vertices[indices[i]].position);
+			}
+		}
+
+		void bind_vertex_array(GLuint vao)
+		{
+			if(state.bound_vao != vao)
+			{
+				glBindVertexArray(vao);
+				state.bound_vao = vao;
+			}
+		}
+	}
+
+	MeshRenderer::MeshRenderer()
+		: vertex_buffer{GL_ARRAY_BUFFER},
+		  index_buffer{GL_ELEMENT_ARRAY_BUFFER}
+	{
+		++state.renderers;
+
+		// Storage of the buffers may change with every upload but their names stay, so the layout is set once
+		glGenVertexArrays(1, &vao);
+		bind_vertex_array(vao);
+		vertex_buffer.bind();
+		index_buffer.bind();
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void*>(offsetof(Vertex, position)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void*>(offsetof(Vertex, normal)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void*>(offsetof(Vertex, texture_coordinate)));
+	}
+
+	MeshRenderer::MeshRenderer(const SoupMesh& mesh)
+		: MeshRenderer{}
+	{
+		upload(mesh);
+	}
+
+	MeshRenderer::MeshRenderer(const RegularMesh& mesh)
+		: MeshRenderer{}
+	{
+		upload(mesh);
+	}
+
+	MeshRenderer::~MeshRenderer()
+	{
+		if(vao)
+		{
+			if(state.bound_vao == vao)
+				state.bound_vao = 0;
+			glDeleteVertexArrays(1, &vao);
+		}
+
+		// The program itself stays with the ProgramManager
+		if(--state.renderers == 0)
+			state = SharedState{};
+	}
+
+	MeshRenderer::MeshRenderer(MeshRenderer&& other) noexcept
+		: vao{std::exchange(other.vao, 0)},
+		  vertex_buffer{std::move(other.vertex_buffer)},
+		  index_buffer{std::move(other.index_buffer)},
+		  mode{other.mode},
+		  vertex_count{std::exchange(other.vertex_count, 0)},
+		  index_count{std::exchange(other.index_count, 0)},
+		  chunks{std::move(other.chunks)},
+		  chunk_bounds{std::move(other.chunk_bounds)}
+	{
+		++state.renderers;
+	}
+
+	MeshRenderer& MeshRenderer::operator=(MeshRenderer&& other) noexcept
+	{
+		std::swap(vao, other.vao);
+		std::swap(vertex_buffer, other.vertex_buffer);
+		std::swap(index_buffer, other.index_buffer);
+		std::swap(mode, other.mode);
+		std::swap(vertex_count, other.vertex_count);
+		std::swap(index_count, other.index_count);
+		std::swap(chunks, other.chunks);
+		std::swap(chunk_bounds, other.chunk_bounds);
+		return *this;
+	}
+
+	void MeshRenderer::upload(const SoupMesh& mesh)
+	{
+		upload(build_geometry(mesh));
+	}
+
+	void MeshRenderer::upload(const RegularMesh& mesh)
+	{
+		upload(build_geometry(mesh));
+	}
+
+	void MeshRenderer::upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLenum mode)
+	{
+		// The element array binding belongs to the vertex array
+		bind_vertex_array(vao);
+		vertex_buffer.upload(vertices);
+		index_buffer.upload(indices);
+		this->mode = mode;
+		vertex_count = vertices.size();
+		index_count = indices.size();
+		chunks.clear();
+		chunk_bounds.clear();
+	}
+
+	void MeshRenderer::upload(const Geometry& geometry)
+	{
+		upload(geometry.vertices, geometry.indices, geometry.mode);
+		chunks = geometry.chunks;
+		for(const auto& chunk : chunks)
+			chunk_bounds.add(chunk.bounds_min, chunk.bounds_max);
+	}
+
+	MeshRenderer::Geometry MeshRenderer::build_geometry(const SoupMesh& mesh)
+	{
+		Geometry geometry{interleave(mesh.get_positions(), mesh.get_normals(), mesh.get_texture_coordinates()), {}, GL_TRIANGLES, {}};
+		auto triangles{mesh.calculate_indices()};
+		derive_normals(geometry.vertices, triangles);
+
+		auto triangle_count{triangles.size() / 3};
+		std::vector<glm::vec3> centroids(triangle_count);
+		for(size_t t{0}; t < triangle_count; ++t)
+		{
+			centroids[t] = (geometry.vertices[triangles[3 * t]].position + geometry.vertices[triangles[3 * t + 1]].position
+				+ geometry.vertices[triangles[3 * t + 2]].position) / 3.f;
+		}
+
+		// Splits depth first with the lower half first, so neighbouring chunks also end up close in the index buffer
+		std::vector<unsigned int> order(triangle_count);
+		std::iota(order.begin(), order.end(), 0u);
+		std::vector<std::pair<size_t, size_t>> ranges{{0, triangle_count}};
+		geometry.indices.reserve(triangles.size());
+		while(!ranges.empty())
+		{
+			auto [begin, end]{ranges.back()};
+			ranges.pop_back();
+			if(end - begin <= chunk_triangles)
+			{
+				Chunk chunk{geometry.indices.size(), 3 * (end - begin), glm::vec3{0.f}, glm::vec3{0.f}};
+				for(auto i{begin}; i < end; ++i)
+					geometry.indices.insert(geometry.indices.end(), triangles.begin() + 3 * order[i], triangles.begin() + 3 * order[i] + 3);
+				if(chunk.count)
+				{
+					bound_chunk(geometry.vertices, geometry.indices, chunk);
+					geometry.chunks.push_back(chunk);
+				}
+				continue;
+			}
+
+			glm::vec3 min{std::numeric_limits<float>::max()};
+			glm::vec3 max{std::numeric_limits<float>::lowest()};
+			for(auto i{begin}; i < end; ++i)
+			{
+				min = glm::min(min, centroids[order[i]]);
+				max = glm::max(max, centroids[order[i]]);
+			}
+			auto extent{max - min};
+			auto axis{extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2};
+
+			auto middle{begin + (end - begin) / 2};
+			std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&centroids, axis] (unsigned int a, unsigned int b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+			ranges.push_back({middle, end});
+			ranges.push_back({begin, middle});
+		}
+		return geometry;
+	}
+
+	MeshRenderer::Geometry MeshRenderer::build_geometry(const RegularMesh& mesh)
+	{
+		Geometry geometry{interleave(mesh.get_positions(), mesh.get_normals(), mesh.get_texture_coordinates()), {}, GL_TRIANGLE_STRIP, {}};
+		derive_normals(geometry.vertices, *mesh.get_triangle_indices());
+
+		// Same strips as grid_indices::strips, cut into square blocks of quads
+		auto width{mesh.get_width()};
+		auto height{mesh.get_height()};
+		for(size_t block_row{0}; block_row + 1 < height; block_row += chunk_quads)
+		{
+			for(size_t block_col{0}; block_col + 1 < width; block_col += chunk_quads)
+			{
+				auto row_end{std::min(block_row + chunk_quads, height - 1)};
+				auto col_end{std::min(block_col + chunk_quads, width - 1)};
+				Chunk chunk{geometry.indices.size(), 0, glm::vec3{0.f}, glm::vec3{0.f}};
+				for(auto row{block_row}; row < row_end; ++row)
+				{
+					if(row != block_row)
+						geometry.indices.push_back(grid_indices::restart_index);
+
+					auto top{static_cast<unsigned int>(row * width)};
+					auto bottom{static_cast<unsigned int>(top + width)};
+					geometry.indices.push_back(bottom + static_cast<unsigned int>(block_col));
+					for(auto col{static_cast<unsigned int>(block_col)}; col <= col_end; ++col)
+					{
+						geometry.indices.push_back(bottom + col);
+						geometry.indices.push_back(top + col);
+					}
+				}
+				chunk.count = geometry.indices.size() - chunk.first;
+				bound_chunk(geometry.vertices, geometry.indices, chunk);
+				geometry.chunks.push_back(chunk);
+				geometry.indices.push_back(grid_indices::restart_index);
+			}
+		}
+		return geometry;
+	}
+
+	std::vector<MeshRenderer::Vertex> MeshRenderer::interleave(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec2>& texture_coordinates)
+	{
+		if((!normals.empty() && normals.size() != positions.size()) || (!texture_coordinates.empty() && texture_coordinates.size() != positions.size()))
+		{
+			std::cerr << "MeshRenderer: " << positions.size() << " positions with " << normals.size() << " normals and "
+				<< texture_coordinates.size() << " texture coordinates\n";
+			throw std::invalid_argument{"Vertex interleaving failed."};
+		}
+
+		std::vector<Vertex> vertices(positions.size(), Vertex{glm::vec3{0.f}, glm::vec3{0.f}, glm::vec2{0.f}});
+		for(size_t i{0}; i < vertices.size(); ++i)
+		{
+			vertices[i].position = positions[i];
+			if(!normals.empty())
+				vertices[i].normal = normals[i];
+			if(!texture_coordinates.empty())
+				vertices[i].texture_coordinate = texture_coordinates[i];
+		}
+		return vertices;
+	}
+
+	void MeshRenderer::derive_normals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		std::vector<bool> missing(vertices.size());
+		bool any_missing{false};
+		for(size_t i{0}; i < vertices.size(); ++i)
+		{
+			missing[i] = vertices[i].normal == glm::vec3{0.f};
+			any_missing = any_missing || missing[i];
+		}
+		if(!any_missing)
+			return;
+
+		// Unnormalized cross products weight every face by its area
+		for(size_t i{0}; i + 2 < indices.size(); i += 3)
+		{
+			auto a{indices[i]}, b{indices[i + 1]}, c{indices[i + 2]};
+			auto normal{glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position)};
+			for(auto index : {a, b, c})
+				if(missing[index])
+					vertices[index].normal += normal;
+		}
+
+		for(size_t i{0}; i < vertices.size(); ++i)
+			if(missing[i] && vertices[i].normal != glm::vec3{0.f})
+				vertices[i].normal = glm::normalize(vertices[i].normal);
+	}
+
+	void MeshRenderer::draw(const glm::mat4& view_projection, const glm::mat4& model) const
+	{
+		if(!index_count)
+			return;
+
+		if(chunks.empty())
+		{
+			prepare(view_projection, model);
+			glDrawElements(mode, static_cast<GLsizei>(index_count), GL_UNSIGNED_INT, nullptr);
+			return;
+		}
+
+		visible_chunks.clear();
+		Frustum{view_projection * model}.cull(chunk_bounds, visible_chunks);
+		if(visible_chunks.empty())
+			return;
+
+		// Chunks of strips are separated by one restart index, which joins them into one range as well
+		size_t separator{mode == GL_TRIANGLE_STRIP ? size_t{1} : size_t{0}};
+		counts.clear();
+		offsets.clear();
+		size_t end{0};
+		for(auto index : visible_chunks)
+		{
+			const auto& chunk{chunks[index]};
+			if(!counts.empty() && chunk.first == end + separator)
+				counts.back() += static_cast<GLsizei>(separator + chunk.count);
+			else
+			{
+				counts.push_back(static_cast<GLsizei>(chunk.count));
+				offsets.push_back(reinterpret_cast<const void*>(chunk.first * sizeof(unsigned int)));
+			}
+			end = chunk.first + chunk.count;
+		}
+
+		prepare(view_projection, model);
+		glMultiDrawElements(mode, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(counts.size()));
+	}
+
+	void MeshRenderer::draw(const glm::mat4& view_projection, const glm::mat4& model, const std::vector<GLint>& base_vertices) const
+	{
+		if(!index_count || base_vertices.empty())
+			return;
+
+		prepare(view_projection, model);
+		counts.assign(base_vertices.size(), static_cast<GLsizei>(index_count));
+		offsets.assign(base_vertices.size(), nullptr);
+		glMultiDrawElementsBaseVertex(mode, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(base_vertices.size()),
+			const_cast<GLint*>(base_vertices.data()));
+	}
+
+	void MeshRenderer::draw(const glm::mat4& view_projection, InstanceBuffer& instances, const glm::mat4& model) const
+	{
+		instances.sync();
+		if(!index_count || !instances.size())
+			return;
+
+		// The same mesh may be drawn with several instance buffers, so the instance attributes are pointed at this one
+		bind_vertex_array(vao);
+		instances.bind();
+		auto offset{instances.get_offset()};
+		for(GLuint column{0}; column < 4; ++column)
+		{
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceBuffer::Instance),
+				reinterpret_cast<const void*>(offset + offsetof(InstanceBuffer::Instance, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+		for(GLuint column{0}; column < 3; ++column)
+		{
+			glEnableVertexAttribArray(7 + column);
+			glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceBuffer::Instance),
+				reinterpret_cast<const void*>(offset + offsetof(InstanceBuffer::Instance, normal_matrix) + column * sizeof(glm::vec3)));
+			glVertexAttribDivisor(7 + column, 1);
+		}
+
+		prepare(view_projection, model, true);
+		glDrawElementsInstanced(mode, static_cast<GLsizei>(index_count), GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(instances.size()));
+	}
+
+	void MeshRenderer::invalidate_state()
+	{
+		state.bound_program = 0;
+		state.bound_vao = 0;
+		state.restart_known = false;
+	}
+
+	size_t MeshRenderer::get_vertex_count() const
+	{
+		return vertex_count;
+	}
+
+	size_t MeshRenderer::get_index_count() const
+	{
+		return index_count;
+	}
+
+	size_t MeshRenderer::get_chunk_count() const
+	{
+		return chunks.size();
+	}
+
+	size_t MeshRenderer::get_visible_chunk_count() const
+	{
+		return chunks.empty() ? 0 : visible_chunks.size();
+	}
+
+	void MeshRenderer::prepare(const glm::mat4& view_projection, const glm::mat4& model, bool instanced) const
+	{
+		if(instanced)
+			use_program(state.instanced, "shaders/instanced_vertex_shader.glsl");
+		else
+			use_program(state.lit, "shaders/vertex_shader.glsl");
+		bind_vertex_array(vao);
+
+		// Only strips are separated by restart indices
+		auto restart{mode == GL_TRIANGLE_STRIP};
+		if(!state.restart_known || state.restart_enabled != restart)
+		{
+			if(restart)
+			{
+				glEnable(GL_PRIMITIVE_RESTART);
+				glPrimitiveRestartIndex(grid_indices::restart_index);
+			}
+			else
+				glDisable(GL_PRIMITIVE_RESTART);
+			state.restart_enabled = restart;
+			state.restart_known = true;
+		}
+
+		auto mvp{view_projection * model};
+		auto normal_matrix{glm::transpose(glm::inverse(glm::mat3{model}))};
+		glUniformMatrix4fv(state.mvp_uniform, 1, GL_FALSE, glm::value_ptr(mvp));
+		glUniformMatrix3fv(state.normal_matrix_uniform, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+	}
+}
@@ -0,0 +1,125 @@
+#ifndef MESH_RENDERER_HPP
+#define MESH_RENDERER_HPP
+
+#include "frustum.hpp"
+#include "gpu_buffer.hpp"
+#include "instance_buffer.hpp"
+#include "regular_mesh.hpp"
+#include "soup_mesh.hpp"
+
+#include "GL/glew.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+namespace cg
+{
+	/// Draws a mesh from one interleaved vertex buffer with the lit shader in shaders/, which all renderers share
+	/// through ProgramManager::get_global(). Instanced draws use the same shader with per instance matrices.
+	/// The program, vertex array and primitive restart state of the last draw are cached, so consecutive draws only
+	/// change the state that differs.
+	class MeshRenderer
+	{
+		public:
+			/// Layout of the vertex buffer, bound to attribute locations 0, 1 and 2.
+			struct Vertex
+			{
+				glm::vec3 position;
+				glm::vec3 normal;
+				glm::vec2 texture_coordinate;
+			};
+
+			/// Spatially compact range of the index buffer, chunks of strips are followed by a restart index.
+			struct Chunk
+			{
+				size_t first;
+				size_t count;
+				glm::vec3 bounds_min;
+				glm::vec3 bounds_max;
+			};
+
+			/// Everything upload needs, built without a context so it can be prepared on other threads.
+			struct Geometry
+			{
+				std::vector<Vertex> vertices;
+				std::vector<unsigned int> indices;
+				GLenum mode;
+				/// Drawn separately and culled against the view frustum, without chunks the whole buffer is drawn.
+				std::vector<Chunk> chunks;
+			};
+
+			/// Soup triangles are split into chunks of at most this many triangles.
+			static constexpr size_t chunk_triangles{4096};
+			/// Grids are split into chunks of chunk_quads x chunk_quads quads.
+			static constexpr size_t chunk_quads{48};
+
+			/// Draws nothing until upload is called.
+			MeshRenderer();
+			explicit MeshRenderer(const SoupMesh& mesh);
+			explicit MeshRenderer(const RegularMesh& mesh);
+			~MeshRenderer();
+
+			MeshRenderer(const MeshRenderer&) = delete;
+			MeshRenderer& operator=(const MeshRenderer&) = delete;
+			MeshRenderer(MeshRenderer&& other) noexcept;
+			MeshRenderer& operator=(MeshRenderer&& other) noexcept;
+
+			/// Uploads the triangulated faces of mesh, missing normals are derived from the faces.
+			/// Triangles are sorted into chunks by recursively splitting them at the median of their longest axis.
+			void upload(const SoupMesh& mesh);
+			/// Uploads mesh as triangle strips in square chunks, with the triangles of grid_indices::strips.
+			/// Missing normals are derived from the triangles.
+			void upload(const RegularMesh& mesh);
+			/// Uploads vertices drawn as mode with indices, restart_index separates primitives of strips.
+			/// Buffers keep their storage across uploads, see GpuBuffer.
+			void upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLenum mode = GL_TRIANGLES);
+			void upload(const Geometry& geometry);
+
+			/// Geometry uploaded by upload(mesh).
+			static Geometry build_geometry(const SoupMesh& mesh);
+			static Geometry build_geometry(const RegularMesh& mesh);
+
+			/// Throws invalid_argument if normals or texture coordinates are given but differ in size from positions.
+			static std::vector<Vertex> interleave(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+				const std::vector<glm::vec2>& texture_coordinates);
+			/// Replaces zero normals by the area weighted normal of the triangles in indices that share the vertex.
+			static void derive_normals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+			/// Culls the chunks against the view frustum and draws the visible ones with one glMultiDrawElements,
+			/// chunks that follow each other in the index buffer are merged into one range.
+			void draw(const glm::mat4& view_projection, const glm::mat4& model = glm::mat4{1.f}) const;
+			/// Draws the index buffer once per base vertex in a single call, for meshes of equally indexed chunks like ChunkedLod.
+			void draw(const glm::mat4& view_projection, const glm::mat4& model, const std::vector<GLint>& base_vertices) const;
+			/// Syncs instances and draws the whole mesh once per instance with one glDrawElementsInstanced, transformed by
+			/// the model matrix of the instance and then by model. Instances are not culled.
+			void draw(const glm::mat4& view_projection, InstanceBuffer& instances, const glm::mat4& model = glm::mat4{1.f}) const;
+
+			/// Forgets the cached state, call after using other programs or vertex arrays in between draws.
+			static void invalidate_state();
+
+			size_t get_vertex_count() const;
+			size_t get_index_count() const;
+			size_t get_chunk_count() const;
+			/// Chunks that passed culling in the last draw.
+			size_t get_visible_chunk_count() const;
+
+		private:
+			/// Instanced draws use shaders/instanced_vertex_shader.glsl.
+			void prepare(const glm::mat4& view_projection, const glm::mat4& model, bool instanced = false) const;
+
+			GLuint vao{0};
+			GpuBuffer vertex_buffer;
+			GpuBuffer index_buffer;
+			GLenum mode{GL_TRIANGLES};
+			size_t vertex_count{0};
+			size_t index_count{0};
+			std::vector<Chunk> chunks;
+			Frustum::Boxes chunk_bounds;
+			mutable std::vector<unsigned int> visible_chunks;
+			mutable std::vector<GLsizei> counts;
+			mutable std::vector<const void*> offsets;
+	};
+}
+
+#endif // MESH_RENDERER_HPP
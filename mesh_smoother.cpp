@@ -0,0 +1,251 @@
+#include "mesh_smoother.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace cg
+{
+	namespace
+	{
+		struct Entry
+		{
+			unsigned int from;
+			unsigned int to;
+			float cotangent;
+		};
+
+		/// Cotangent of the angle at c in triangle (a, b, c).
+		float cotangent(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+		{
+			auto u{a - c};
+			auto v{b - c};
+			auto sine{glm::length(glm::cross(u, v))};
+			return sine > 1e-12f ? glm::dot(u, v) / sine : 0.f;
+		}
+
+		constexpr size_t vertex_grain{4096};
+	}
+
+	MeshSmoother::MeshSmoother(HalfEdgeMesh& mesh, Weights weighting, bool pin_boundary)
+	{
+		std::cout << "MeshSmoother: Started building adjacency\n";
+		auto& pool{ThreadPool::get_global()};
+		const auto& mesh_vertices{mesh.get_vertices()};
+		const auto& faces{mesh.get_faces()};
+
+		vertices.resize(mesh_vertices.size());
+		std::transform(mesh_vertices.begin(), mesh_vertices.end(), vertices.begin(), [] (const auto& v) { return v.get(); });
+		pinned.assign(vertices.size(), 0);
+
+		// Every face edge a -> b adds the entries a -> b and b -> a carrying the cotangent of the angle opposite of it
+		std::vector<size_t> face_offsets(faces.size() + 1, 0);
+		for(size_t fi{0}; fi < faces.size(); ++fi)
+			face_offsets[fi + 1] = face_offsets[fi] + (faces[fi]->edge ? 2 * static_cast<size_t>(HalfEdgeMesh::vertex_count(faces[fi].get()) + 1) : 0);
+
+		std::vector<Entry> entries(face_offsets.back());
+		pool.parallel_for(0, faces.size(), 1024, [&] (size_t begin, size_t end) {
+			std::vector<unsigned int> indices{};
+			for(size_t fi{begin}; fi < end; ++fi)
+			{
+				if(!faces[fi]->edge)
+					continue;
+
+				indices.clear();
+				HalfEdgeMesh::HalfEdge* current{faces[fi]->edge};
+				do {
+					indices.push_back(static_cast<unsigned int>(mesh.index_of(current->next_vertex)));
+					current = HalfEdgeMesh::face_loop_next(current);
+				} while(current && current != faces[fi]->edge);
+
+				if(!current)
+					throw std::runtime_error{"MeshSmoother: Faceloop reached nullptr while building adjacency."};
+
+				auto* out{&entries[face_offsets[fi]]};
+				for(size_t i{0}; i < indices.size(); ++i)
+				{
+					auto a{indices[(i + indices.size() - 1) % indices.size()]};
+					auto b{indices[i]};
+					auto c{indices[(i + 1) % indices.size()]};
+					auto cot{cotangent(vertices[a]->position, vertices[b]->position, vertices[c]->position)};
+					*out++ = {a, b, cot};
+					*out++ = {b, a, cot};
+				}
+			}
+		});
+
+		// Bucket the entries by their first vertex
+		offsets.assign(vertices.size() + 1, 0);
+		for(const auto& entry : entries)
+			++offsets[entry.from + 1];
+		for(size_t i{0}; i < vertices.size(); ++i)
+			offsets[i + 1] += offsets[i];
+
+		std::vector<Entry> sorted(entries.size());
+		{
+			auto fill{offsets};
+			for(const auto& entry : entries)
+				sorted[fill[entry.from]++] = entry;
+		}
+		entries.clear();
+		entries.shrink_to_fit();
+
+		// Merge the two entries of each interior edge and normalize the weights,
+		// an edge seen from a single face lies on the boundary
+		std::vector<unsigned int> counts(vertices.size(), 0);
+		pool.parallel_for(0, vertices.size(), vertex_grain, [&] (size_t begin, size_t end) {
+			for(size_t v{begin}; v < end; ++v)
+			{
+				auto first{sorted.begin() + offsets[v]};
+				auto last{sorted.begin() + offsets[v + 1]};
+				std::sort(first, last, [] (const Entry& a, const Entry& b) { return a.to < b.to; });
+
+				auto out{first};
+				bool boundary{false};
+				for(auto it{first}; it != last;)
+				{
+					auto merged{*it};
+					auto run{it + 1};
+					for(; run != last && run->to == it->to; ++run)
+						merged.cotangent += run->cotangent;
+					boundary |= run - it == 1;
+					*out++ = merged;
+					it = run;
+				}
+
+				auto count{static_cast<unsigned int>(out - first)};
+				float total{0.f};
+				for(auto it{first}; it != out; ++it)
+				{
+					it->cotangent = weighting == Weights::cotangent ? std::max(0.5f * it->cotangent, 0.f) : 1.f;
+					total += it->cotangent;
+				}
+				// Degenerate cotangent weights fall back to uniform ones
+				if(total <= 1e-12f && count > 0)
+				{
+					for(auto it{first}; it != out; ++it)
+						it->cotangent = 1.f;
+					total = static_cast<float>(count);
+				}
+				for(auto it{first}; it != out; ++it)
+					it->cotangent /= total;
+
+				counts[v] = count;
+				if(count == 0 || (pin_boundary && boundary))
+					pinned[v] = 1;
+			}
+		});
+
+		// Compact into the final adjacency
+		std::vector<unsigned int> merged_offsets(vertices.size() + 1, 0);
+		for(size_t v{0}; v < vertices.size(); ++v)
+			merged_offsets[v + 1] = merged_offsets[v] + counts[v];
+
+		neighbours.resize(merged_offsets.back());
+		weights.resize(merged_offsets.back());
+		pool.parallel_for(0, vertices.size(), vertex_grain, [&] (size_t begin, size_t end) {
+			for(size_t v{begin}; v < end; ++v)
+			{
+				for(unsigned int i{0}; i < counts[v]; ++i)
+				{
+					neighbours[merged_offsets[v] + i] = sorted[offsets[v] + i].to;
+					weights[merged_offsets[v] + i] = sorted[offsets[v] + i].cotangent;
+				}
+			}
+		});
+		offsets = std::move(merged_offsets);
+
+		current.resize(vertices.size());
+		next.resize(vertices.size());
+
+		std::cout << "MeshSmoother: Successfully built adjacency for " << vertices.size() << " vertices with " << neighbours.size() << " neighbours and " << get_pinned_count() << " pinned vertices\n";
+	}
+
+	void MeshSmoother::laplacian(int iterations, float lambda)
+	{
+		read_positions();
+		for(int i{0}; i < iterations; ++i)
+			step(lambda);
+		write_positions();
+	}
+
+	void MeshSmoother::taubin(int iterations, float lambda, float mu)
+	{
+		if(lambda <= 0.f || mu >= -lambda)
+		{
+			std::cerr << "MeshSmoother: Taubin smoothing requires mu < -lambda < 0\n";
+			throw std::invalid_argument{"MeshSmoother: Taubin smoothing failed."};
+		}
+
+		read_positions();
+		for(int i{0}; i < iterations; ++i)
+		{
+			step(lambda);
+			step(mu);
+		}
+		write_positions();
+	}
+
+	size_t MeshSmoother::get_pinned_count() const
+	{
+		return static_cast<size_t>(std::count(pinned.begin(), pinned.end(), 1));
+	}
+
+	void MeshSmoother::read_positions()
+	{
+		ThreadPool::get_global().parallel_for(0, vertices.size(), vertex_grain, [this] (size_t begin, size_t end) {
+			for(size_t v{begin}; v < end; ++v)
+				current[v] = {vertices[v]->position.x, vertices[v]->position.y, vertices[v]->position.z, 0.f};
+		});
+	}
+
+	void MeshSmoother::write_positions() const
+	{
+		ThreadPool::get_global().parallel_for(0, vertices.size(), vertex_grain, [this] (size_t begin, size_t end) {
+			for(size_t v{begin}; v < end; ++v)
+				vertices[v]->position = glm::vec3{current[v].x, current[v].y, current[v].z};
+		});
+	}
+
+	void MeshSmoother::step(float factor)
+	{
+		ThreadPool::get_global().parallel_for(0, vertices.size(), vertex_grain, [this, factor] (size_t begin, size_t end) {
+			for(size_t v{begin}; v < end; ++v)
+			{
+				if(pinned[v])
+				{
+					next[v] = current[v];
+					continue;
+				}
+
+#ifdef __SSE__
+				__m128 sum{_mm_setzero_ps()};
+				for(auto i{offsets[v]}; i < offsets[v + 1]; ++i)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_load_ps(&current[neighbours[i]].x)));
+
+				__m128 position{_mm_load_ps(&current[v].x)};
+				_mm_store_ps(&next[v].x, _mm_add_ps(position, _mm_mul_ps(_mm_set1_ps(factor), _mm_sub_ps(sum, position))));
+#else
+				Point sum{0.f, 0.f, 0.f, 0.f};
+				for(auto i{offsets[v]}; i < offsets[v + 1]; ++i)
+				{
+					const auto& neighbour{current[neighbours[i]]};
+					sum.x += weights[i] * neighbour.x;
+					sum.y += weights[i] * neighbour.y;
+					sum.z += weights[i] * neighbour.z;
+				}
+
+				const auto& position{current[v]};
+				next[v] = {position.x + factor * (sum.x - position.x), position.y + factor * (sum.y - position.y),
+					position.z + factor * (sum.z - position.z), 0.f};
+#endif
+			}
+		});
+		std::swap(current, next);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef MESH_SMOOTHER_HPP
+#define MESH_SMOOTHER_HPP
+
+#include "half_edge_mesh.hpp"
+
+#include <vector>
+
+namespace cg
+{
+	/// Laplacian and Taubin smoothing of HalfEdgeMesh vertex positions.
+	/// The neighbourhoods are gathered once into a compressed sparse row adjacency,
+	/// iterations then run as parallel Jacobi steps on a packed copy of the positions.
+	class MeshSmoother
+	{
+		public:
+			enum class Weights
+			{
+				uniform,
+				cotangent
+			};
+
+			/// Cotangent weights are computed from the positions at construction and kept fixed.
+			/// The mesh has to outlive the smoother.
+			explicit MeshSmoother(HalfEdgeMesh& mesh, Weights weights = Weights::uniform, bool pin_boundary = true);
+
+			/// Moves every vertex by lambda towards the weighted average of its neighbours, iterations times.
+			void laplacian(int iterations, float lambda = 0.5f);
+
+			/// Alternates a shrinking lambda step with an inflating mu step to smooth without shrinkage.
+			/// Throws invalid_argument unless mu < -lambda < 0.
+			void taubin(int iterations, float lambda = 0.5f, float mu = -0.53f);
+
+			size_t get_pinned_count() const;
+
+		private:
+			struct alignas(16) Point
+			{
+				float x, y, z, w;
+			};
+
+			void read_positions();
+			void write_positions() const;
+			void step(float factor);
+
+			std::vector<HalfEdgeMesh::Vertex*> vertices;
+
+			// Neighbours of vertex i are neighbours[offsets[i]] to neighbours[offsets[i+1]], weights are normalized
+			std::vector<unsigned int> offsets;
+			std::vector<unsigned int> neighbours;
+			std::vector<float> weights;
+			std::vector<unsigned char> pinned;
+
+			std::vector<Point> current;
+			std::vector<Point> next;
+	};
+}
+
+#endif // MESH_SMOOTHER_HPP
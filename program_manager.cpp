@@ -0,0 +1,389 @@
+#include "program_manager.hpp"
+
+#include "glutil.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace cg
+{
+	namespace
+	{
+		/// FNV-1a, unlike std::hash the value is the same for every build and run.
+		void hash(std::uint64_t& value, const std::string& text)
+		{
+			for(auto c : text)
+			{
+				value ^= static_cast<unsigned char>(c);
+				value *= 0x100000001b3ull;
+			}
+			// Separates the texts, so moving characters from one to the next changes the hash
+			value ^= 0xff;
+			value *= 0x100000001b3ull;
+		}
+
+		std::string get_string(GLenum name)
+		{
+			auto* string{reinterpret_cast<const char*>(glGetString(name))};
+			return string ? string : "";
+		}
+	}
+
+	ProgramManager::ProgramManager(std::string cache_directory, std::chrono::milliseconds watch_interval)
+		: cache_directory{std::move(cache_directory)},
+		  watch_interval{watch_interval},
+		  watcher{&ProgramManager::watch, this}
+	{
+	}
+
+	ProgramManager::~ProgramManager()
+	{
+		{
+			std::lock_guard lock{mutex};
+			stopping = true;
+		}
+		condition.notify_all();
+		watcher.join();
+	}
+
+	ProgramManager& ProgramManager::get_global()
+	{
+		static ProgramManager manager{};
+		return manager;
+	}
+
+	ProgramManager::Handle ProgramManager::load(const std::vector<std::string>& vertex_paths, const std::vector<std::string>& fragment_paths)
+	{
+		for(size_t handle{0}; handle < programs.size(); ++handle)
+			if(programs[handle].vertex_paths == vertex_paths && programs[handle].fragment_paths == fragment_paths)
+				return handle;
+
+		// Times are taken before reading, so a change while loading still triggers a reload
+		Handle handle{programs.size()};
+		std::vector<WatchedFile> files{};
+		for(const auto* paths : {&vertex_paths, &fragment_paths})
+		{
+			for(const auto& path : *paths)
+			{
+				std::error_code error{};
+				files.push_back({path, std::filesystem::last_write_time(path, error), handle});
+			}
+		}
+
+		std::vector<std::string> vertex_sources{};
+		for(const auto& path : vertex_paths)
+			vertex_sources.push_back(glutil::read_file(path));
+		std::vector<std::string> fragment_sources{};
+		for(const auto& path : fragment_paths)
+			fragment_sources.push_back(glutil::read_file(path));
+
+		Program program{vertex_paths, fragment_paths, 0, 0, {0, {}, {}}, false};
+		auto key{make_key(vertex_sources, fragment_sources)};
+		program.program = load_binary(key);
+		if(program.program)
+			++cache_hits;
+		else
+		{
+			++cache_misses;
+			auto build{start_build(vertex_sources, fragment_sources, key)};
+			program.program = finish_build(build, describe(program));
+			store_binary(program.program, key);
+		}
+		programs.push_back(std::move(program));
+
+		std::lock_guard lock{mutex};
+		watched_files.insert(watched_files.end(), files.begin(), files.end());
+		return handle;
+	}
+
+	GLuint ProgramManager::get_program(Handle handle) const
+	{
+		return programs.at(handle).program;
+	}
+
+	size_t ProgramManager::get_version(Handle handle) const
+	{
+		return programs.at(handle).version;
+	}
+
+	void ProgramManager::update()
+	{
+		std::set<Handle> handles{};
+		{
+			std::lock_guard lock{mutex};
+			handles.swap(changed);
+		}
+
+		for(auto handle : handles)
+		{
+			auto& program{programs[handle]};
+			if(program.reloading)
+				discard_build(program.pending);
+			program.reloading = false;
+
+			try
+			{
+				std::vector<std::string> vertex_sources{};
+				for(const auto& path : program.vertex_paths)
+					vertex_sources.push_back(glutil::read_file(path));
+				std::vector<std::string> fragment_sources{};
+				for(const auto& path : program.fragment_paths)
+					fragment_sources.push_back(glutil::read_file(path));
+
+				auto key{make_key(vertex_sources, fragment_sources)};
+				program.pending = Build{load_binary(key), {}, key};
+				if(!program.pending.program)
+					program.pending = start_build(vertex_sources, fragment_sources, key);
+				program.reloading = true;
+			}
+			catch(const std::runtime_error&)
+			{
+				// Editors may save in several steps, the next change retries
+			}
+		}
+
+		for(auto& program : programs)
+		{
+			if(!program.reloading || !is_finished(program.pending))
+				continue;
+
+			program.reloading = false;
+			try
+			{
+				auto cached{program.pending.shaders.empty()};
+				auto id{cached ? program.pending.program : finish_build(program.pending, describe(program))};
+				if(!cached)
+					store_binary(id, program.pending.key);
+
+				glDeleteProgram(program.program);
+				program.program = id;
+				++program.version;
+				std::cout << "ProgramManager: Reloaded " << describe(program) << '\n';
+			}
+			catch(const std::runtime_error&)
+			{
+				std::cerr << "ProgramManager: Keeping the previous version of " << describe(program) << '\n';
+			}
+		}
+	}
+
+	void ProgramManager::clear()
+	{
+		for(auto& program : programs)
+		{
+			if(program.reloading)
+				discard_build(program.pending);
+			glDeleteProgram(program.program);
+		}
+		programs.clear();
+
+		std::lock_guard lock{mutex};
+		watched_files.clear();
+		changed.clear();
+	}
+
+	size_t ProgramManager::get_cache_hits() const
+	{
+		return cache_hits;
+	}
+
+	size_t ProgramManager::get_cache_misses() const
+	{
+		return cache_misses;
+	}
+
+	std::string ProgramManager::describe(const Program& program) const
+	{
+		std::string description{"["};
+		for(const auto* paths : {&program.vertex_paths, &program.fragment_paths})
+			for(const auto& path : *paths)
+				description += (description.size() > 1 ? " " : "") + path;
+		return description + "]";
+	}
+
+	std::string ProgramManager::make_key(const std::vector<std::string>& vertex_sources, const std::vector<std::string>& fragment_sources)
+	{
+		// Binaries are only valid for the driver that produced them
+		if(driver.empty())
+		{
+			driver = get_string(GL_VENDOR) + '\n' + get_string(GL_RENDERER) + '\n' + get_string(GL_VERSION);
+			GLint formats{0};
+			if(GLEW_ARB_get_program_binary)
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			binary_supported = formats > 0 && !cache_directory.empty();
+		}
+
+		std::uint64_t value{0xcbf29ce484222325ull};
+		hash(value, driver);
+		for(const auto* sources : {&vertex_sources, &fragment_sources})
+		{
+			for(const auto& source : *sources)
+				hash(value, source);
+			hash(value, "");
+		}
+
+		std::ostringstream key{};
+		key << std::hex << value;
+		return key.str();
+	}
+
+	ProgramManager::Build ProgramManager::start_build(const std::vector<std::string>& vertex_sources, const std::vector<std::string>& fragment_sources,
+		std::string key)
+	{
+		Build build{glCreateProgram(), {}, std::move(key)};
+		for(auto [type, sources] : {std::pair{GL_VERTEX_SHADER, &vertex_sources}, std::pair{GL_FRAGMENT_SHADER, &fragment_sources}})
+		{
+			std::vector<const char*> source_ptrs{};
+			for(const auto& source : *sources)
+				source_ptrs.push_back(source.c_str());
+
+			auto shader{glCreateShader(type)};
+			glShaderSource(shader, static_cast<GLsizei>(source_ptrs.size()), source_ptrs.data(), nullptr);
+			glCompileShader(shader);
+			glAttachShader(build.program, shader);
+			build.shaders.push_back(shader);
+		}
+
+		// Status is only queried in finish_build, so drivers that compile in parallel are not forced to wait here
+		if(binary_supported)
+			glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(build.program);
+		return build;
+	}
+
+	bool ProgramManager::is_finished(const Build& build) const
+	{
+		if(build.shaders.empty() || !GLEW_ARB_parallel_shader_compile)
+			return true;
+
+		GLint finished{GL_FALSE};
+		glGetProgramiv(build.program, GL_COMPLETION_STATUS_ARB, &finished);
+		return finished == GL_TRUE;
+	}
+
+	GLuint ProgramManager::finish_build(Build& build, const std::string& description)
+	{
+		GLint success{GL_FALSE};
+		glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+		if(success != GL_TRUE)
+		{
+			std::string log{};
+			std::vector<char> text{};
+			for(auto shader : build.shaders)
+			{
+				GLint compiled{GL_FALSE};
+				glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+				GLint logsize{0};
+				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logsize);
+				if(compiled == GL_TRUE || logsize <= 0)
+					continue;
+				text.resize(static_cast<size_t>(logsize));
+				glGetShaderInfoLog(shader, logsize, nullptr, text.data());
+				log += text.data();
+			}
+
+			GLint logsize{0};
+			glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &logsize);
+			if(logsize > 0)
+			{
+				text.resize(static_cast<size_t>(logsize));
+				glGetProgramInfoLog(build.program, logsize, nullptr, text.data());
+				log += text.data();
+			}
+
+			discard_build(build);
+			std::cerr << "ProgramManager: Building " << description << " failed with error: " << log << '\n';
+			throw std::runtime_error{"Failed to build shader program."};
+		}
+
+		for(auto shader : build.shaders)
+		{
+			glDetachShader(build.program, shader);
+			glDeleteShader(shader);
+		}
+		build.shaders.clear();
+		return build.program;
+	}
+
+	void ProgramManager::discard_build(Build& build)
+	{
+		for(auto shader : build.shaders)
+			glDeleteShader(shader);
+		glDeleteProgram(build.program);
+		build = Build{0, {}, {}};
+	}
+
+	GLuint ProgramManager::load_binary(const std::string& key)
+	{
+		if(!binary_supported)
+			return 0;
+
+		std::ifstream ifs{std::filesystem::path{cache_directory} / (key + ".bin"), std::ios::binary | std::ios::ate};
+		if(!ifs || ifs.tellg() <= static_cast<std::streamoff>(sizeof(GLenum)))
+			return 0;
+
+		std::vector<char> binary(static_cast<size_t>(ifs.tellg()) - sizeof(GLenum));
+		GLenum format{0};
+		ifs.seekg(0);
+		ifs.read(reinterpret_cast<char*>(&format), sizeof(format));
+		ifs.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+		if(!ifs)
+			return 0;
+
+		// Drivers reject binaries of other versions, the program is then built from source
+		auto program{glCreateProgram()};
+		glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+		GLint success{GL_FALSE};
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if(success != GL_TRUE)
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void ProgramManager::store_binary(GLuint program, const std::string& key)
+	{
+		if(!binary_supported)
+			return;
+
+		GLint length{0};
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(length <= 0)
+			return;
+
+		std::vector<char> binary(static_cast<size_t>(length));
+		GLenum format{0};
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		std::error_code error{};
+		std::filesystem::create_directories(cache_directory, error);
+		std::ofstream ofs{std::filesystem::path{cache_directory} / (key + ".bin"), std::ios::binary};
+		ofs.write(reinterpret_cast<const char*>(&format), sizeof(format));
+		ofs.write(binary.data(), length);
+		if(!ofs)
+			std::cerr << "ProgramManager: Could not write the program binary to " << cache_directory << '\n';
+	}
+
+	void ProgramManager::watch()
+	{
+		std::unique_lock lock{mutex};
+		while(!condition.wait_for(lock, watch_interval, [this] { return stopping; }))
+		{
+			for(auto& file : watched_files)
+			{
+				std::error_code error{};
+				auto time{std::filesystem::last_write_time(file.path, error)};
+				if(!error && time != file.time)
+				{
+					file.time = time;
+					changed.insert(file.handle);
+				}
+			}
+		}
+	}
+}
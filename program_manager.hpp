@@ -0,0 +1,109 @@
+#ifndef PROGRAM_MANAGER_HPP
+#define PROGRAM_MANAGER_HPP
+
+#include "GL/glew.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cg
+{
+	/// Links shader programs from files and caches their binaries, keyed by a hash of the sources and the driver,
+	/// so later launches skip compiling. A background thread watches the files, changed programs are relinked by update.
+	class ProgramManager
+	{
+		public:
+			using Handle = size_t;
+
+			/// An empty cache_directory disables the binary cache.
+			explicit ProgramManager(std::string cache_directory = "shader_cache",
+				std::chrono::milliseconds watch_interval = std::chrono::milliseconds{250});
+			/// Programs are not deleted here, call clear while the context is still current.
+			~ProgramManager();
+
+			ProgramManager(const ProgramManager&) = delete;
+			ProgramManager& operator=(const ProgramManager&) = delete;
+
+			/// Manager shared by all renderers, Application clears it before destroying the context.
+			static ProgramManager& get_global();
+
+			/// Links a program from vertex and fragment shader files or loads its cached binary. Loading the same files
+			/// again returns the same handle. Throws runtime_error if reading, compiling or linking fails.
+			Handle load(const std::vector<std::string>& vertex_paths, const std::vector<std::string>& fragment_paths);
+			/// Changes whenever a reload succeeds.
+			GLuint get_program(Handle handle) const;
+			/// Incremented by every successful reload, so users know when to query uniform locations again.
+			size_t get_version(Handle handle) const;
+
+			/// Starts relinking programs whose files changed and swaps in those that finished. Drivers with
+			/// GL_ARB_parallel_shader_compile link in the background, update then never waits for them.
+			/// A failed reload is reported and keeps the previous program.
+			void update();
+
+			/// Deletes all programs and forgets their handles.
+			void clear();
+
+			size_t get_cache_hits() const;
+			size_t get_cache_misses() const;
+
+		private:
+			struct Build
+			{
+				GLuint program;
+				std::vector<GLuint> shaders;
+				std::string key;
+			};
+
+			struct Program
+			{
+				std::vector<std::string> vertex_paths;
+				std::vector<std::string> fragment_paths;
+				GLuint program;
+				size_t version;
+				Build pending;
+				bool reloading;
+			};
+
+			struct WatchedFile
+			{
+				std::filesystem::path path;
+				std::filesystem::file_time_type time;
+				Handle handle;
+			};
+
+			std::string describe(const Program& program) const;
+			std::string make_key(const std::vector<std::string>& vertex_sources, const std::vector<std::string>& fragment_sources);
+			Build start_build(const std::vector<std::string>& vertex_sources, const std::vector<std::string>& fragment_sources, std::string key);
+			bool is_finished(const Build& build) const;
+			/// Throws runtime_error with the compile and link logs if the build failed.
+			GLuint finish_build(Build& build, const std::string& description);
+			void discard_build(Build& build);
+			GLuint load_binary(const std::string& key);
+			void store_binary(GLuint program, const std::string& key);
+			void watch();
+
+			std::string cache_directory;
+			std::chrono::milliseconds watch_interval;
+			std::string driver{};
+			bool binary_supported{false};
+			std::vector<Program> programs;
+			size_t cache_hits{0};
+			size_t cache_misses{0};
+
+			std::vector<WatchedFile> watched_files;
+			std::set<Handle> changed;
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool stopping{false};
+			std::thread watcher;
+	};
+}
+
+#endif // PROGRAM_MANAGER_HPP
@@ -0,0 +1,115 @@
+#include "software_rasterizer.hpp"
+#include "soup_mesh.hpp"
+#include "half_edge_mesh.hpp"
+#include "thread_pool.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	using namespace std::string_literals;
+	if(argc < 3 || argv[1] == "-h"s)
+	{
+		std::cout << "Usage:\n" << argv[0] << " <path> <image> [options] : Renders the model at path like assignment 1 on the CPU and writes it to the PPM file <image>.\n"
+			<< "    --size <width> <height>        : Image size, 640x480 by default.\n"
+			<< "    --shading <flat|smooth|normals> : Smooth lit shading by default.\n"
+			<< "    --rotate <degrees>             : Rotates the model around the y axis.\n"
+			<< "    --half-edge                    : Renders the mesh after converting it to a half edge mesh and back with toSoupMesh.\n"
+			<< "    --repeat <count>               : Renders count times and reports the triangle throughput.\n"
+			<< "    --golden <image> [--tolerance <value>] : Compares to a reference image, fails if a channel differs by more than value.\n"
+			<< argv[0] << " -h : Shows this message.\n";
+		return argc < 3 ? -1 : 0;
+	}
+	using namespace cg;
+
+	std::string model_path{argv[1]};
+	std::string image_path{argv[2]};
+	size_t width{640};
+	size_t height{480};
+	auto shading{SoftwareRasterizer::Shading::smooth};
+	float angle{0.f};
+	bool half_edge{false};
+	int repeat{1};
+	std::string golden_path{};
+	int tolerance{0};
+	for(int i{3}; i < argc; ++i)
+	{
+		std::string argument{argv[i]};
+		if(argument == "--size" && i + 2 < argc)
+		{
+			width = static_cast<size_t>(std::atoi(argv[++i]));
+			height = static_cast<size_t>(std::atoi(argv[++i]));
+		}
+		else if(argument == "--shading" && i + 1 < argc)
+		{
+			std::string name{argv[++i]};
+			if(name == "flat")
+				shading = SoftwareRasterizer::Shading::flat;
+			else if(name == "normals")
+				shading = SoftwareRasterizer::Shading::normals;
+			else if(name != "smooth")
+			{
+				std::cerr << "Unknown shading " << name << ".\n";
+				return -1;
+			}
+		}
+		else if(argument == "--rotate" && i + 1 < argc)
+			angle = glm::radians(static_cast<float>(std::atof(argv[++i])));
+		else if(argument == "--half-edge")
+			half_edge = true;
+		else if(argument == "--repeat" && i + 1 < argc)
+			repeat = std::max(std::atoi(argv[++i]), 1);
+		else if(argument == "--golden" && i + 1 < argc)
+			golden_path = argv[++i];
+		else if(argument == "--tolerance" && i + 1 < argc)
+			tolerance = std::atoi(argv[++i]);
+		else
+		{
+			std::cerr << "Unknown option " << argument << ".\n";
+			return -1;
+		}
+	}
+
+	SoupMesh mesh{model_path};
+	if(half_edge)
+	{
+		HalfEdgeMesh hemesh{mesh};
+		mesh = hemesh.toSoupMesh();
+	}
+
+	// Same view as assignment 1 at time zero, the model is drawn in normalized device coordinates
+	auto model{glm::rotate(glm::mat4{1.f}, angle, glm::vec3{0.f, 1.f, 0.f})};
+	auto indices{mesh.calculate_indices()};
+	SoftwareRasterizer rasterizer{width, height};
+
+	using Clock = std::chrono::steady_clock;
+	auto start{Clock::now()};
+	for(int i{0}; i < repeat; ++i)
+	{
+		rasterizer.clear();
+		rasterizer.draw(mesh.get_positions(), mesh.get_normals(), indices, glm::mat4{1.f}, model, shading);
+	}
+	auto seconds{std::chrono::duration<double>(Clock::now() - start).count()};
+
+	const auto& statistics{rasterizer.get_statistics()};
+	std::cout << "Rendered " << statistics.triangles << " triangles (" << statistics.rasterized << " after clipping, " << statistics.fragments
+		<< " fragments) at " << width << "x" << height << " on " << ThreadPool::get_global().get_thread_count() << " threads in "
+		<< seconds / repeat * 1000. << " ms per frame, " << statistics.triangles * repeat / seconds / 1e6 << " million triangles per second\n";
+
+	auto image{rasterizer.get_image()};
+	image.write(image_path);
+	if(!golden_path.empty())
+	{
+		auto different{SoftwareRasterizer::Image::compare(image, SoftwareRasterizer::Image::read(golden_path), tolerance)};
+		std::cout << different << " pixels differ from " << golden_path << " by more than " << tolerance << '\n';
+		return different ? 1 : 0;
+	}
+
+	return 0;
+}
@@ -1,11 +1,217 @@
 #include "regular_mesh.hpp"
 
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace cg
 {
+	namespace
+	{
+		using stencil::Plane;
+		constexpr auto coarse{Plane::coarse};
+		constexpr auto even_even{Plane::even_even};
+		constexpr auto even_odd{Plane::even_odd};
+		constexpr auto odd_even{Plane::odd_even};
+		constexpr auto odd_odd{Plane::odd_odd};
+
+		// Stencils are indexed relative to the coarse vertex (row, col), the planes hold the fine vertices
+		// (2 * row, 2 * col), (2 * row, 2 * col + 1), (2 * row + 1, 2 * col) and (2 * row + 1, 2 * col + 1).
+		// Boundary rules come before the inside rules of the same plane.
+
+		std::vector<stencil::Phase> loop_phases(size_t width, size_t height)
+		{
+			return {
+				// Odd vertices
+				{
+					// Right
+					{even_odd, 0, 1, 0, width - 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}}},
+					{even_odd, height - 1, height, 0, width - 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}}},
+					{even_odd, 1, height - 1, 0, width - 1, 8.f, {{coarse, 0, 0, 3.f}, {coarse, 0, 1, 3.f}, {coarse, -1, 0, 1.f}, {coarse, 1, 0, 1.f}}},
+					// Down
+					{odd_even, 0, height - 1, 0, 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}}},
+					{odd_even, 0, height - 1, width - 1, width, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}}},
+					{odd_even, 0, height - 1, 1, width - 1, 8.f, {{coarse, 0, 0, 3.f}, {coarse, 1, 0, 3.f}, {coarse, 0, -1, 1.f}, {coarse, 1, 1, 1.f}}},
+					// Diagonal
+					{odd_odd, 0, height - 1, 0, width - 1, 8.f, {{coarse, 0, 0, 3.f}, {coarse, 1, 1, 3.f}, {coarse, 0, 1, 1.f}, {coarse, 1, 0, 1.f}}}
+				},
+				// Even vertices
+				{
+					// Horizontal boundary vertex
+					{even_even, 0, 1, 1, width - 1, 8.f, {{coarse, 0, 0, 6.f}, {even_odd, 0, -1, 1.f}, {even_odd, 0, 0, 1.f}}},
+					{even_even, height - 1, height, 1, width - 1, 8.f, {{coarse, 0, 0, 6.f}, {even_odd, 0, -1, 1.f}, {even_odd, 0, 0, 1.f}}},
+					// Vertical boundary vertex
+					{even_even, 1, height - 1, 0, 1, 8.f, {{coarse, 0, 0, 6.f}, {odd_even, -1, 0, 1.f}, {odd_even, 0, 0, 1.f}}},
+					{even_even, 1, height - 1, width - 1, width, 8.f, {{coarse, 0, 0, 6.f}, {odd_even, -1, 0, 1.f}, {odd_even, 0, 0, 1.f}}},
+					// Corner vertex
+					{even_even, 0, 1, 0, 1, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, 0, 1, width - 1, width, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, height - 1, height, 0, 1, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, height - 1, height, width - 1, width, 1.f, {{coarse, 0, 0, 1.f}}},
+					// Regular inside vertex
+					{even_even, 1, height - 1, 1, width - 1, 8.f, {{coarse, 0, 0, 5.f},
+						{odd_even, -1, 0, 0.5f}, {odd_even, 0, 0, 0.5f}, {even_odd, 0, -1, 0.5f}, {even_odd, 0, 0, 0.5f},
+						{odd_odd, -1, -1, 0.5f}, {odd_odd, 0, 0, 0.5f}}}
+				}
+			};
+		}
+
+		std::vector<stencil::Phase> catmull_clark_phases(size_t width, size_t height)
+		{
+			// Neighbours outside of the mesh are mirrored at the boundary, which turns the first and last row and column into separate rules
+			struct Band
+			{
+				size_t begin;
+				size_t end;
+				int before;
+				int after;
+			};
+			const Band row_bands[]{{0, 1, 0, 0}, {1, height - 1, -1, 0}, {height - 1, height, -1, -1}};
+			const Band col_bands[]{{0, 1, 0, 0}, {1, width - 1, -1, 0}, {width - 1, width, -1, -1}};
+
+			stencil::Phase faces{
+				{odd_odd, 0, height - 1, 0, width - 1, 4.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}, {coarse, 1, 0, 1.f}, {coarse, 1, 1, 1.f}}}
+			};
+
+			stencil::Phase edges{};
+			for(const auto& rows : row_bands)
+			{
+				// Right edge
+				edges.push_back({even_odd, rows.begin, rows.end, 0, width - 1, 4.f,
+					{{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}, {odd_odd, rows.before, 0, 1.f}, {odd_odd, rows.after, 0, 1.f}}});
+			}
+			for(const auto& cols : col_bands)
+			{
+				// Down edge
+				edges.push_back({odd_even, 0, height - 1, cols.begin, cols.end, 4.f,
+					{{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}, {odd_odd, 0, cols.before, 1.f}, {odd_odd, 0, cols.after, 1.f}}});
+			}
+
+			stencil::Phase vertices{};
+			for(const auto& rows : row_bands)
+			{
+				for(const auto& cols : col_bands)
+				{
+					vertices.push_back({even_even, rows.begin, rows.end, cols.begin, cols.end, 16.f, {{coarse, 0, 0, 8.f},
+						{even_odd, 0, cols.before, 1.f}, {even_odd, 0, cols.after, 1.f},
+						{odd_even, rows.before, 0, 1.f}, {odd_even, rows.after, 0, 1.f},
+						{odd_odd, rows.before, cols.before, 1.f}, {odd_odd, rows.before, cols.after, 1.f},
+						{odd_odd, rows.after, cols.before, 1.f}, {odd_odd, rows.after, cols.after, 1.f}}});
+				}
+			}
+
+			return {faces, edges, vertices};
+		}
+
+		std::vector<stencil::Phase> catmull_clark_sharp_bounds_phases(size_t width, size_t height)
+		{
+			return {
+				// Faces
+				{
+					{odd_odd, 0, height - 1, 0, width - 1, 4.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}, {coarse, 1, 0, 1.f}, {coarse, 1, 1, 1.f}}}
+				},
+				// Edges
+				{
+					// Right edge
+					{even_odd, 0, 1, 0, width - 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}}},
+					{even_odd, height - 1, height, 0, width - 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}}},
+					{even_odd, 1, height - 1, 0, width - 1, 4.f, {{coarse, 0, 0, 1.f}, {coarse, 0, 1, 1.f}, {odd_odd, -1, 0, 1.f}, {odd_odd, 0, 0, 1.f}}},
+					// Down edge
+					{odd_even, 0, height - 1, 0, 1, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}}},
+					{odd_even, 0, height - 1, width - 1, width, 2.f, {{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}}},
+					{odd_even, 0, height - 1, 1, width - 1, 4.f, {{coarse, 0, 0, 1.f}, {coarse, 1, 0, 1.f}, {odd_odd, 0, -1, 1.f}, {odd_odd, 0, 0, 1.f}}}
+				},
+				// Old vertices
+				{
+					// Horizontal boundary vertex
+					{even_even, 0, 1, 1, width - 1, 8.f, {{coarse, 0, 0, 6.f}, {even_odd, 0, -1, 1.f}, {even_odd, 0, 0, 1.f}}},
+					{even_even, height - 1, height, 1, width - 1, 8.f, {{coarse, 0, 0, 6.f}, {even_odd, 0, -1, 1.f}, {even_odd, 0, 0, 1.f}}},
+					// Vertical boundary vertex
+					{even_even, 1, height - 1, 0, 1, 8.f, {{coarse, 0, 0, 6.f}, {odd_even, -1, 0, 1.f}, {odd_even, 0, 0, 1.f}}},
+					{even_even, 1, height - 1, width - 1, width, 8.f, {{coarse, 0, 0, 6.f}, {odd_even, -1, 0, 1.f}, {odd_even, 0, 0, 1.f}}},
+					// Corner vertex
+					{even_even, 0, 1, 0, 1, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, 0, 1, width - 1, width, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, height - 1, height, 0, 1, 1.f, {{coarse, 0, 0, 1.f}}},
+					{even_even, height - 1, height, width - 1, width, 1.f, {{coarse, 0, 0, 1.f}}},
+					// Regular inside vertex
+					{even_even, 1, height - 1, 1, width - 1, 16.f, {{coarse, 0, 0, 8.f},
+						{even_odd, 0, -1, 1.f}, {even_odd, 0, 0, 1.f}, {odd_even, -1, 0, 1.f}, {odd_even, 0, 0, 1.f},
+						{odd_odd, -1, -1, 1.f}, {odd_odd, -1, 0, 1.f}, {odd_odd, 0, -1, 1.f}, {odd_odd, 0, 0, 1.f}}}
+				}
+			};
+		}
+
+		std::vector<stencil::Phase> phases(RegularMesh::Scheme scheme, size_t width, size_t height)
+		{
+			switch(scheme)
+			{
+				case RegularMesh::Scheme::loop:
+					return loop_phases(width, height);
+				case RegularMesh::Scheme::catmull_clark:
+					return catmull_clark_phases(width, height);
+				case RegularMesh::Scheme::catmull_clark_sharp_bounds:
+					return catmull_clark_sharp_bounds_phases(width, height);
+			}
+			throw std::invalid_argument{"RegularMesh: Unknown subdivision scheme."};
+		}
+
+		/// Uniform cubic B-spline basis, row i holds the coefficients of t^i for the four control points.
+		constexpr float bspline_basis[4][4]{
+			{1.f / 6.f, 4.f / 6.f, 1.f / 6.f, 0.f},
+			{-3.f / 6.f, 0.f, 3.f / 6.f, 0.f},
+			{3.f / 6.f, -6.f / 6.f, 3.f / 6.f, 0.f},
+			{-1.f / 6.f, 3.f / 6.f, -3.f / 6.f, 1.f / 6.f}
+		};
+
+		/// Basis weights of the segment containing a parameter, cell indexes the first of four control points
+		/// in the grid extended by one phantom vertex on each side.
+		struct SplineWeights
+		{
+			size_t cell;
+			float value[4];
+			float derivative[4];
+		};
+
+		SplineWeights spline_weights(float parameter, size_t size)
+		{
+			auto clamped{std::clamp(parameter, 0.f, static_cast<float>(size - 1))};
+			auto cell{std::min(static_cast<size_t>(clamped), size - 2)};
+			auto t{clamped - static_cast<float>(cell)};
+			const float powers[4]{1.f, t, t * t, t * t * t};
+			const float derivative_powers[4]{0.f, 1.f, 2.f * t, 3.f * t * t};
+
+			SplineWeights weights{cell, {}, {}};
+			for(size_t k{0}; k < 4; ++k)
+			{
+				for(size_t i{0}; i < 4; ++i)
+				{
+					weights.value[k] += powers[i] * bspline_basis[i][k];
+					weights.derivative[k] += derivative_powers[i] * bspline_basis[i][k];
+				}
+			}
+			return weights;
+		}
+
+		/// Front facing for the triangle winding of calculate_indices, falls back to the interpolated normal on degenerate spots.
+		glm::vec3 limit_normal(const glm::vec3& du, const glm::vec3& dv, const glm::vec3& interpolated)
+		{
+			auto normal{glm::cross(dv, du)};
+			auto length{glm::length(normal)};
+			if(length > 1e-20f)
+				return normal / length;
+
+			length = glm::length(interpolated);
+			return length > 0.f ? interpolated / length : interpolated;
+		}
+	}
+
 	RegularMesh::RegularMesh(size_t width, size_t height, const std::vector<glm::vec3> positions, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texture_coordinates)
 		: width{width},
 		  height{height},
@@ -37,519 +243,624 @@ namespace cg
 
 	std::vector<unsigned int> RegularMesh::calculate_indices() const
 	{
-		std::vector<unsigned int> indices{};
+		return *get_triangle_indices();
+	}
 
-		for(size_t row{0}; row < height - 1; ++row)
-		{
-			for(size_t col{0}; col < width - 1; ++col)
-			{
-				indices.push_back(row * width + col);
-				indices.push_back((row + 1) * width + col);
-				indices.push_back((row + 1) * width + col + 1);
-				indices.push_back(row * width + col);
-				indices.push_back((row + 1) * width + col + 1);
-				indices.push_back(row * width + col + 1);
-			}
-		}
-		return indices;
+	std::shared_ptr<const std::vector<unsigned int>> RegularMesh::get_triangle_indices() const
+	{
+		return grid_indices::triangles(width, height);
+	}
+
+	std::shared_ptr<const std::vector<unsigned int>> RegularMesh::get_strip_indices() const
+	{
+		return grid_indices::strips(width, height);
+	}
+
+	std::shared_ptr<const grid_indices::Tiling> RegularMesh::get_tiled_indices(size_t tile_size) const
+	{
+		return grid_indices::tiles(width, height, tile_size);
 	}
 
 	void RegularMesh::loop_subdivision()
 	{
-		if(width == 1 || height == 1)
-		{
-			std::cout << "RegularMesh: Loop subdivision does not work on meshes smaller than 2x2\n";
-			throw std::runtime_error{"Regular mesh loop subdivision failed."};
-		}
-		auto new_width{width * 2 - 1};
-		std::vector<glm::vec3> new_positions(new_width * (height * 2 - 1));
-		std::vector<glm::vec3> new_normals(new_width * (height * 2 - 1));
-		std::vector<glm::vec2> new_texture_coordinates(new_width * (height * 2 - 1));
+		subdivide(Scheme::loop, 1);
+	}
 
-		for(size_t row{0}; row < height; ++row)
-		{
-			for(size_t col{0}; col < width; ++col)
-			{
-				// Odd vertices
-				// Right
-				if((row == 0 || row + 1 == height) && col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2 + 1] = (positions[row * width + col]
-							+ positions[row * width + col + 1]) / 2.f;
+	void RegularMesh::catmull_clark_subdivision()
+	{
+		subdivide(Scheme::catmull_clark, 1);
+	}
 
-					new_normals[row * 2 * new_width + col * 2 + 1] = (normals[row * width + col]
-							+ normals[row * width + col + 1]) / 2.f;
+	void RegularMesh::catmull_clark_subdivision_sharp_bounds()
+	{
+		subdivide(Scheme::catmull_clark_sharp_bounds, 1);
+	}
 
-					new_texture_coordinates[row * 2 * new_width + col * 2 + 1] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[row * width + col + 1]) / 2.f;
-				}
-				else if(col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2 + 1] = (positions[row * width + col] * 3.f
-							+ positions[row * width + col + 1] * 3.f
-							+ positions[(row - 1) * width + col]
-							+ positions[(row + 1) * width + col]) / 8.f;
-
-					new_normals[row * 2 * new_width + col * 2 + 1] = (normals[row * width + col] * 3.f
-							+ normals[row * width + col + 1] * 3.f
-							+ normals[(row - 1) * width + col]
-							+ normals[(row + 1) * width + col]) / 8.f;
-
-					new_texture_coordinates[row * 2 * new_width + col * 2 + 1] = (texture_coordinates[row * width + col] * 3.f
-							+ texture_coordinates[row * width + col + 1] * 3.f
-							+ texture_coordinates[(row - 1) * width + col]
-							+ texture_coordinates[(row + 1) * width + col]) / 8.f;
-				}
+	void RegularMesh::subdivide(Scheme scheme, int levels)
+	{
+		subdivide_unless(scheme, levels, nullptr);
+	}
+
+	bool RegularMesh::subdivide(Scheme scheme, int levels, const std::atomic<bool>& cancelled)
+	{
+		return subdivide_unless(scheme, levels, &cancelled);
+	}
 
-				// Down
-				if((col == 0 || col + 1 == width) && row + 1 < height)
+	bool RegularMesh::subdivide_unless(Scheme scheme, int levels, const std::atomic<bool>* cancelled)
+	{
+		switch(scheme)
+		{
+			case Scheme::loop:
+				if(width == 1 || height == 1)
 				{
-					new_positions[(row * 2 + 1) * new_width + col * 2] = (positions[row * width + col]
-							+ positions[(row + 1) * width + col]) / 2.f;
-					
-					new_normals[(row * 2 + 1) * new_width + col * 2] = (normals[row * width + col]
-							+ normals[(row + 1) * width + col]) / 2.f;
-					
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[(row + 1) * width + col]) / 2.f;
+					std::cout << "RegularMesh: Loop subdivision does not work on meshes smaller than 2x2\n";
+					throw std::runtime_error{"Regular mesh loop subdivision failed."};
 				}
-				else if(row + 1 < height)
+				break;
+			case Scheme::catmull_clark:
+				if(width <= 2 || height <= 2)
 				{
-					new_positions[(row * 2 + 1) * new_width + col * 2] = (positions[row * width + col] * 3.f
-							+ positions[(row + 1) * width + col] * 3.f
-							+ positions[row * width + col - 1]
-							+ positions[(row + 1) * width + col + 1]) / 8.f;
-					
-					new_normals[(row * 2 + 1) * new_width + col * 2] = (normals[row * width + col] * 3.f
-							+ normals[(row + 1) * width + col] * 3.f
-							+ normals[row * width + col - 1]
-							+ normals[(row + 1) * width + col + 1]) / 8.f;
-					
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2] = (texture_coordinates[row * width + col] * 3.f
-							+ texture_coordinates[(row + 1) * width + col] * 3.f
-							+ texture_coordinates[row * width + col - 1]
-							+ texture_coordinates[(row + 1) * width + col + 1]) / 8.f;
+					std::cout << "RegularMesh: Catmull-clark subdivision does not work on meshes smaller than 3x3\n";
+					throw std::runtime_error{"Regular mesh catmull-clark subdivision failed."};
 				}
-
-				// Diagonal
-				if(row + 1 < height && col + 1 < width)
+				break;
+			case Scheme::catmull_clark_sharp_bounds:
+				if(width == 1 || height == 1)
 				{
-					new_positions[(row * 2 + 1) * new_width + col * 2 + 1] = (positions[row * width + col] * 3.f
-							+ positions[(row + 1) * width + col + 1] * 3.f
-							+ positions[row * width + col + 1]
-							+ positions[(row + 1) * width + col]) / 8.f;
-
-					new_normals[(row * 2 + 1) * new_width + col * 2 + 1] = (normals[row * width + col] * 3.f
-							+ normals[(row + 1) * width + col + 1] * 3.f
-							+ normals[row * width + col + 1]
-							+ normals[(row + 1) * width + col]) / 8.f;
-
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1] = (texture_coordinates[row * width + col] * 3.f
-							+ texture_coordinates[(row + 1) * width + col + 1] * 3.f
-							+ texture_coordinates[row * width + col + 1]
-							+ texture_coordinates[(row + 1) * width + col]) / 8.f;
+					std::cout << "RegularMesh: Catmull-clark subdivision with sharp bounds does not work on meshes smaller than 2x2\n";
+					throw std::runtime_error{"Regular mesh catmull-clark subdivision with sharp bounds failed."};
 				}
+				break;
+		}
+		if(levels < 0)
+			throw std::invalid_argument{"RegularMesh: Negative number of subdivision levels requested."};
+		if(levels == 0)
+			return true;
+
+		// Size every buffer for the largest grid it holds, so no level allocates
+		std::vector<size_t> widths{width};
+		std::vector<size_t> heights{height};
+		for(int level{0}; level < levels; ++level)
+		{
+			widths.push_back(widths.back() * 2 - 1);
+			heights.push_back(heights.back() * 2 - 1);
+		}
+		auto largest{[&widths, &heights, levels] (int first, size_t width_offset, size_t height_offset) {
+			size_t cells{0};
+			for(auto level{first}; level < levels; level += 2)
+				cells = std::max(cells, (widths[level] - width_offset) * (heights[level] - height_offset));
+			return cells * channel_count;
+		}};
 
-				// Even vertices
-				// Horizontal boundary vertex
-				if((row == 0 || row + 1 == height) && col > 0 && col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 6.f
-							+ new_positions[row * 2 * new_width + col * 2 - 1]
-							+ new_positions[row * 2 * new_width + col * 2 + 1]) / 8.f;
+		// Coarse grids of even levels live in front, odd levels in back, the last level is unpacked from the planes directly
+		stencil::Grid front{largest(0, 0, 0), 1, 1};
+		stencil::Grid back{largest(1, 0, 0), 1, 1};
+		stencil::Grid even_even{std::max(largest(0, 0, 0), largest(1, 0, 0)), 1, 1};
+		stencil::Grid even_odd{std::max(largest(0, 1, 0), largest(1, 1, 0)), 1, 1};
+		stencil::Grid odd_even{std::max(largest(0, 0, 1), largest(1, 0, 1)), 1, 1};
+		stencil::Grid odd_odd{std::max(largest(0, 1, 1), largest(1, 1, 1)), 1, 1};
 
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 6.f
-							+ new_normals[row * 2 * new_width + col * 2 - 1]
-							+ new_normals[row * 2 * new_width + col * 2 + 1]) / 8.f;
+		auto& pool{ThreadPool::get_global()};
+		auto row_grain{std::max(size_t{1}, (size_t{1} << 12) / width)};
 
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 6.f
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 - 1]
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 + 1]) / 8.f;
-				}
-				// Vertical boundary vertex
-				else if((col == 0 || col + 1 == width) && row > 0 && row + 1 < height)
+		front.resize(height, width, channel_count);
+		pool.parallel_for(0, height, row_grain, [&] (size_t begin, size_t end) {
+			for(auto row{begin}; row < end; ++row)
+			{
+				float* channels[channel_count];
+				for(size_t channel{0}; channel < channel_count; ++channel)
+					channels[channel] = front.row(channel, row);
+
+				for(size_t col{0}; col < width; ++col)
 				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 6.f
-							+ new_positions[(row * 2 - 1) * new_width + col * 2]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2]) / 8.f;
+					auto i{row * width + col};
+					channels[0][col] = positions[i].x;
+					channels[1][col] = positions[i].y;
+					channels[2][col] = positions[i].z;
+					channels[3][col] = normals[i].x;
+					channels[4][col] = normals[i].y;
+					channels[5][col] = normals[i].z;
+					channels[6][col] = texture_coordinates[i].x;
+					channels[7][col] = texture_coordinates[i].y;
+				}
+			}
+		});
 
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 6.f
-							+ new_normals[(row * 2 - 1) * new_width + col * 2]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2]) / 8.f;
+		auto* coarse{&front};
+		auto* fine{&back};
+		for(int level{0}; level < levels; ++level)
+		{
+			auto level_width{widths[level]};
+			auto level_height{heights[level]};
+			even_even.resize(level_height, level_width, channel_count);
+			even_odd.resize(level_height, level_width - 1, channel_count);
+			odd_even.resize(level_height - 1, level_width, channel_count);
+			odd_odd.resize(level_height - 1, level_width - 1, channel_count);
+			stencil::Planes planes{coarse, &even_even, &even_odd, &odd_even, &odd_odd};
+
+			// Phases only read planes of earlier phases, so the rows of each phase are independent
+			for(const auto& phase : phases(scheme, level_width, level_height))
+			{
+				// The mesh itself is only written after the last phase
+				if(cancelled && cancelled->load(std::memory_order_relaxed))
+					return false;
+				stencil::apply(phase, planes, pool);
+			}
 
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 6.f
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2]) / 8.f;
-				}
-				// Corner vertex
-				else if(row == 0 || row + 1 == height || col == 0 || col + 1 == width)
+			if(level + 1 < levels)
+			{
+				stencil::interleave(planes, *fine, pool);
+				std::swap(coarse, fine);
+			}
+		}
+
+		// Interleave the parity planes of the last level into the mesh
+		auto new_width{widths.back()};
+		auto new_height{heights.back()};
+		// Release the input first, it is only needed for packing
+		positions.clear();
+		positions.shrink_to_fit();
+		normals.clear();
+		normals.shrink_to_fit();
+		texture_coordinates.clear();
+		texture_coordinates.shrink_to_fit();
+		positions.resize(new_width * new_height);
+		normals.resize(new_width * new_height);
+		texture_coordinates.resize(new_width * new_height);
+		pool.parallel_for(0, new_height, std::max(size_t{1}, (size_t{1} << 12) / new_width), [&] (size_t begin, size_t end) {
+			for(auto row{begin}; row < end; ++row)
+			{
+				const auto& even_cols{row % 2 ? odd_even : even_even};
+				const auto& odd_cols{row % 2 ? odd_odd : even_odd};
+				const float* channels[2][channel_count];
+				for(size_t channel{0}; channel < channel_count; ++channel)
 				{
-					new_positions[row * 2 * new_width + col * 2] = positions[row * width + col];
-					new_normals[row * 2 * new_width + col * 2] = normals[row * width + col];
-					new_texture_coordinates[row * 2 * new_width + col * 2] = texture_coordinates[row * width + col];
+					channels[0][channel] = even_cols.row(channel, row / 2);
+					channels[1][channel] = odd_cols.row(channel, row / 2);
 				}
-				// Regular inside vertex
-				else
+
+				for(size_t col{0}; col < new_width; ++col)
 				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 5.f
-							+ new_positions[(row * 2 - 1) * new_width + col * 2] * 0.5f
-							+ new_positions[(row * 2 + 1) * new_width + col * 2] * 0.5f
-							+ new_positions[row * 2 * new_width + col * 2 - 1] * 0.5f
-							+ new_positions[row * 2 * new_width + col * 2 + 1] * 0.5f
-							+ new_positions[(row * 2 - 1) * new_width + col * 2 - 1] * 0.5f
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 + 1] * 0.5f) / 8.f;
-
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 5.f
-							+ new_normals[(row * 2 - 1) * new_width + col * 2] * 0.5f
-							+ new_normals[(row * 2 + 1) * new_width + col * 2] * 0.5f
-							+ new_normals[row * 2 * new_width + col * 2 - 1] * 0.5f
-							+ new_normals[row * 2 * new_width + col * 2 + 1] * 0.5f
-							+ new_normals[(row * 2 - 1) * new_width + col * 2 - 1] * 0.5f
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 + 1] * 0.5f) / 8.f;
-
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 5.f
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2] * 0.5f
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2] * 0.5f
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 - 1] * 0.5f
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 + 1] * 0.5f
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2 - 1] * 0.5f
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1] * 0.5f) / 8.f;
+					const auto* values{channels[col % 2]};
+					auto source{col / 2};
+					auto i{row * new_width + col};
+					positions[i] = glm::vec3{values[0][source], values[1][source], values[2][source]};
+					normals[i] = glm::vec3{values[3][source], values[4][source], values[5][source]};
+					texture_coordinates[i] = glm::vec2{values[6][source], values[7][source]};
 				}
 			}
-		}
+		});
+		width = new_width;
+		height = new_height;
 
-		positions = new_positions;
-		normals = new_normals;
-		texture_coordinates = new_texture_coordinates;
-		width = width * 2 - 1;
-		height = height * 2 - 1;
+		subdivision_peak_bytes = front.get_allocated_bytes() + back.get_allocated_bytes()
+			+ even_even.get_allocated_bytes() + even_odd.get_allocated_bytes() + odd_even.get_allocated_bytes() + odd_odd.get_allocated_bytes()
+			+ positions.capacity() * sizeof(glm::vec3) + normals.capacity() * sizeof(glm::vec3) + texture_coordinates.capacity() * sizeof(glm::vec2);
+		std::cout << "RegularMesh: Subdivided " << levels << " levels to " << width << "x" << height << " with a peak of " << subdivision_peak_bytes << " bytes\n";
+		return true;
 	}
 
-	void RegularMesh::catmull_clark_subdivision()
+	size_t RegularMesh::get_subdivision_peak_bytes() const
+	{
+		return subdivision_peak_bytes;
+	}
+
+	RegularMesh::LimitPoint RegularMesh::evaluate_limit(float u, float v) const
 	{
-		if(width <= 2 || height <= 2)
+		if(width < 2 || height < 2)
 		{
-			std::cout << "RegularMesh: Catmull-clark subdivision does not work on meshes smaller than 3x3\n";
-			throw std::runtime_error{"Regular mesh catmull-clark subdivision failed."};
+			std::cerr << "RegularMesh: Limit surface evaluation does not work on meshes smaller than 2x2\n";
+			throw std::invalid_argument{"Regular mesh limit evaluation failed."};
 		}
-		auto new_width{width * 2 - 1};
-		auto new_height{height * 2 - 1};
-		std::vector<glm::vec3> new_positions(new_width * (height * 2 - 1));
-		std::vector<glm::vec3> new_normals(new_width * (height * 2 - 1));
-		std::vector<glm::vec2> new_texture_coordinates(new_width * (height * 2 - 1));
-
-
-		// TODO:change ugly unsigned arithmetic
-		auto get_index{[] (size_t row, size_t col, size_t width, size_t height) {
-			if(row == static_cast<size_t>(-1)) row = 1;
-			if(col == static_cast<size_t>(-1)) col = 1;
-			if(row == height) row = height - 2;
-			if(col == width) col = width - 2;
-			return row * width + col;
+
+		auto attribute{[this] (size_t row, size_t col, size_t channel) {
+			auto i{row * width + col};
+			return channel < 3 ? positions[i][static_cast<int>(channel)]
+				: channel < 6 ? normals[i][static_cast<int>(channel - 3)] : texture_coordinates[i][static_cast<int>(channel - 6)];
+		}};
+		auto column{[this, &attribute] (size_t row, long long col, size_t channel) {
+			if(col < 0)
+				return 2.f * attribute(row, 0, channel) - attribute(row, 1, channel);
+			if(col >= static_cast<long long>(width))
+				return 2.f * attribute(row, width - 1, channel) - attribute(row, width - 2, channel);
+			return attribute(row, static_cast<size_t>(col), channel);
+		}};
+		auto control{[this, &column] (long long row, long long col, size_t channel) {
+			if(row < 0)
+				return 2.f * column(0, col, channel) - column(1, col, channel);
+			if(row >= static_cast<long long>(height))
+				return 2.f * column(height - 1, col, channel) - column(height - 2, col, channel);
+			return column(static_cast<size_t>(row), col, channel);
 		}};
 
-		// Faces
-		for(size_t row{0}; row < height; ++row)
+		auto across{spline_weights(u, width)};
+		auto down{spline_weights(v, height)};
+		float value[channel_count]{};
+		glm::vec3 du{0.f};
+		glm::vec3 dv{0.f};
+		for(size_t channel{0}; channel < channel_count; ++channel)
 		{
-			for(size_t col{0}; col < width; ++col)
+			for(size_t j{0}; j < 4; ++j)
 			{
-				if(row + 1 < height && col + 1 < width)
+				float curve{0.f};
+				float slope{0.f};
+				for(size_t k{0}; k < 4; ++k)
 				{
-					new_positions[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)] = (positions[row * width + col]
-							+ positions[row * width + col + 1]
-							+ positions[(row + 1) * width + col]
-							+ positions[(row + 1) * width + col + 1]) / 4.f;
-
-					new_normals[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)] = (normals[row * width + col]
-							+ normals[row * width + col + 1]
-							+ normals[(row + 1) * width + col]
-							+ normals[(row + 1) * width + col + 1]) / 4.f;
-
-					new_texture_coordinates[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[row * width + col + 1]
-							+ texture_coordinates[(row + 1) * width + col]
-							+ texture_coordinates[(row + 1) * width + col + 1]) / 4.f;
+					auto point{control(static_cast<long long>(down.cell + j) - 1, static_cast<long long>(across.cell + k) - 1, channel)};
+					curve += across.value[k] * point;
+					slope += across.derivative[k] * point;
+				}
+				value[channel] += down.value[j] * curve;
+				if(channel < 3)
+				{
+					du[static_cast<int>(channel)] += down.value[j] * slope;
+					dv[static_cast<int>(channel)] += down.derivative[j] * curve;
 				}
 			}
 		}
 
-		// Edges
-		for(size_t row{0}; row < height; ++row)
-		{
-			for(size_t col{0}; col < width; ++col)
-			{
-				// Right edge
-				new_positions[get_index(row * 2, col * 2 + 1, new_width, new_height)] = (positions[get_index(row, col, width, height)]
-						+ positions[get_index(row, col + 1, width, height)]
-						+ new_positions[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
-
-				new_normals[get_index(row * 2, col * 2 + 1, new_width, new_height)] = (normals[get_index(row, col, width, height)]
-						+ normals[get_index(row, col + 1, width, height)]
-						+ new_normals[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
+		return {glm::vec3{value[0], value[1], value[2]}, limit_normal(du, dv, glm::vec3{value[3], value[4], value[5]}), glm::vec2{value[6], value[7]}};
+	}
 
-				new_texture_coordinates[get_index(row * 2, col * 2 + 1, new_width, new_height)] = (texture_coordinates[get_index(row, col, width, height)]
-						+ texture_coordinates[get_index(row, col + 1, width, height)]
-						+ new_texture_coordinates[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
+	std::vector<RegularMesh::LimitPoint> RegularMesh::evaluate_limit(const std::vector<glm::vec2>& parameters) const
+	{
+		std::vector<LimitPoint> points(parameters.size());
+		ThreadPool::get_global().parallel_for(0, parameters.size(), 1024, [&] (size_t begin, size_t end) {
+			for(auto i{begin}; i < end; ++i)
+				points[i] = evaluate_limit(parameters[i].x, parameters[i].y);
+		});
+		return points;
+	}
 
-				// Down edge
-				new_positions[get_index(row * 2 + 1, col * 2, new_width, new_height)] = (positions[get_index(row, col, width, height)]
-						+ positions[get_index(row + 1, col, width, height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
-
-				new_normals[get_index(row * 2 + 1, col * 2, new_width, new_height)] = (normals[get_index(row, col, width, height)]
-						+ normals[get_index(row + 1, col, width, height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
-
-				new_texture_coordinates[get_index(row * 2 + 1, col * 2, new_width, new_height)] = (texture_coordinates[get_index(row, col, width, height)]
-						+ texture_coordinates[get_index(row + 1, col, width, height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 4.f;
-			}
+	RegularMesh RegularMesh::evaluate_limit_surface(size_t new_width, size_t new_height) const
+	{
+		if(width < 2 || height < 2 || new_width < 2 || new_height < 2)
+		{
+			std::cerr << "RegularMesh: Limit surface evaluation needs a control grid and a target of at least 2x2\n";
+			throw std::invalid_argument{"Regular mesh limit surface evaluation failed."};
 		}
 
-		// Old vertices
-		for(size_t row{0}; row < height; ++row)
-		{
-			for(size_t col{0}; col < width; ++col)
+		auto control{limit_control_grid()};
+		std::vector<SplineWeights> across(new_width);
+		std::vector<SplineWeights> down(new_height);
+		for(size_t col{0}; col < new_width; ++col)
+			across[col] = spline_weights(static_cast<float>(col) * static_cast<float>(width - 1) / static_cast<float>(new_width - 1), width);
+		for(size_t row{0}; row < new_height; ++row)
+			down[row] = spline_weights(static_cast<float>(row) * static_cast<float>(height - 1) / static_cast<float>(new_height - 1), height);
+
+		// Evaluate the curves along u of every control row once, the rows of the surface then only combine four of them
+		auto& pool{ThreadPool::get_global()};
+		stencil::Grid curves{height + 2, new_width, channel_count};
+		stencil::Grid slopes{height + 2, new_width, 3};
+		pool.parallel_for(0, height + 2, 1, [&] (size_t begin, size_t end) {
+			for(auto row{begin}; row < end; ++row)
 			{
-				// Horizontal boundary vertex
-				new_positions[get_index(row * 2, col * 2, new_width, new_height)] = (positions[get_index(row, col, width, height)] * 8.f
-						+ new_positions[get_index(row * 2, col * 2 - 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2, col * 2 + 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 - 1, col * 2, new_width, new_height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2, new_width, new_height)]
-						+ new_positions[get_index(row * 2 - 1, col * 2 - 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_positions[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 16.f;
-
-				new_normals[get_index(row * 2, col * 2, new_width, new_height)] = (normals[get_index(row, col, width, height)] * 8.f
-						+ new_normals[get_index(row * 2, col * 2 - 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2, col * 2 + 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 - 1, col * 2, new_width, new_height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2, new_width, new_height)]
-						+ new_normals[get_index(row * 2 - 1, col * 2 - 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_normals[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 16.f;
-
-				new_texture_coordinates[get_index(row * 2, col * 2, new_width, new_height)] = (texture_coordinates[get_index(row, col, width, height)] * 8.f
-						+ new_texture_coordinates[get_index(row * 2, col * 2 - 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2, col * 2 + 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 - 1, col * 2, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 - 1, col * 2 - 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 - 1, col * 2 + 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2 - 1, new_width, new_height)]
-						+ new_texture_coordinates[get_index(row * 2 + 1, col * 2 + 1, new_width, new_height)]) / 16.f;
+				for(size_t channel{0}; channel < channel_count; ++channel)
+				{
+					const auto* source{control.row(channel, row)};
+					auto* curve{curves.row(channel, row)};
+					auto* slope{channel < 3 ? slopes.row(channel, row) : nullptr};
+					for(size_t col{0}; col < new_width; ++col)
+					{
+						const auto& weights{across[col]};
+						const auto* points{source + weights.cell};
+						curve[col] = weights.value[0] * points[0] + weights.value[1] * points[1] + weights.value[2] * points[2] + weights.value[3] * points[3];
+						if(slope)
+							slope[col] = weights.derivative[0] * points[0] + weights.derivative[1] * points[1] + weights.derivative[2] * points[2] + weights.derivative[3] * points[3];
+					}
+				}
 			}
-		}
+		});
+
+		std::vector<glm::vec3> new_positions(new_width * new_height);
+		std::vector<glm::vec3> new_normals(new_width * new_height);
+		std::vector<glm::vec2> new_texture_coordinates(new_width * new_height);
+		pool.parallel_for(0, new_height, std::max(size_t{1}, (size_t{1} << 12) / new_width), [&] (size_t begin, size_t end) {
+			// Values of all channels followed by the u and v derivatives of the position
+			std::vector<float> buffer((channel_count + 6) * new_width);
+			auto channel_row{[&buffer, new_width] (size_t channel) { return buffer.data() + channel * new_width; }};
+			for(auto row{begin}; row < end; ++row)
+			{
+				const auto& weights{down[row]};
+				const float* sources[4];
+				for(size_t channel{0}; channel < channel_count; ++channel)
+				{
+					for(size_t k{0}; k < 4; ++k)
+						sources[k] = curves.row(channel, weights.cell + k);
+					stencil::weighted_sum(channel_row(channel), sources, weights.value, 4, new_width);
+					if(channel < 3)
+					{
+						stencil::weighted_sum(channel_row(channel_count + 3 + channel), sources, weights.derivative, 4, new_width);
+						for(size_t k{0}; k < 4; ++k)
+							sources[k] = slopes.row(channel, weights.cell + k);
+						stencil::weighted_sum(channel_row(channel_count + channel), sources, weights.value, 4, new_width);
+					}
+				}
 
-		positions = new_positions;
-		normals = new_normals;
-		texture_coordinates = new_texture_coordinates;
-		width = new_width;
-		height = new_height;
+				for(size_t col{0}; col < new_width; ++col)
+				{
+					auto value{[&channel_row, col] (size_t channel) { return channel_row(channel)[col]; }};
+					auto i{row * new_width + col};
+					new_positions[i] = glm::vec3{value(0), value(1), value(2)};
+					new_normals[i] = limit_normal(glm::vec3{value(8), value(9), value(10)}, glm::vec3{value(11), value(12), value(13)}, glm::vec3{value(3), value(4), value(5)});
+					new_texture_coordinates[i] = glm::vec2{value(6), value(7)};
+				}
+			}
+		});
+
+		std::cout << "RegularMesh: Evaluated " << new_width << "x" << new_height << " limit surface of " << width << "x" << height << " grid\n";
+
+		return RegularMesh{new_width, new_height, new_positions, new_normals, new_texture_coordinates};
 	}
 
-	void RegularMesh::catmull_clark_subdivision_sharp_bounds()
+	RegularMesh RegularMesh::evaluate_limit_surface(int levels) const
 	{
-		if(width == 1 || height == 1)
+		if(levels < 0)
+			throw std::invalid_argument{"RegularMesh: Negative number of limit surface levels requested."};
+
+		auto scale{size_t{1} << levels};
+		return evaluate_limit_surface((width - 1) * scale + 1, (height - 1) * scale + 1);
+	}
+
+	RegularMesh::AdaptiveMesh RegularMesh::refine_adaptive(int max_levels, float tolerance) const
+	{
+		if(width < 2 || height < 2)
 		{
-			std::cout << "RegularMesh: Catmull-clark subdivision with sharp bounds does not work on meshes smaller than 2x2\n";
-			throw std::runtime_error{"Regular mesh catmull-clark subdivision with sharp bounds failed."};
+			std::cerr << "RegularMesh: Adaptive refinement does not work on meshes smaller than 2x2\n";
+			throw std::invalid_argument{"Regular mesh adaptive refinement failed."};
+		}
+		if(max_levels < 0 || max_levels > 16)
+			throw std::invalid_argument{"RegularMesh: Adaptive refinement supports 0 to 16 levels."};
+		// Node keys pack each fine grid coordinate into 27 bits
+		constexpr std::uint64_t coordinate_limit{std::uint64_t{1} << 27};
+		if((static_cast<std::uint64_t>(std::max(width, height) - 1) << max_levels) >= coordinate_limit)
+		{
+			std::cerr << "RegularMesh: Adaptive refinement of " << width << "x" << height << " vertices by " << max_levels
+				<< " levels exceeds the fine grid of " << coordinate_limit << " vertices per side\n";
+			throw std::invalid_argument{"Regular mesh adaptive refinement failed."};
 		}
-		auto new_width{width * 2 - 1};
-		std::vector<glm::vec3> new_positions(new_width * (height * 2 - 1));
-		std::vector<glm::vec3> new_normals(new_width * (height * 2 - 1));
-		std::vector<glm::vec2> new_texture_coordinates(new_width * (height * 2 - 1));
 
-		// Faces
-		for(size_t row{0}; row < height; ++row)
+		// Quadtree nodes live on the grid of max_levels uniform subdivision steps, size is the log2 of their side length
+		struct Node
 		{
-			for(size_t col{0}; col < width; ++col)
+			std::uint32_t x;
+			std::uint32_t y;
+			int size;
+		};
+		auto scale{std::uint32_t{1} << max_levels};
+		auto fine_width{static_cast<std::uint32_t>(width - 1) * scale};
+		auto fine_height{static_cast<std::uint32_t>(height - 1) * scale};
+		auto node_key{[] (std::uint32_t x, std::uint32_t y, int size) { return (std::uint64_t{x} << 37) | (std::uint64_t{y} << 10) | static_cast<std::uint64_t>(size); }};
+		auto vertex_key{[] (std::uint32_t x, std::uint32_t y) { return (std::uint64_t{x} << 32) | y; }};
+		auto position{[this, scale] (std::uint32_t x, std::uint32_t y) {
+			return evaluate_limit(static_cast<float>(x) / static_cast<float>(scale), static_cast<float>(y) / static_cast<float>(scale)).position;
+		}};
+
+		// Largest distance of the edge midpoints and the center from the bilinear patch
+		auto error{[&position] (const Node& node) {
+			auto side{std::uint32_t{1} << node.size};
+			auto half{side / 2};
+			glm::vec3 corners[4]{position(node.x, node.y), position(node.x + side, node.y), position(node.x, node.y + side), position(node.x + side, node.y + side)};
+			const std::uint32_t offsets[5][2]{{half, 0}, {0, half}, {half, half}, {side, half}, {half, side}};
+			float largest{0.f};
+			for(const auto& offset : offsets)
+			{
+				auto s{static_cast<float>(offset[0]) / static_cast<float>(side)};
+				auto t{static_cast<float>(offset[1]) / static_cast<float>(side)};
+				auto bilinear{(corners[0] * (1.f - s) + corners[1] * s) * (1.f - t) + (corners[2] * (1.f - s) + corners[3] * s) * t};
+				largest = std::max(largest, glm::length(position(node.x + offset[0], node.y + offset[1]) - bilinear));
+			}
+			return largest;
+		}};
+
+		// Refine the cells independently
+		std::vector<std::vector<Node>> cell_leaves((width - 1) * (height - 1));
+		ThreadPool::get_global().parallel_for(0, cell_leaves.size(), 1, [&] (size_t begin, size_t end) {
+			for(auto cell{begin}; cell < end; ++cell)
 			{
-				if(row + 1 < height && col + 1 < width)
+				std::vector<Node> stack{{static_cast<std::uint32_t>(cell % (width - 1)) * scale, static_cast<std::uint32_t>(cell / (width - 1)) * scale, max_levels}};
+				while(!stack.empty())
 				{
-					new_positions[(row * 2 + 1) * new_width + col * 2 + 1] = (positions[row * width + col]
-							+ positions[row * width + col + 1]
-							+ positions[(row + 1) * width + col]
-							+ positions[(row + 1) * width + col + 1]) / 4.f;
-
-					new_normals[(row * 2 + 1) * new_width + col * 2 + 1] = (normals[row * width + col]
-							+ normals[row * width + col + 1]
-							+ normals[(row + 1) * width + col]
-							+ normals[(row + 1) * width + col + 1]) / 4.f;
-
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[row * width + col + 1]
-							+ texture_coordinates[(row + 1) * width + col]
-							+ texture_coordinates[(row + 1) * width + col + 1]) / 4.f;
+					auto node{stack.back()};
+					stack.pop_back();
+					if(node.size > 0 && error(node) > tolerance)
+					{
+						auto half{std::uint32_t{1} << (node.size - 1)};
+						stack.push_back({node.x, node.y, node.size - 1});
+						stack.push_back({node.x + half, node.y, node.size - 1});
+						stack.push_back({node.x, node.y + half, node.size - 1});
+						stack.push_back({node.x + half, node.y + half, node.size - 1});
+					}
+					else
+					{
+						cell_leaves[cell].push_back(node);
+					}
 				}
 			}
-		}
+		});
 
-		// Edges
-		for(size_t row{0}; row < height; ++row)
+		// Split leaves until neighbours differ by at most one level
+		std::unordered_set<std::uint64_t> leaf_keys{};
+		std::vector<Node> work{};
+		for(const auto& leaves : cell_leaves)
 		{
-			for(size_t col{0}; col < width; ++col)
+			for(const auto& leaf : leaves)
 			{
-				// Right edge
-				// Horizontal boundary
-				if((row == 0 || row + 1 == height) && col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2 + 1] = (positions[row * width + col]
-							+ positions[row * width + col + 1]) / 2.f;
-
-					new_normals[row * 2 * new_width + col * 2 + 1] = (normals[row * width + col]
-							+ normals[row * width + col + 1]) / 2.f;
+				leaf_keys.insert(node_key(leaf.x, leaf.y, leaf.size));
+				work.push_back(leaf);
+			}
+		}
+		cell_leaves.clear();
 
-					new_texture_coordinates[row * 2 * new_width + col * 2 + 1] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[row * width + col + 1]) / 2.f;
-				}
-				// Inside
-				else if(col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2 + 1] = (positions[row * width + col]
-							+ positions[row * width + col + 1]
-							+ new_positions[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
-
-					new_normals[row * 2 * new_width + col * 2 + 1] = (normals[row * width + col]
-							+ normals[row * width + col + 1]
-							+ new_normals[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
-
-					new_texture_coordinates[row * 2 * new_width + col * 2 + 1] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[row * width + col + 1]
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
-				}
+		auto containing{[&] (std::uint32_t x, std::uint32_t y) {
+			for(int size{0}; size <= max_levels; ++size)
+			{
+				auto mask{~((std::uint32_t{1} << size) - 1)};
+				if(leaf_keys.count(node_key(x & mask, y & mask, size)))
+					return Node{x & mask, y & mask, size};
+			}
+			throw std::runtime_error{"RegularMesh: Adaptive refinement lost a quadtree leaf."};
+		}};
 
-				// Down edge
-				// Vertical boundary
-				if((col == 0 || col + 1 == width) && row + 1 < height)
-				{
-					new_positions[(row * 2 + 1) * new_width + col * 2] = (positions[row * width + col]
-							+ positions[(row + 1) * width + col]) / 2.f;
+		while(!work.empty())
+		{
+			auto node{work.back()};
+			work.pop_back();
+			if(!leaf_keys.count(node_key(node.x, node.y, node.size)))
+				continue;
+
+			auto side{std::uint32_t{1} << node.size};
+			const std::int64_t probes[4][2]{{std::int64_t{node.x} - 1, node.y}, {std::int64_t{node.x} + side, node.y},
+				{node.x, std::int64_t{node.y} - 1}, {node.x, std::int64_t{node.y} + side}};
+			for(const auto& probe : probes)
+			{
+				if(probe[0] < 0 || probe[1] < 0 || probe[0] >= fine_width || probe[1] >= fine_height)
+					continue;
 
-					new_normals[(row * 2 + 1) * new_width + col * 2] = (normals[row * width + col]
-							+ normals[(row + 1) * width + col]) / 2.f;
+				auto neighbour{containing(static_cast<std::uint32_t>(probe[0]), static_cast<std::uint32_t>(probe[1]))};
+				if(neighbour.size <= node.size + 1)
+					continue;
 
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[(row + 1) * width + col]) / 2.f;
-				}
-				// Inside
-				else if(row + 1 < height)
+				leaf_keys.erase(node_key(neighbour.x, neighbour.y, neighbour.size));
+				auto half{std::uint32_t{1} << (neighbour.size - 1)};
+				for(auto [dx, dy] : {std::pair<std::uint32_t, std::uint32_t>{0, 0}, {half, 0}, {0, half}, {half, half}})
 				{
-					new_positions[(row * 2 + 1) * new_width + col * 2] = (positions[row * width + col]
-							+ positions[(row + 1) * width + col]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
-
-					new_normals[(row * 2 + 1) * new_width + col * 2] = (normals[row * width + col]
-							+ normals[(row + 1) * width + col]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
-
-					new_texture_coordinates[(row * 2 + 1) * new_width + col * 2] = (texture_coordinates[row * width + col]
-							+ texture_coordinates[(row + 1) * width + col]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1]) / 4.f;
+					Node child{neighbour.x + dx, neighbour.y + dy, neighbour.size - 1};
+					leaf_keys.insert(node_key(child.x, child.y, child.size));
+					work.push_back(child);
 				}
+				// The split child may still be too coarse
+				work.push_back(node);
 			}
 		}
 
-		// Old vertices
-		for(size_t row{0}; row < height; ++row)
+		std::vector<Node> leaves{};
+		leaves.reserve(leaf_keys.size());
+		for(auto key : leaf_keys)
+			leaves.push_back({static_cast<std::uint32_t>(key >> 37), static_cast<std::uint32_t>((key >> 10) & 0x7ffffff), static_cast<int>(key & 0x3ff)});
+		std::sort(leaves.begin(), leaves.end(), [] (const Node& a, const Node& b) { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+
+		// Leaf corners are the shared vertices, a corner on the side of a leaf means the neighbour there is finer
+		std::unordered_map<std::uint64_t, unsigned int> vertex_indices{};
+		std::vector<glm::vec2> parameters{};
+		auto vertex{[&] (std::uint32_t x, std::uint32_t y) {
+			auto [it, inserted]{vertex_indices.emplace(vertex_key(x, y), static_cast<unsigned int>(parameters.size()))};
+			if(inserted)
+				parameters.push_back(glm::vec2{static_cast<float>(x) / static_cast<float>(scale), static_cast<float>(y) / static_cast<float>(scale)});
+			return it->second;
+		}};
+		for(const auto& leaf : leaves)
 		{
-			for(size_t col{0}; col < width; ++col)
+			auto side{std::uint32_t{1} << leaf.size};
+			vertex(leaf.x, leaf.y);
+			vertex(leaf.x + side, leaf.y);
+			vertex(leaf.x, leaf.y + side);
+			vertex(leaf.x + side, leaf.y + side);
+		}
+
+		AdaptiveMesh mesh{};
+		for(const auto& leaf : leaves)
+		{
+			auto side{std::uint32_t{1} << leaf.size};
+			auto half{side / 2};
+
+			// Boundary loop in the winding of calculate_indices
+			std::vector<unsigned int> loop{vertex(leaf.x, leaf.y)};
+			auto add_midpoint{[&] (std::uint32_t x, std::uint32_t y) {
+				if(half && vertex_indices.count(vertex_key(x, y)))
+					loop.push_back(vertex_indices[vertex_key(x, y)]);
+			}};
+			add_midpoint(leaf.x, leaf.y + half);
+			loop.push_back(vertex(leaf.x, leaf.y + side));
+			add_midpoint(leaf.x + half, leaf.y + side);
+			loop.push_back(vertex(leaf.x + side, leaf.y + side));
+			add_midpoint(leaf.x + side, leaf.y + half);
+			loop.push_back(vertex(leaf.x + side, leaf.y));
+			add_midpoint(leaf.x + half, leaf.y);
+
+			if(loop.size() == 4)
 			{
-				// Horizontal boundary vertex
-				if((row == 0 || row + 1 == height) && col > 0 && col + 1 < width)
-				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 6.f
-							+ new_positions[row * 2 * new_width + col * 2 - 1]
-							+ new_positions[row * 2 * new_width + col * 2 + 1]) / 8.f;
+				mesh.indices.insert(mesh.indices.end(), {loop[0], loop[1], loop[2], loop[0], loop[2], loop[3]});
+				continue;
+			}
 
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 6.f
-							+ new_normals[row * 2 * new_width + col * 2 - 1]
-							+ new_normals[row * 2 * new_width + col * 2 + 1]) / 8.f;
+			auto center{vertex(leaf.x + half, leaf.y + half)};
+			for(size_t i{0}; i < loop.size(); ++i)
+				mesh.indices.insert(mesh.indices.end(), {center, loop[i], loop[(i + 1) % loop.size()]});
+		}
 
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 6.f
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 - 1]
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 + 1]) / 8.f;
-				}
-				// Vertical boundary vertex
-				else if((col == 0 || col + 1 == width) && row > 0 && row + 1 < height)
-				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 6.f
-							+ new_positions[(row * 2 - 1) * new_width + col * 2]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2]) / 8.f;
+		auto points{evaluate_limit(parameters)};
+		mesh.positions.resize(points.size());
+		mesh.normals.resize(points.size());
+		mesh.texture_coordinates.resize(points.size());
+		for(size_t i{0}; i < points.size(); ++i)
+		{
+			mesh.positions[i] = points[i].position;
+			mesh.normals[i] = points[i].normal;
+			mesh.texture_coordinates[i] = points[i].texture_coordinate;
+		}
 
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 6.f
-							+ new_normals[(row * 2 - 1) * new_width + col * 2]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2]) / 8.f;
+		std::cout << "RegularMesh: Adaptive refinement produced " << mesh.positions.size() << " vertices and " << mesh.indices.size() / 3
+			<< " triangles, uniform refinement needs " << (size_t{fine_width} + 1) * (fine_height + 1) << " vertices\n";
 
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 6.f
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2]) / 8.f;
-				}
-				// Corner vertex
-				else if(row == 0 || row + 1 == height || col == 0 || col + 1 == width)
-				{
-					new_positions[row * 2 * new_width + col * 2] = positions[row * width + col];
+		return mesh;
+	}
 
-					new_normals[row * 2 * new_width + col * 2] = normals[row * width + col];
+	stencil::Grid RegularMesh::limit_control_grid() const
+	{
+		stencil::Grid control{height + 2, width + 2, channel_count};
+		for(size_t row{0}; row < height; ++row)
+		{
+			float* channels[channel_count];
+			for(size_t channel{0}; channel < channel_count; ++channel)
+				channels[channel] = control.row(channel, row + 1) + 1;
 
-					new_texture_coordinates[row * 2 * new_width + col * 2] = texture_coordinates[row * width + col];
-				}
-				// Regular inside vertex
-				else
-				{
-					new_positions[row * 2 * new_width + col * 2] = (positions[row * width + col] * 8.f
-							+ new_positions[row * 2 * new_width + col * 2 - 1]
-							+ new_positions[row * 2 * new_width + col * 2 + 1]
-							+ new_positions[(row * 2 - 1) * new_width + col * 2]
-							+ new_positions[(row * 2 + 1)* new_width + col * 2]
-							+ new_positions[(row * 2 - 1) * new_width + col * 2 - 1]
-							+ new_positions[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_positions[(row * 2 + 1) * new_width + col * 2 + 1]) / 16.f;
-
-					new_normals[row * 2 * new_width + col * 2] = (normals[row * width + col] * 8.f
-							+ new_normals[row * 2 * new_width + col * 2 - 1]
-							+ new_normals[row * 2 * new_width + col * 2 + 1]
-							+ new_normals[(row * 2 - 1) * new_width + col * 2]
-							+ new_normals[(row * 2 + 1)* new_width + col * 2]
-							+ new_normals[(row * 2 - 1) * new_width + col * 2 - 1]
-							+ new_normals[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_normals[(row * 2 + 1) * new_width + col * 2 + 1]) / 16.f;
-
-					new_texture_coordinates[row * 2 * new_width + col * 2] = (texture_coordinates[row * width + col] * 8.f
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 - 1]
-							+ new_texture_coordinates[row * 2 * new_width + col * 2 + 1]
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2]
-							+ new_texture_coordinates[(row * 2 + 1)* new_width + col * 2]
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2 - 1]
-							+ new_texture_coordinates[(row * 2 - 1) * new_width + col * 2 + 1]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 - 1]
-							+ new_texture_coordinates[(row * 2 + 1) * new_width + col * 2 + 1]) / 16.f;
-				}
+			for(size_t col{0}; col < width; ++col)
+			{
+				auto i{row * width + col};
+				channels[0][col] = positions[i].x;
+				channels[1][col] = positions[i].y;
+				channels[2][col] = positions[i].z;
+				channels[3][col] = normals[i].x;
+				channels[4][col] = normals[i].y;
+				channels[5][col] = normals[i].z;
+				channels[6][col] = texture_coordinates[i].x;
+				channels[7][col] = texture_coordinates[i].y;
 			}
 		}
 
-		positions = new_positions;
-		normals = new_normals;
-		texture_coordinates = new_texture_coordinates;
-		width = width * 2 - 1;
-		height = height * 2 - 1;
+		// Phantom columns first, then phantom rows including the corners
+		for(size_t channel{0}; channel < channel_count; ++channel)
+		{
+			for(size_t row{1}; row <= height; ++row)
+			{
+				auto* values{control.row(channel, row)};
+				values[0] = 2.f * values[1] - values[2];
+				values[width + 1] = 2.f * values[width] - values[width - 1];
+			}
+
+			auto phantom{[&control, channel, this] (size_t target, size_t edge, size_t inner) {
+				auto* values{control.row(channel, target)};
+				const auto* edge_values{control.row(channel, edge)};
+				const auto* inner_values{control.row(channel, inner)};
+				for(size_t col{0}; col < width + 2; ++col)
+					values[col] = 2.f * edge_values[col] - inner_values[col];
+			}};
+			phantom(0, 1, 2);
+			phantom(height + 1, height, height - 1);
+		}
+
+		return control;
+	}
+
+	size_t RegularMesh::get_width() const
+	{
+		return width;
+	}
+
+	size_t RegularMesh::get_height() const
+	{
+		return height;
 	}
 
 	const std::vector<glm::vec3>& RegularMesh::get_positions() const
@@ -581,4 +892,26 @@ namespace cg
 	{
 		return texture_coordinates;
 	}
+
+	MemoryUsage RegularMesh::get_memory_usage() const
+	{
+		MemoryUsage usage{"RegularMesh", {}};
+		usage.add_vector("positions", positions);
+		usage.add_vector("normals", normals);
+		usage.add_vector("texture coordinates", texture_coordinates);
+
+		size_t blocks{0};
+		size_t overhead{0};
+		for(const auto& component : usage.components)
+		{
+			if(component.reserved)
+			{
+				++blocks;
+				overhead += MemoryUsage::allocation_size(component.reserved) - component.reserved;
+			}
+		}
+		usage.add("allocator overhead", blocks, 0, overhead);
+
+		return usage;
+	}
 }
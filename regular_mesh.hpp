@@ -1,8 +1,14 @@
 #ifndef REGULAR_MESH_HPP
 #define REGULAR_MESH_HPP
 
+#include "grid_indices.hpp"
+#include "memory_usage.hpp"
+#include "stencil.hpp"
+
 #include "glm/glm.hpp"
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,6 +17,30 @@ namespace cg
 	class RegularMesh
 	{
 		public:
+			enum class Scheme
+			{
+				loop,
+				catmull_clark,
+				catmull_clark_sharp_bounds
+			};
+
+			/// Triangles of an adaptive refinement, indices reference the vertex vectors.
+			struct AdaptiveMesh
+			{
+				std::vector<glm::vec3> positions;
+				std::vector<glm::vec3> normals;
+				std::vector<glm::vec2> texture_coordinates;
+				std::vector<unsigned int> indices;
+			};
+
+			/// Point of the limit surface with the exact surface normal.
+			struct LimitPoint
+			{
+				glm::vec3 position;
+				glm::vec3 normal;
+				glm::vec2 texture_coordinate;
+			};
+
 			RegularMesh() = delete;
 			explicit RegularMesh(size_t width, size_t height, const std::vector<glm::vec3> positions, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texture_coordinates);
 
@@ -26,17 +56,62 @@ namespace cg
 			std::vector<glm::vec2>& get_texture_coordinates();
 
 			std::vector<unsigned int> calculate_indices() const;
+
+			/// Shared index buffers for the current dimensions, see grid_indices.
+			std::shared_ptr<const std::vector<unsigned int>> get_triangle_indices() const;
+			std::shared_ptr<const std::vector<unsigned int>> get_strip_indices() const;
+			std::shared_ptr<const grid_indices::Tiling> get_tiled_indices(size_t tile_size) const;
+
+			MemoryUsage get_memory_usage() const;
 			
 			void loop_subdivision();
 			void catmull_clark_subdivision();
 			void catmull_clark_subdivision_sharp_bounds();
 
+			/// Applies levels steps of scheme at once. All buffers are sized for the largest level up front
+			/// and reused, intermediate levels never leave the structure of arrays layout.
+			/// Throws like the single step methods if the mesh is too small for scheme.
+			void subdivide(Scheme scheme, int levels);
+			/// Like subdivide, but returns false and leaves the mesh unchanged once cancelled is set.
+			/// The flag is checked between the stencil phases, so a cancelled call returns within one phase.
+			bool subdivide(Scheme scheme, int levels, const std::atomic<bool>& cancelled);
+
+			/// Bytes held at the same time by the last subdivide call, including the result.
+			size_t get_subdivision_peak_bytes() const;
+
+			/// Evaluates the uniform bicubic B-spline surface of the grid at u in [0, width - 1] and v in [0, height - 1].
+			/// Outside of the grid phantom vertices 2 * p0 - p1 are used, so the surface interpolates the boundary vertices.
+			/// Throws invalid_argument for meshes smaller than 2x2.
+			LimitPoint evaluate_limit(float u, float v) const;
+			std::vector<LimitPoint> evaluate_limit(const std::vector<glm::vec2>& parameters) const;
+
+			/// Samples the limit surface on a new_width x new_height grid in one pass without intermediate levels.
+			RegularMesh evaluate_limit_surface(size_t new_width, size_t new_height) const;
+			/// Uses the resolution levels subdivision steps would produce.
+			RegularMesh evaluate_limit_surface(int levels) const;
+
+			/// Refines every grid cell as a quadtree of limit surface patches, at most max_levels times, wherever the surface
+			/// deviates from the bilinear patch through the corners by more than tolerance. Neighbouring leaves differ by at most
+			/// one level and leaves next to finer ones are split into triangle fans, so the index buffer has no cracks.
+			AdaptiveMesh refine_adaptive(int max_levels, float tolerance) const;
+
 		private:
+			/// Positions, normals and texture coordinates as separate float channels.
+			static constexpr size_t channel_count{8};
+
+			/// Implements both subdivide overloads, cancelled may be null.
+			bool subdivide_unless(Scheme scheme, int levels, const std::atomic<bool>* cancelled);
+
+			/// Copies all channels of the grid extended by one ring of phantom vertices.
+			stencil::Grid limit_control_grid() const;
+
 			size_t width{0};
 			size_t height{0};
 			std::vector<glm::vec3> positions;
 			std::vector<glm::vec3> normals;
 			std::vector<glm::vec2> texture_coordinates;
+
+			size_t subdivision_peak_bytes{0};
 	};
 }
 
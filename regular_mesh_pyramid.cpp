@@ -0,0 +1,175 @@
+#include "regular_mesh_pyramid.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace cg
+{
+	RegularMeshPyramid::RegularMeshPyramid(const RegularMesh& base, Storage storage)
+		: storage{storage},
+		  meshes{base}
+	{
+	}
+
+	size_t RegularMeshPyramid::push(RegularMesh::Scheme scheme)
+	{
+		if(storage == Storage::full)
+			meshes.push_back(predict(meshes.back(), scheme));
+		schemes.push_back(scheme);
+		details.emplace_back();
+		return schemes.size();
+	}
+
+	size_t RegularMeshPyramid::push(RegularMesh level, RegularMesh::Scheme scheme)
+	{
+		// Every scheme doubles the number of quads in both directions
+		const auto& coarse{storage == Storage::full ? meshes.back() : get_finest()};
+		auto width{coarse.get_width() * 2 - 1};
+		auto height{coarse.get_height() * 2 - 1};
+		if(level.get_width() != width || level.get_height() != height)
+		{
+			std::cerr << "RegularMeshPyramid: Level of " << level.get_width() << "x" << level.get_height() << " vertices does not match the "
+				<< width << "x" << height << " prediction\n";
+			throw std::invalid_argument{"RegularMeshPyramid: Adding level failed."};
+		}
+
+		Details level_details{};
+		if(storage == Storage::details)
+		{
+			auto prediction{predict(coarse, scheme)};
+			const auto& positions{level.get_positions()};
+			const auto& normals{level.get_normals()};
+			const auto& texture_coordinates{level.get_texture_coordinates()};
+			for(size_t i{0}; i < positions.size(); ++i)
+			{
+				if(positions[i] != prediction.get_positions()[i] || normals[i] != prediction.get_normals()[i]
+					|| texture_coordinates[i] != prediction.get_texture_coordinates()[i])
+				{
+					level_details.vertices.push_back(static_cast<std::uint32_t>(i));
+					level_details.positions.push_back(positions[i]);
+					level_details.normals.push_back(normals[i]);
+					level_details.texture_coordinates.push_back(texture_coordinates[i]);
+				}
+			}
+		}
+		else
+		{
+			meshes.push_back(std::move(level));
+		}
+
+		schemes.push_back(scheme);
+		details.push_back(std::move(level_details));
+		if(storage == Storage::details)
+		{
+			cached = std::move(level);
+			cached_level = schemes.size();
+		}
+		return schemes.size();
+	}
+
+	void RegularMeshPyramid::truncate(size_t level_count)
+	{
+		level_count = std::max(level_count, size_t{1});
+		if(level_count >= get_level_count())
+			return;
+
+		if(storage == Storage::full)
+			meshes.erase(meshes.begin() + level_count, meshes.end());
+		if(cached && cached_level >= level_count)
+			cached.reset();
+		schemes.resize(level_count - 1);
+		details.erase(details.begin() + (level_count - 1), details.end());
+	}
+
+	size_t RegularMeshPyramid::get_level_count() const
+	{
+		return schemes.size() + 1;
+	}
+
+	RegularMeshPyramid::Storage RegularMeshPyramid::get_storage() const
+	{
+		return storage;
+	}
+
+	RegularMesh RegularMeshPyramid::get_level(size_t level) const
+	{
+		if(level >= get_level_count())
+			throw std::out_of_range{"RegularMeshPyramid: Level does not exist."};
+
+		if(storage == Storage::full)
+			return meshes[level];
+
+		auto from_cache{cached && cached_level <= level};
+		auto mesh{from_cache ? *cached : meshes.front()};
+		for(auto i{from_cache ? cached_level + 1 : size_t{1}}; i <= level; ++i)
+			reconstruct(mesh, i);
+		return mesh;
+	}
+
+	RegularMesh::Scheme RegularMeshPyramid::get_scheme(size_t level) const
+	{
+		if(level == 0 || level >= get_level_count())
+			throw std::out_of_range{"RegularMeshPyramid: Level has no scheme."};
+
+		return schemes[level - 1];
+	}
+
+	MemoryUsage RegularMeshPyramid::get_memory_usage() const
+	{
+		MemoryUsage usage{"RegularMeshPyramid", {}};
+		for(size_t i{0}; i < meshes.size(); ++i)
+		{
+			auto mesh_usage{meshes[i].get_memory_usage()};
+			usage.add("level " + std::to_string(i) + " mesh", meshes[i].get_positions().size(), mesh_usage.get_used(), mesh_usage.get_reserved());
+		}
+		for(size_t i{0}; i < details.size(); ++i)
+		{
+			if(details[i].vertices.empty())
+				continue;
+
+			MemoryUsage level_usage{};
+			level_usage.add_vector("", details[i].vertices);
+			level_usage.add_vector("", details[i].positions);
+			level_usage.add_vector("", details[i].normals);
+			level_usage.add_vector("", details[i].texture_coordinates);
+			usage.add("level " + std::to_string(i + 1) + " details", details[i].vertices.size(), level_usage.get_used(), level_usage.get_reserved());
+		}
+		usage.add_vector("schemes", schemes);
+		usage.add_vector("detail levels", details);
+		return usage;
+	}
+
+	RegularMesh RegularMeshPyramid::predict(const RegularMesh& coarse, RegularMesh::Scheme scheme)
+	{
+		auto fine{coarse};
+		fine.subdivide(scheme, 1);
+		return fine;
+	}
+
+	void RegularMeshPyramid::reconstruct(RegularMesh& mesh, size_t level) const
+	{
+		mesh.subdivide(schemes[level - 1], 1);
+		const auto& level_details{details[level - 1]};
+		for(size_t k{0}; k < level_details.vertices.size(); ++k)
+		{
+			mesh.get_positions()[level_details.vertices[k]] = level_details.positions[k];
+			mesh.get_normals()[level_details.vertices[k]] = level_details.normals[k];
+			mesh.get_texture_coordinates()[level_details.vertices[k]] = level_details.texture_coordinates[k];
+		}
+	}
+
+	const RegularMesh& RegularMeshPyramid::get_finest()
+	{
+		auto finest{get_level_count() - 1};
+		if(!cached)
+		{
+			cached = meshes.front();
+			cached_level = 0;
+		}
+		for(; cached_level < finest; ++cached_level)
+			reconstruct(*cached, cached_level + 1);
+		return *cached;
+	}
+}
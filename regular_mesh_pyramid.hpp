@@ -0,0 +1,75 @@
+#ifndef REGULAR_MESH_PYRAMID_HPP
+#define REGULAR_MESH_PYRAMID_HPP
+
+#include "memory_usage.hpp"
+#include "regular_mesh.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace cg
+{
+	/// Keeps every subdivision level of a RegularMesh, so going back to a coarser level does not start over from the base.
+	/// Level 0 is the base mesh and level i + 1 was predicted from level i by a subdivision scheme.
+	class RegularMeshPyramid
+	{
+		public:
+			enum class Storage
+			{
+				/// Every level is stored as a mesh, get_level is a copy.
+				full,
+				/// Only the base is stored, finer levels keep the vertices that differ from their prediction.
+				/// Levels produced by push(scheme) cost no memory, get_level subdivides again from the base.
+				/// The finest level reconstructed by push(level, scheme) is kept, so consecutive pushes predict once each.
+				details
+			};
+
+			explicit RegularMeshPyramid(const RegularMesh& base, Storage storage = Storage::full);
+
+			/// Subdivides the finest level with scheme and returns the index of the new level.
+			size_t push(RegularMesh::Scheme scheme);
+			/// Adds level, for example an edited subdivision, as the successor of the finest level predicted by scheme.
+			/// Throws invalid_argument if its dimensions do not match the prediction. Full storage only checks the
+			/// dimensions and takes level as it is, details storage predicts it once to find the vertices that differ.
+			size_t push(RegularMesh level, RegularMesh::Scheme scheme);
+
+			/// Drops all levels from level_count on, the base always stays.
+			void truncate(size_t level_count);
+
+			size_t get_level_count() const;
+			Storage get_storage() const;
+			RegularMesh get_level(size_t level) const;
+			RegularMesh::Scheme get_scheme(size_t level) const;
+
+			MemoryUsage get_memory_usage() const;
+
+		private:
+			/// Vertices of a level that differ from its prediction with all of their attributes.
+			struct Details
+			{
+				std::vector<std::uint32_t> vertices;
+				std::vector<glm::vec3> positions;
+				std::vector<glm::vec3> normals;
+				std::vector<glm::vec2> texture_coordinates;
+			};
+
+			static RegularMesh predict(const RegularMesh& coarse, RegularMesh::Scheme scheme);
+			/// Turns level - 1 in mesh into level by subdividing it and applying the details of level.
+			void reconstruct(RegularMesh& mesh, size_t level) const;
+			/// Reconstructs the finest level for details storage, continuing from the cached level if there is one.
+			const RegularMesh& get_finest();
+
+			Storage storage;
+			/// Every level for full storage, only the base for details.
+			std::vector<RegularMesh> meshes;
+			/// Scheme and details of level i + 1.
+			std::vector<RegularMesh::Scheme> schemes;
+			std::vector<Details> details;
+			/// Reconstruction of level cached_level for details storage.
+			std::optional<RegularMesh> cached;
+			size_t cached_level{0};
+	};
+}
+
+#endif // REGULAR_MESH_PYRAMID_HPP
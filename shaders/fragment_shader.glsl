@@ -1,8 +1,14 @@
 #version 330 core
 
-in vec4 vertex_color;
+in vec3 vertex_normal;
+in vec2 vertex_texture_coordinate;
+out vec4 color;
+
+uniform vec3 light_direction;
 
 void main()
 {
-	gl_FragColor = vertex_color;
+	// Lit from both sides, the loaded meshes do not share one winding order
+	float diffuse = abs(dot(normalize(vertex_normal), light_direction));
+	color = vec4(vec3(.2f + .8f * diffuse), 1.f);
 }
@@ -0,0 +1,20 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texture_coordinate;
+layout(location = 3) in mat4 instance_model;
+layout(location = 7) in mat3 instance_normal_matrix;
+out vec3 vertex_normal;
+out vec2 vertex_texture_coordinate;
+
+uniform mat4 mvp;
+uniform mat3 normal_matrix;
+
+void main()
+{
+	// mvp and normal_matrix transform all instances after their own model matrix
+	gl_Position = mvp * instance_model * vec4(pos, 1.f);
+	vertex_normal = normal_matrix * instance_normal_matrix * normal;
+	vertex_texture_coordinate = texture_coordinate;
+}
@@ -1,13 +1,17 @@
 #version 330 core
 
 layout(location = 0) in vec3 pos;
-out vec4 vertex_color;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texture_coordinate;
+out vec3 vertex_normal;
+out vec2 vertex_texture_coordinate;
 
 uniform mat4 mvp;
+uniform mat3 normal_matrix;
 
 void main()
 {
-	vec4 position = mvp * vec4(pos, 1.f);
-	gl_Position = position;
-	vertex_color = vec4(1.f);//vec4(position.zzz * -0.5f + 0.5f, 1.f);
+	gl_Position = mvp * vec4(pos, 1.f);
+	vertex_normal = normal_matrix * normal;
+	vertex_texture_coordinate = texture_coordinate;
 }
@@ -0,0 +1,395 @@
+#include "software_rasterizer.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace cg
+{
+	namespace
+	{
+		/// Window coordinates are snapped to 1/subpixels of a pixel.
+		constexpr std::int64_t subpixels{256};
+		/// Input triangles set up by one task, also the granularity of the bins.
+		constexpr size_t batch_triangles{4096};
+		/// Triangles are clipped against x and y only at this multiple of the viewport, so snapped coordinates stay far
+		/// from overflowing. The pixels in between are skipped by the bounding boxes.
+		constexpr float guard_band{4.f};
+		/// Same light as the lit shader.
+		const glm::vec3 light_direction{glm::normalize(glm::vec3{.3f, .5f, 1.f})};
+
+		struct ClipVertex
+		{
+			glm::vec4 position;
+			glm::vec3 normal;
+		};
+
+		/// A triangle clipped against six planes has at most nine vertices.
+		using Polygon = std::array<ClipVertex, 9>;
+
+		/// Sutherland-Hodgman against the points with dot(plane, position) >= 0, returns the new vertex count.
+		size_t clip(const Polygon& input, size_t count, const glm::vec4& plane, Polygon& output)
+		{
+			size_t result{0};
+			for(size_t i{0}; i < count; ++i)
+			{
+				const auto& current{input[i]};
+				const auto& next{input[(i + 1) % count]};
+				auto current_distance{glm::dot(plane, current.position)};
+				auto next_distance{glm::dot(plane, next.position)};
+				if(current_distance >= 0.f)
+					output[result++] = current;
+				if((current_distance >= 0.f) != (next_distance >= 0.f))
+				{
+					auto t{current_distance / (current_distance - next_distance)};
+					output[result++] = {glm::mix(current.position, next.position, t), glm::mix(current.normal, next.normal, t)};
+				}
+			}
+			return result;
+		}
+
+		/// Twice the signed area of a, b, p, positive if p is left of a to b.
+		std::int64_t edge(std::int64_t ax, std::int64_t ay, std::int64_t bx, std::int64_t by, std::int64_t px, std::int64_t py)
+		{
+			return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+		}
+
+		/// Pixels whose centers lie exactly on an edge belong to the triangle left or below of it, so pixels on shared
+		/// edges are drawn exactly once. With counter clockwise winding these are the edges going down or going left.
+		std::int64_t edge_bias(std::int64_t ax, std::int64_t ay, std::int64_t bx, std::int64_t by)
+		{
+			return by < ay || (by == ay && bx < ax) ? 0 : -1;
+		}
+
+		/// First and last pixel whose center lies within [min, max] subpixels.
+		int first_pixel(std::int64_t min)
+		{
+			auto offset{min - subpixels / 2};
+			return static_cast<int>(offset >= 0 ? (offset + subpixels - 1) / subpixels : -((-offset) / subpixels));
+		}
+
+		int last_pixel(std::int64_t max)
+		{
+			auto offset{max - subpixels / 2};
+			return static_cast<int>(offset >= 0 ? offset / subpixels : -((-offset + subpixels - 1) / subpixels));
+		}
+
+		glm::vec3 shade(const glm::vec3& normal, SoftwareRasterizer::Shading shading)
+		{
+			if(shading == SoftwareRasterizer::Shading::normals)
+				return normal * .5f + .5f;
+			// Lit from both sides like the shader
+			return glm::vec3{.2f + .8f * std::abs(glm::dot(normal, light_direction))};
+		}
+
+		unsigned char to_byte(float value)
+		{
+			return static_cast<unsigned char>(std::clamp(value, 0.f, 1.f) * 255.f + .5f);
+		}
+	}
+
+	void SoftwareRasterizer::Image::write(const std::string& path) const
+	{
+		std::ofstream file{path, std::ios::binary};
+		file << "P6\n" << width << ' ' << height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+		if(!file)
+		{
+			std::cerr << "SoftwareRasterizer: Could not write image " << path << '\n';
+			throw std::runtime_error{"Writing image failed."};
+		}
+	}
+
+	SoftwareRasterizer::Image SoftwareRasterizer::Image::read(const std::string& path)
+	{
+		std::ifstream file{path, std::ios::binary};
+		std::string magic{};
+		Image image{};
+		int max_value{0};
+		file >> magic >> image.width >> image.height >> max_value;
+		file.get();
+		if(!file || magic != "P6" || max_value != 255)
+		{
+			std::cerr << "SoftwareRasterizer: " << path << " is not a binary PPM image with 8 bit channels\n";
+			throw std::runtime_error{"Reading image failed."};
+		}
+
+		image.pixels.resize(image.width * image.height * 3);
+		file.read(reinterpret_cast<char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+		if(!file)
+		{
+			std::cerr << "SoftwareRasterizer: " << path << " ends before its " << image.width << "x" << image.height << " pixels\n";
+			throw std::runtime_error{"Reading image failed."};
+		}
+		return image;
+	}
+
+	size_t SoftwareRasterizer::Image::compare(const Image& a, const Image& b, int tolerance)
+	{
+		if(a.width != b.width || a.height != b.height)
+		{
+			std::cerr << "SoftwareRasterizer: Can not compare a " << a.width << "x" << a.height << " image to a " << b.width << "x" << b.height << " image\n";
+			throw std::invalid_argument{"Comparing images failed."};
+		}
+
+		size_t different{0};
+		for(size_t i{0}; i < a.pixels.size(); i += 3)
+		{
+			for(size_t channel{0}; channel < 3; ++channel)
+			{
+				if(std::abs(a.pixels[i + channel] - b.pixels[i + channel]) > tolerance)
+				{
+					++different;
+					break;
+				}
+			}
+		}
+		return different;
+	}
+
+	SoftwareRasterizer::SoftwareRasterizer(size_t width, size_t height, size_t tile_size)
+		: width{width},
+		  height{height},
+		  tile_size{tile_size}
+	{
+		if(!width || !height || !tile_size)
+		{
+			std::cerr << "SoftwareRasterizer: Can not rasterize " << width << "x" << height << " pixels in tiles of " << tile_size << '\n';
+			throw std::invalid_argument{"Creating rasterizer failed."};
+		}
+
+		tiles_x = (width + tile_size - 1) / tile_size;
+		tiles_y = (height + tile_size - 1) / tile_size;
+		color.resize(width * height * 3);
+		depth.resize(width * height);
+		clear();
+	}
+
+	void SoftwareRasterizer::clear(const glm::vec3& clear_color)
+	{
+		for(size_t i{0}; i < color.size(); i += 3)
+		{
+			color[i] = to_byte(clear_color.x);
+			color[i + 1] = to_byte(clear_color.y);
+			color[i + 2] = to_byte(clear_color.z);
+		}
+		std::fill(depth.begin(), depth.end(), 1.f);
+		statistics = Statistics{};
+	}
+
+	void SoftwareRasterizer::draw(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& indices,
+		const glm::mat4& view_projection, const glm::mat4& model, Shading shading)
+	{
+		auto largest{std::max_element(indices.begin(), indices.end())};
+		if(largest != indices.end() && *largest >= positions.size())
+		{
+			std::cerr << "SoftwareRasterizer: Index " << *largest << " exceeds the " << positions.size() << " positions\n";
+			throw std::out_of_range{"Drawing triangles failed."};
+		}
+		auto has_normals{normals.size() == positions.size() && shading != Shading::flat};
+
+		auto& pool{ThreadPool::get_global()};
+		auto mvp{view_projection * model};
+		auto normal_matrix{glm::transpose(glm::inverse(glm::mat3{model}))};
+		std::vector<ClipVertex> vertices(positions.size());
+		pool.parallel_for(0, positions.size(), 4096, [&] (size_t begin, size_t end) {
+			for(auto i{begin}; i < end; ++i)
+				vertices[i] = {mvp * glm::vec4{positions[i], 1.f}, has_normals ? normal_matrix * normals[i] : glm::vec3{0.f}};
+		});
+
+		// Set up and bin every batch on its own, tiles then visit the batches in order
+		auto triangle_count{indices.size() / 3};
+		batches.resize((triangle_count + batch_triangles - 1) / batch_triangles);
+		pool.parallel_for(0, batches.size(), 1, [&] (size_t begin, size_t end) {
+			const std::array<glm::vec4, 6> planes{{{1.f, 0.f, 0.f, guard_band}, {-1.f, 0.f, 0.f, guard_band}, {0.f, 1.f, 0.f, guard_band},
+				{0.f, -1.f, 0.f, guard_band}, {0.f, 0.f, 1.f, 1.f}, {0.f, 0.f, -1.f, 1.f}}};
+			Polygon polygon{};
+			Polygon clipped{};
+			for(auto b{begin}; b < end; ++b)
+			{
+				auto& batch{batches[b]};
+				batch.triangles.clear();
+				batch.bins.resize(tiles_x * tiles_y);
+				for(auto& bin : batch.bins)
+					bin.clear();
+
+				for(auto t{b * batch_triangles}; t < std::min((b + 1) * batch_triangles, triangle_count); ++t)
+				{
+					const auto* triangle{&indices[3 * t]};
+					auto face_normal{normal_matrix * glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]])};
+					face_normal = face_normal != glm::vec3{0.f} ? glm::normalize(face_normal) : face_normal;
+
+					size_t count{3};
+					for(size_t i{0}; i < 3; ++i)
+						polygon[i] = {vertices[triangle[i]].position, has_normals ? vertices[triangle[i]].normal : face_normal};
+					for(const auto& plane : planes)
+					{
+						count = clip(polygon, count, plane, clipped);
+						std::swap(polygon, clipped);
+					}
+
+					// Fan of the clipped polygon
+					for(size_t i{1}; i + 1 < count; ++i)
+					{
+						Triangle setup{};
+						const ClipVertex* corners[3]{&polygon[0], &polygon[i], &polygon[i + 1]};
+						for(size_t k{0}; k < 3; ++k)
+						{
+							auto inverse_w{1.f / corners[k]->position.w};
+							glm::vec3 ndc{glm::vec3{corners[k]->position} * inverse_w};
+							setup.x[k] = std::llround((ndc.x * .5f + .5f) * static_cast<float>(width) * subpixels);
+							setup.y[k] = std::llround((ndc.y * .5f + .5f) * static_cast<float>(height) * subpixels);
+							setup.z[k] = ndc.z * .5f + .5f;
+							setup.inverse_w[k] = inverse_w;
+							setup.normals[k] = corners[k]->normal * inverse_w;
+						}
+
+						setup.area = edge(setup.x[0], setup.y[0], setup.x[1], setup.y[1], setup.x[2], setup.y[2]);
+						if(setup.area == 0)
+							continue;
+						// Edge functions are positive inside for counter clockwise triangles
+						if(setup.area < 0)
+						{
+							std::swap(setup.x[1], setup.x[2]);
+							std::swap(setup.y[1], setup.y[2]);
+							std::swap(setup.z[1], setup.z[2]);
+							std::swap(setup.inverse_w[1], setup.inverse_w[2]);
+							std::swap(setup.normals[1], setup.normals[2]);
+							setup.area = -setup.area;
+						}
+						setup.face_normal = face_normal;
+
+						setup.min_x = std::max(first_pixel(std::min({setup.x[0], setup.x[1], setup.x[2]})), 0);
+						setup.min_y = std::max(first_pixel(std::min({setup.y[0], setup.y[1], setup.y[2]})), 0);
+						setup.max_x = std::min(last_pixel(std::max({setup.x[0], setup.x[1], setup.x[2]})), static_cast<int>(width) - 1);
+						setup.max_y = std::min(last_pixel(std::max({setup.y[0], setup.y[1], setup.y[2]})), static_cast<int>(height) - 1);
+						if(setup.min_x > setup.max_x || setup.min_y > setup.max_y)
+							continue;
+
+						auto index{static_cast<std::uint32_t>(batch.triangles.size())};
+						batch.triangles.push_back(setup);
+						for(auto tile_y{setup.min_y / tile_size}; tile_y <= setup.max_y / tile_size; ++tile_y)
+							for(auto tile_x{setup.min_x / tile_size}; tile_x <= setup.max_x / tile_size; ++tile_x)
+								batch.bins[tile_y * tiles_x + tile_x].push_back(index);
+					}
+				}
+			}
+		});
+
+		std::vector<size_t> fragments(tiles_x * tiles_y, 0);
+		pool.parallel_for(0, tiles_x * tiles_y, 1, [&] (size_t begin, size_t end) {
+			for(auto tile{begin}; tile < end; ++tile)
+				rasterize_tile(tile, shading, fragments[tile]);
+		});
+
+		statistics.triangles += triangle_count;
+		for(const auto& batch : batches)
+			statistics.rasterized += batch.triangles.size();
+		for(auto count : fragments)
+			statistics.fragments += count;
+	}
+
+	void SoftwareRasterizer::draw(const SoupMesh& mesh, const glm::mat4& view_projection, const glm::mat4& model, Shading shading)
+	{
+		draw(mesh.get_positions(), mesh.get_normals(), mesh.calculate_indices(), view_projection, model, shading);
+	}
+
+	void SoftwareRasterizer::rasterize_tile(size_t tile, Shading shading, size_t& fragments)
+	{
+		auto tile_min_x{static_cast<int>((tile % tiles_x) * tile_size)};
+		auto tile_min_y{static_cast<int>((tile / tiles_x) * tile_size)};
+		auto tile_max_x{static_cast<int>(std::min((tile % tiles_x + 1) * tile_size, width)) - 1};
+		auto tile_max_y{static_cast<int>(std::min((tile / tiles_x + 1) * tile_size, height)) - 1};
+
+		for(const auto& batch : batches)
+		{
+			for(auto index : batch.bins[tile])
+			{
+				const auto& triangle{batch.triangles[index]};
+				const auto& x{triangle.x};
+				const auto& y{triangle.y};
+				std::int64_t bias[3]{edge_bias(x[1], y[1], x[2], y[2]), edge_bias(x[2], y[2], x[0], y[0]), edge_bias(x[0], y[0], x[1], y[1])};
+				// Edge functions change by these steps from one pixel to the next in x
+				std::int64_t step[3]{-(y[2] - y[1]) * subpixels, -(y[0] - y[2]) * subpixels, -(y[1] - y[0]) * subpixels};
+				auto inverse_area{1.f / static_cast<float>(triangle.area)};
+
+				auto min_x{std::max(triangle.min_x, tile_min_x)};
+				auto max_x{std::min(triangle.max_x, tile_max_x)};
+				for(auto row{std::max(triangle.min_y, tile_min_y)}; row <= std::min(triangle.max_y, tile_max_y); ++row)
+				{
+					auto px{min_x * subpixels + subpixels / 2};
+					auto py{row * subpixels + subpixels / 2};
+					std::int64_t edges[3]{edge(x[1], y[1], x[2], y[2], px, py), edge(x[2], y[2], x[0], y[0], px, py), edge(x[0], y[0], x[1], y[1], px, py)};
+					// Triangles are convex, so the covered pixels of a row are consecutive
+					bool entered{false};
+					for(auto col{min_x}; col <= max_x; ++col)
+					{
+						if(edges[0] + bias[0] >= 0 && edges[1] + bias[1] >= 0 && edges[2] + bias[2] >= 0)
+						{
+							entered = true;
+							glm::vec3 weights{static_cast<float>(edges[0]) * inverse_area, static_cast<float>(edges[1]) * inverse_area,
+								static_cast<float>(edges[2]) * inverse_area};
+							auto z{weights[0] * triangle.z[0] + weights[1] * triangle.z[1] + weights[2] * triangle.z[2]};
+							auto pixel{static_cast<size_t>(row) * width + static_cast<size_t>(col)};
+							if(z < depth[pixel])
+							{
+								depth[pixel] = z;
+								auto normal{triangle.face_normal};
+								if(shading != Shading::flat)
+								{
+									auto interpolated{(weights[0] * triangle.normals[0] + weights[1] * triangle.normals[1] + weights[2] * triangle.normals[2])
+										/ (weights[0] * triangle.inverse_w[0] + weights[1] * triangle.inverse_w[1] + weights[2] * triangle.inverse_w[2])};
+									if(interpolated != glm::vec3{0.f})
+										normal = glm::normalize(interpolated);
+								}
+
+								auto shaded{shade(normal, shading)};
+								for(size_t channel{0}; channel < 3; ++channel)
+									color[pixel * 3 + channel] = to_byte(shaded[static_cast<int>(channel)]);
+								++fragments;
+							}
+						}
+						else if(entered)
+							break;
+						for(size_t k{0}; k < 3; ++k)
+							edges[k] += step[k];
+					}
+				}
+			}
+		}
+	}
+
+	SoftwareRasterizer::Image SoftwareRasterizer::get_image() const
+	{
+		// Image rows go from top to bottom
+		Image image{width, height, std::vector<unsigned char>(color.size())};
+		for(size_t row{0}; row < height; ++row)
+			std::copy_n(color.begin() + static_cast<std::ptrdiff_t>((height - 1 - row) * width * 3), width * 3, image.pixels.begin() + static_cast<std::ptrdiff_t>(row * width * 3));
+		return image;
+	}
+
+	const std::vector<float>& SoftwareRasterizer::get_depth() const
+	{
+		return depth;
+	}
+
+	const SoftwareRasterizer::Statistics& SoftwareRasterizer::get_statistics() const
+	{
+		return statistics;
+	}
+
+	size_t SoftwareRasterizer::get_width() const
+	{
+		return width;
+	}
+
+	size_t SoftwareRasterizer::get_height() const
+	{
+		return height;
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef SOFTWARE_RASTERIZER_HPP
+#define SOFTWARE_RASTERIZER_HPP
+
+#include "soup_mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cg
+{
+	/// CPU reference for the triangles MeshRenderer draws, for machines without OpenGL. Takes the same vertex and index
+	/// arrays and matrices and shades like the lit shader in shaders/, with a depth buffer and GL_LESS depth test.
+	/// Triangles are clipped, snapped to 1/256 pixel and binned into square tiles, which are rasterized in parallel
+	/// on the global ThreadPool. Every tile handles its triangles in submission order and coverage follows the top left
+	/// rule with exact integer edge functions, so images do not depend on the thread count.
+	class SoftwareRasterizer
+	{
+		public:
+			enum class Shading
+			{
+				/// One normal per triangle.
+				flat,
+				/// Perspective correct vertex normals, flat for meshes without normals.
+				smooth,
+				/// Interpolated normals as colors, mapped from [-1, 1] to [0, 1].
+				normals
+			};
+
+			/// RGB pixels in rows from top to bottom, like the frames Application captures.
+			struct Image
+			{
+				size_t width{0};
+				size_t height{0};
+				std::vector<unsigned char> pixels;
+
+				/// Throws runtime_error if the file can not be written.
+				void write(const std::string& path) const;
+				/// Reads binary PPM files with 8 bit channels. Throws runtime_error for other files.
+				static Image read(const std::string& path);
+				/// Number of pixels with a channel that differs by more than tolerance.
+				/// Throws invalid_argument if the sizes differ.
+				static size_t compare(const Image& a, const Image& b, int tolerance = 0);
+			};
+
+			/// Counts since the last clear.
+			struct Statistics
+			{
+				size_t triangles{0};
+				/// Triangles left after clipping, clipped triangles may be split into several.
+				size_t rasterized{0};
+				/// Fragments that passed the depth test.
+				size_t fragments{0};
+			};
+
+			/// Throws invalid_argument for an empty framebuffer or tile size.
+			explicit SoftwareRasterizer(size_t width, size_t height, size_t tile_size = 32);
+
+			/// Clears the color to color and the depth to the far plane.
+			void clear(const glm::vec3& color = glm::vec3{0.f});
+
+			/// Draws indices as a triangle list, normals are optional. Throws out_of_range for indices past the positions.
+			void draw(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& indices,
+				const glm::mat4& view_projection, const glm::mat4& model = glm::mat4{1.f}, Shading shading = Shading::smooth);
+			/// Draws the triangulated faces of mesh from calculate_indices.
+			void draw(const SoupMesh& mesh, const glm::mat4& view_projection, const glm::mat4& model = glm::mat4{1.f},
+				Shading shading = Shading::smooth);
+
+			Image get_image() const;
+			/// Window space depth in [0, 1] of every pixel, rows from bottom to top like OpenGL.
+			const std::vector<float>& get_depth() const;
+			const Statistics& get_statistics() const;
+
+			size_t get_width() const;
+			size_t get_height() const;
+
+		private:
+			struct Triangle
+			{
+				/// Window coordinates in 1/256 pixels.
+				std::int64_t x[3];
+				std::int64_t y[3];
+				std::int64_t area;
+				float z[3];
+				float inverse_w[3];
+				/// Normals divided by w for perspective correct interpolation.
+				glm::vec3 normals[3];
+				glm::vec3 face_normal;
+				int min_x;
+				int min_y;
+				int max_x;
+				int max_y;
+			};
+
+			/// Triangles of one batch of input triangles and their indices per tile.
+			struct Batch
+			{
+				std::vector<Triangle> triangles;
+				std::vector<std::vector<std::uint32_t>> bins;
+			};
+
+			void rasterize_tile(size_t tile, Shading shading, size_t& fragments);
+
+			size_t width;
+			size_t height;
+			size_t tile_size;
+			size_t tiles_x;
+			size_t tiles_y;
+			/// RGB rows from bottom to top.
+			std::vector<unsigned char> color;
+			std::vector<float> depth;
+			std::vector<Batch> batches;
+			Statistics statistics{};
+	};
+}
+
+#endif // SOFTWARE_RASTERIZER_HPP
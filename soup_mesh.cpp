@@ -190,4 +190,45 @@ namespace cg
 	{
 		return faces;
 	}
+
+	MemoryUsage SoupMesh::get_memory_usage() const
+	{
+		MemoryUsage usage{"SoupMesh", {}};
+		usage.add_vector("positions", positions);
+		usage.add_vector("normals", normals);
+		usage.add_vector("texture coordinates", texture_coordinates);
+		usage.add_vector("faces", faces);
+
+		// Every face owns a separate index buffer
+		size_t indices{0};
+		size_t used{0};
+		size_t reserved{0};
+		size_t blocks{0};
+		size_t overhead{0};
+		for(const auto& face : faces)
+		{
+			indices += face.size();
+			used += face.size() * sizeof(unsigned int);
+			reserved += face.capacity() * sizeof(unsigned int);
+			if(face.capacity())
+			{
+				++blocks;
+				overhead += MemoryUsage::allocation_size(face.capacity() * sizeof(unsigned int)) - face.capacity() * sizeof(unsigned int);
+			}
+		}
+
+		// The face index buffers are counted block by block above, so they are added after the single block components
+		for(const auto& component : usage.components)
+		{
+			if(component.reserved)
+			{
+				++blocks;
+				overhead += MemoryUsage::allocation_size(component.reserved) - component.reserved;
+			}
+		}
+		usage.add("face indices", indices, used, reserved);
+		usage.add("allocator overhead", blocks, 0, overhead);
+
+		return usage;
+	}
 }
@@ -1,6 +1,8 @@
 #ifndef SOUP_MESH_HPP
 #define SOUP_MESH_HPP
 
+#include "memory_usage.hpp"
+
 #include "glm/glm.hpp"
 
 #include <string>
@@ -27,6 +29,8 @@ namespace cg
 
 			std::vector<unsigned int> calculate_indices() const;
 
+			MemoryUsage get_memory_usage() const;
+
 		private:
 			std::vector<glm::vec3> positions;
 			std::vector<glm::vec3> normals;
@@ -0,0 +1,73 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace cg
+{
+	/// Fixed size lock free ring buffer for exactly one producer and one consumer thread. Neither side ever blocks,
+	/// push fails when the ring is full. Head and tail live on separate cache lines, so the threads do not contend.
+	template<typename T, size_t Capacity>
+	class SpscQueue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two.");
+
+		public:
+			/// Producer only. Returns false without copying value if the ring is full.
+			bool push(const T& value)
+			{
+				auto tail{this->tail.load(std::memory_order_relaxed)};
+				if(tail - head_cache == Capacity)
+				{
+					head_cache = head.load(std::memory_order_acquire);
+					if(tail - head_cache == Capacity)
+						return false;
+				}
+
+				slots[tail & (Capacity - 1)] = value;
+				this->tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// Consumer only. Returns false if the ring is empty.
+			bool pop(T& value)
+			{
+				auto head{this->head.load(std::memory_order_relaxed)};
+				if(head == tail_cache)
+				{
+					tail_cache = tail.load(std::memory_order_acquire);
+					if(head == tail_cache)
+						return false;
+				}
+
+				value = slots[head & (Capacity - 1)];
+				this->head.store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// Exact only when called from one of the two threads while the other one is idle.
+			size_t size() const
+			{
+				return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+			}
+
+			static constexpr size_t capacity()
+			{
+				return Capacity;
+			}
+
+		private:
+			/// Indices count up forever and wrap around the ring through the mask.
+			alignas(64) std::atomic<size_t> head{0};
+			/// Last tail the consumer saw, saves reading the producer's cache line for every pop.
+			size_t tail_cache{0};
+			alignas(64) std::atomic<size_t> tail{0};
+			/// Last head the producer saw.
+			size_t head_cache{0};
+			alignas(64) std::array<T, Capacity> slots{};
+	};
+}
+
+#endif // SPSC_QUEUE_HPP
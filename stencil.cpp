@@ -0,0 +1,298 @@
+#include "stencil.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STENCIL_AVX2
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace cg::stencil
+{
+	namespace
+	{
+		// Kernels are instantiated for every term count, so the term loops unroll and the weights stay in registers.
+		// The scalar kernel has no branches left in its loop body and is auto-vectorized where the SIMD paths are missing.
+
+		/// Computes destination[i] for i in [begin, count), all sources already point at the first cell of the region.
+		template<size_t terms>
+		void run_scalar(float* destination, const float* const* sources, const float* weights, size_t begin, size_t count, float divisor)
+		{
+			float w[terms];
+			const float* s[terms];
+			for(size_t k{0}; k < terms; ++k)
+			{
+				w[k] = weights[k];
+				s[k] = sources[k];
+			}
+
+			for(size_t i{begin}; i < count; ++i)
+			{
+				float sum{s[0][i] * w[0]};
+				for(size_t k{1}; k < terms; ++k)
+					sum = sum + s[k][i] * w[k];
+				destination[i] = sum / divisor;
+			}
+		}
+
+#ifdef __SSE__
+		template<size_t... k>
+		inline __m128 sum_sse(const float* const* sources, const __m128* w, size_t i, std::index_sequence<k...>)
+		{
+			auto sum{_mm_mul_ps(_mm_loadu_ps(sources[0] + i), w[0])};
+			((sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(sources[k + 1] + i), w[k + 1]))), ...);
+			return sum;
+		}
+
+		template<size_t terms>
+		size_t run_sse(float* destination, const float* const* sources, const float* weights, size_t count, float divisor)
+		{
+			__m128 w[terms];
+			for(size_t k{0}; k < terms; ++k)
+				w[k] = _mm_set1_ps(weights[k]);
+			auto d{_mm_set1_ps(divisor)};
+
+			size_t i{0};
+			for(; i + 4 <= count; i += 4)
+				_mm_storeu_ps(destination + i, _mm_div_ps(sum_sse(sources, w, i, std::make_index_sequence<terms - 1>{}), d));
+			return i;
+		}
+#endif
+
+#ifdef STENCIL_AVX2
+		// Multiply and add stay separate instructions, fused versions would change the rounding
+		template<size_t... k>
+		__attribute__((target("avx2"))) inline __m256 sum_avx2(const float* const* sources, const __m256* w, size_t i, std::index_sequence<k...>)
+		{
+			auto sum{_mm256_mul_ps(_mm256_loadu_ps(sources[0] + i), w[0])};
+			((sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(sources[k + 1] + i), w[k + 1]))), ...);
+			return sum;
+		}
+
+		template<size_t terms>
+		__attribute__((target("avx2")))
+		size_t run_avx2(float* destination, const float* const* sources, const float* weights, size_t count, float divisor)
+		{
+			__m256 w[terms];
+			for(size_t k{0}; k < terms; ++k)
+				w[k] = _mm256_set1_ps(weights[k]);
+			auto d{_mm256_set1_ps(divisor)};
+
+			size_t i{0};
+			for(; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(destination + i, _mm256_div_ps(sum_avx2(sources, w, i, std::make_index_sequence<terms - 1>{}), d));
+			return i;
+		}
+
+		bool has_avx2()
+		{
+			static const bool supported{__builtin_cpu_supports("avx2") != 0};
+			return supported;
+		}
+#endif
+
+		/// Applies the kernels of one term count, the SIMD paths leave the remainder to the narrower ones.
+		template<size_t terms>
+		void run(float* destination, const float* const* sources, const float* weights, size_t count, float divisor)
+		{
+			size_t done{0};
+#ifdef STENCIL_AVX2
+			if(has_avx2())
+				done = run_avx2<terms>(destination, sources, weights, count, divisor);
+#endif
+#ifdef __SSE__
+			if(count - done >= 4)
+			{
+				const float* offset_sources[terms];
+				for(size_t k{0}; k < terms; ++k)
+					offset_sources[k] = sources[k] + done;
+				done += run_sse<terms>(destination + done, offset_sources, weights, count - done, divisor);
+			}
+#endif
+			run_scalar<terms>(destination, sources, weights, done, count, divisor);
+		}
+
+		using Kernel = void (*)(float*, const float* const*, const float*, size_t, float);
+
+		template<size_t... n>
+		constexpr std::array<Kernel, sizeof...(n)> make_kernels(std::index_sequence<n...>)
+		{
+			return {&run<n + 1>...};
+		}
+
+		/// Kernel for term_count terms at index term_count - 1.
+		constexpr auto kernels{make_kernels(std::make_index_sequence<max_terms>{})};
+
+		bool contains(const Grid& grid, size_t row_begin, size_t row_end, size_t col_begin, size_t col_end, int row, int col)
+		{
+			auto first_row{static_cast<long long>(row_begin) + row};
+			auto last_row{static_cast<long long>(row_end) - 1 + row};
+			auto first_col{static_cast<long long>(col_begin) + col};
+			auto last_col{static_cast<long long>(col_end) - 1 + col};
+			return first_row >= 0 && first_col >= 0
+				&& last_row < static_cast<long long>(grid.get_rows()) && last_col < static_cast<long long>(grid.get_cols());
+		}
+
+		void validate(const Rule& rule, const Planes& planes)
+		{
+			auto* target{planes[static_cast<size_t>(rule.target)]};
+			bool valid{target && !rule.terms.empty() && rule.terms.size() <= max_terms
+				&& contains(*target, rule.row_begin, rule.row_end, rule.col_begin, rule.col_end, 0, 0)};
+
+			for(const auto& term : rule.terms)
+			{
+				auto* source{planes[static_cast<size_t>(term.plane)]};
+				valid = valid && source && source->get_channels() == target->get_channels()
+					&& contains(*source, rule.row_begin, rule.row_end, rule.col_begin, rule.col_end, term.row, term.col);
+			}
+
+			if(!valid)
+			{
+				std::cerr << "Stencil: Rule for plane " << static_cast<int>(rule.target) << " covering rows " << rule.row_begin << " to " << rule.row_end
+					<< " and columns " << rule.col_begin << " to " << rule.col_end << " accesses cells outside of its planes\n";
+				throw std::out_of_range{"Stencil application failed."};
+			}
+		}
+	}
+
+	void weighted_sum(float* destination, const float* const* sources, const float* weights, size_t term_count, size_t count, float divisor)
+	{
+		kernels[term_count - 1](destination, sources, weights, count, divisor);
+	}
+
+	Grid::Grid(size_t rows, size_t cols, size_t channels)
+		: rows{rows},
+		  cols{cols},
+		  channels{channels},
+		  data(rows * cols * channels)
+	{
+	}
+
+	void Grid::resize(size_t rows, size_t cols, size_t channels)
+	{
+		this->rows = rows;
+		this->cols = cols;
+		this->channels = channels;
+		data.resize(rows * cols * channels);
+	}
+
+	size_t Grid::get_rows() const
+	{
+		return rows;
+	}
+
+	size_t Grid::get_cols() const
+	{
+		return cols;
+	}
+
+	size_t Grid::get_channels() const
+	{
+		return channels;
+	}
+
+	size_t Grid::get_allocated_bytes() const
+	{
+		return data.capacity() * sizeof(float);
+	}
+
+	float* Grid::row(size_t channel, size_t row)
+	{
+		return data.data() + (channel * rows + row) * cols;
+	}
+
+	const float* Grid::row(size_t channel, size_t row) const
+	{
+		return data.data() + (channel * rows + row) * cols;
+	}
+
+	void apply(const Phase& phase, const Planes& planes, ThreadPool& pool)
+	{
+		// Rows of all non empty rules are numbered consecutively so bands can span rules
+		std::vector<const Rule*> rules{};
+		std::vector<size_t> first_rows{0};
+		size_t longest_row{1};
+		for(const auto& rule : phase)
+		{
+			if(rule.row_begin >= rule.row_end || rule.col_begin >= rule.col_end)
+				continue;
+
+			validate(rule, planes);
+			rules.push_back(&rule);
+			first_rows.push_back(first_rows.back() + rule.row_end - rule.row_begin);
+			longest_row = std::max(longest_row, rule.col_end - rule.col_begin);
+		}
+
+		// Bands of roughly 64 KiB of output per channel
+		auto grain{std::max(size_t{1}, (size_t{1} << 14) / longest_row)};
+		pool.parallel_for(0, first_rows.back(), grain, [&] (size_t begin, size_t end) {
+			auto index{static_cast<size_t>(std::upper_bound(first_rows.begin(), first_rows.end(), begin) - first_rows.begin()) - 1};
+			for(; index < rules.size() && first_rows[index] < end; ++index)
+			{
+				const auto& rule{*rules[index]};
+				auto row_begin{rule.row_begin + std::max(begin, first_rows[index]) - first_rows[index]};
+				auto row_end{rule.row_begin + std::min(end, first_rows[index + 1]) - first_rows[index]};
+
+				auto& target{*planes[static_cast<size_t>(rule.target)]};
+				float weights[max_terms];
+				for(size_t k{0}; k < rule.terms.size(); ++k)
+					weights[k] = rule.terms[k].weight;
+
+				const float* sources[max_terms];
+				for(size_t channel{0}; channel < target.get_channels(); ++channel)
+				{
+					for(auto row{row_begin}; row < row_end; ++row)
+					{
+						for(size_t k{0}; k < rule.terms.size(); ++k)
+						{
+							const auto& term{rule.terms[k]};
+							sources[k] = planes[static_cast<size_t>(term.plane)]->row(channel, row + term.row) + rule.col_begin + term.col;
+						}
+						weighted_sum(target.row(channel, row) + rule.col_begin, sources, weights, rule.terms.size(), rule.col_end - rule.col_begin, rule.divisor);
+					}
+				}
+			}
+		});
+	}
+
+	void apply(const Phase& phase, const Planes& planes)
+	{
+		apply(phase, planes, ThreadPool::get_global());
+	}
+
+	void interleave(const Planes& planes, Grid& fine, ThreadPool& pool)
+	{
+		const auto& even_even{*planes[static_cast<size_t>(Plane::even_even)]};
+		const auto& even_odd{*planes[static_cast<size_t>(Plane::even_odd)]};
+		const auto& odd_even{*planes[static_cast<size_t>(Plane::odd_even)]};
+		const auto& odd_odd{*planes[static_cast<size_t>(Plane::odd_odd)]};
+		auto rows{even_even.get_rows() * 2 - 1};
+		auto cols{even_even.get_cols() * 2 - 1};
+		fine.resize(rows, cols, even_even.get_channels());
+
+		pool.parallel_for(0, rows, std::max(size_t{1}, (size_t{1} << 12) / cols), [&] (size_t begin, size_t end) {
+			for(size_t channel{0}; channel < fine.get_channels(); ++channel)
+			{
+				for(auto row{begin}; row < end; ++row)
+				{
+					const auto* even_cols{(row % 2 ? odd_even : even_even).row(channel, row / 2)};
+					const auto* odd_cols{(row % 2 ? odd_odd : even_odd).row(channel, row / 2)};
+					auto* destination{fine.row(channel, row)};
+					for(size_t col{0}; col + 1 < cols; col += 2)
+					{
+						destination[col] = even_cols[col / 2];
+						destination[col + 1] = odd_cols[col / 2];
+					}
+					destination[cols - 1] = even_cols[cols / 2];
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef STENCIL_HPP
+#define STENCIL_HPP
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace cg
+{
+	class ThreadPool;
+}
+
+namespace cg::stencil
+{
+	/// Attribute grid in structure of arrays layout, every channel is a dense rows x cols block.
+	class Grid
+	{
+		public:
+			explicit Grid(size_t rows = 0, size_t cols = 0, size_t channels = 0);
+
+			/// Keeps the allocation when shrinking, contents are unspecified afterwards.
+			void resize(size_t rows, size_t cols, size_t channels);
+
+			size_t get_rows() const;
+			size_t get_cols() const;
+			size_t get_channels() const;
+			size_t get_allocated_bytes() const;
+
+			float* row(size_t channel, size_t row);
+			const float* row(size_t channel, size_t row) const;
+
+		private:
+			size_t rows{0};
+			size_t cols{0};
+			size_t channels{0};
+			std::vector<float> data;
+	};
+
+	/// Planes a stencil reads from or writes to. The fine grid of a subdivision step is split by row and
+	/// column parity, so every plane is dense and each term of a stencil reads a contiguous row.
+	enum class Plane : unsigned char
+	{
+		coarse,
+		even_even,
+		even_odd,
+		odd_even,
+		odd_odd
+	};
+
+	constexpr size_t plane_count{5};
+	using Planes = std::array<Grid*, plane_count>;
+
+	struct Term
+	{
+		Plane plane;
+		int row;
+		int col;
+		float weight;
+	};
+
+	/// Sets every cell (r, c) of the region in target to the sum of weight * plane(r + row, c + col) over the terms
+	/// divided by divisor. Terms are summed in order, so the result matches the scalar expression bit for bit.
+	struct Rule
+	{
+		Plane target;
+		size_t row_begin;
+		size_t row_end;
+		size_t col_begin;
+		size_t col_end;
+		float divisor;
+		std::vector<Term> terms;
+	};
+
+	/// Rules of one phase write disjoint cells and only read planes written by earlier phases.
+	using Phase = std::vector<Rule>;
+
+	constexpr size_t max_terms{16};
+
+	/// Sets destination[i] to the sum of weights[k] * sources[k][i] over the terms divided by divisor, for i in [0, count).
+	/// This is the kernel behind apply, term_count must be in [1, max_terms]. Every term count has its own unrolled kernel.
+	void weighted_sum(float* destination, const float* const* sources, const float* weights, size_t term_count, size_t count, float divisor = 1.f);
+
+	/// Applies all rules of phase to every channel, using AVX2 or SSE when available.
+	/// Rows are split into bands that run in parallel on pool, the result does not depend on the thread count.
+	/// Throws out_of_range if a rule writes or reads outside of its planes.
+	void apply(const Phase& phase, const Planes& planes, ThreadPool& pool);
+	/// Uses the global thread pool.
+	void apply(const Phase& phase, const Planes& planes);
+
+	/// Resizes fine to (2 * rows - 1) x (2 * cols - 1) of the even_even plane and interleaves the four parity planes into it.
+	void interleave(const Planes& planes, Grid& fine, ThreadPool& pool);
+}
+
+#endif // STENCIL_HPP
@@ -0,0 +1,123 @@
+#include "subdivision_worker.hpp"
+
+#include <iostream>
+
+namespace cg
+{
+	SubdivisionWorker::SubdivisionWorker()
+		: worker{&SubdivisionWorker::work, this}
+	{
+	}
+
+	SubdivisionWorker::~SubdivisionWorker()
+	{
+		{
+			std::lock_guard lock{mutex};
+			jobs.clear();
+			stopping = true;
+			cancelled = true;
+		}
+		condition.notify_all();
+		worker.join();
+	}
+
+	void SubdivisionWorker::request(RegularMesh base, size_t level, RegularMesh::Scheme scheme)
+	{
+		{
+			std::lock_guard lock{mutex};
+			jobs.push_back({std::make_shared<const RegularMesh>(std::move(base)), level, scheme});
+			last_level = level + 1;
+		}
+		condition.notify_all();
+	}
+
+	bool SubdivisionWorker::request(RegularMesh::Scheme scheme)
+	{
+		{
+			std::lock_guard lock{mutex};
+			if(!last_level)
+				return false;
+			jobs.push_back({nullptr, *last_level, scheme});
+			last_level = *last_level + 1;
+		}
+		condition.notify_all();
+		return true;
+	}
+
+	void SubdivisionWorker::cancel()
+	{
+		std::lock_guard lock{mutex};
+		jobs.clear();
+		last_level.reset();
+		cancelled = running;
+	}
+
+	size_t SubdivisionWorker::get_pending() const
+	{
+		std::lock_guard lock{mutex};
+		return jobs.size() + (running ? 1 : 0);
+	}
+
+	std::optional<SubdivisionWorker::Result> SubdivisionWorker::take()
+	{
+		std::lock_guard lock{mutex};
+		if(results.empty())
+			return std::nullopt;
+
+		auto result{std::move(results.front())};
+		results.pop_front();
+		return result;
+	}
+
+	void SubdivisionWorker::work()
+	{
+		// Output of the previous job, the base of jobs continuing from it
+		std::shared_ptr<const RegularMesh> previous{};
+
+		std::unique_lock lock{mutex};
+		while(true)
+		{
+			condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if(stopping)
+				return;
+
+			auto job{std::move(jobs.front())};
+			jobs.pop_front();
+			running = true;
+			cancelled = false;
+			lock.unlock();
+
+			std::optional<Result> result{};
+			bool failed{false};
+			try
+			{
+				RegularMesh mesh{job.base ? *job.base : *previous};
+				job.base.reset();
+				if(mesh.subdivide(job.scheme, 1, cancelled))
+				{
+					// The worker keeps its own copy to continue from, the render thread only moves the result
+					previous = std::make_shared<const RegularMesh>(mesh);
+					result.emplace(Result{job.level + 1, job.scheme, std::move(mesh), MeshRenderer::build_geometry(*previous)});
+				}
+			}
+			catch(const std::exception& exception)
+			{
+				std::cerr << "SubdivisionWorker: Subdividing level " << job.level << " failed with error: " << exception.what() << '\n';
+				failed = true;
+			}
+
+			lock.lock();
+			running = false;
+			// Jobs continuing from a failed one have no base, the rest of the queue started over from a pyramid level
+			if(failed)
+			{
+				while(!jobs.empty() && !jobs.front().base)
+					jobs.pop_front();
+				if(jobs.empty())
+					last_level.reset();
+			}
+			if(result && !cancelled)
+				results.push_back(std::move(*result));
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef SUBDIVISION_WORKER_HPP
+#define SUBDIVISION_WORKER_HPP
+
+#include "mesh_renderer.hpp"
+#include "regular_mesh.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace cg
+{
+	/// Subdivides RegularMeshes one level per job on a background thread, in the order the jobs were requested.
+	/// Results carry the mesh and its renderer geometry, the render thread picks them up with take.
+	class SubdivisionWorker
+	{
+		public:
+			struct Result
+			{
+				/// Level of the subdivided mesh, one finer than the base of the job.
+				size_t level;
+				RegularMesh::Scheme scheme;
+				/// Copy of the subdivided mesh owned by the result, so it can be moved into a pyramid without further work.
+				RegularMesh mesh;
+				MeshRenderer::Geometry geometry;
+			};
+
+			SubdivisionWorker();
+			/// Cancels all jobs and waits for the running one to stop.
+			~SubdivisionWorker();
+
+			SubdivisionWorker(const SubdivisionWorker&) = delete;
+			SubdivisionWorker& operator=(const SubdivisionWorker&) = delete;
+
+			/// Queues subdividing base, which is level of its pyramid, with scheme.
+			void request(RegularMesh base, size_t level, RegularMesh::Scheme scheme);
+			/// Queues subdividing the result of the last requested job again. Returns false without a job to continue from,
+			/// which is the case after cancel or a failed job.
+			bool request(RegularMesh::Scheme scheme);
+
+			/// Drops all queued jobs and stops the running one, none of them produce a result.
+			void cancel();
+
+			/// Jobs queued or running.
+			size_t get_pending() const;
+			/// Returns the oldest result that was not taken yet.
+			std::optional<Result> take();
+
+		private:
+			struct Job
+			{
+				/// Null for jobs continuing from the previous one.
+				std::shared_ptr<const RegularMesh> base;
+				size_t level;
+				RegularMesh::Scheme scheme;
+			};
+
+			void work();
+
+			mutable std::mutex mutex;
+			std::condition_variable condition;
+			std::deque<Job> jobs;
+			std::deque<Result> results;
+			bool running{false};
+			/// Level of the last requested job, empty if request(scheme) has nothing to continue from.
+			std::optional<size_t> last_level{};
+			/// Set by cancel, the running job polls it between stencil phases.
+			std::atomic<bool> cancelled{false};
+			bool stopping{false};
+			std::thread worker;
+	};
+}
+
+#endif // SUBDIVISION_WORKER_HPP
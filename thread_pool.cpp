@@ -0,0 +1,58 @@
+#include "thread_pool.hpp"
+
+namespace cg
+{
+	ThreadPool::ThreadPool(unsigned int thread_count)
+	{
+		for(unsigned int i{1}; i < thread_count; ++i)
+			workers.emplace_back([this] () { work(); });
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stopping = true;
+		}
+		condition.notify_all();
+		for(auto& worker : workers)
+			worker.join();
+	}
+
+	ThreadPool& ThreadPool::get_global()
+	{
+		static ThreadPool pool{};
+		return pool;
+	}
+
+	unsigned int ThreadPool::get_thread_count() const
+	{
+		return static_cast<unsigned int>(workers.size()) + 1;
+	}
+
+	void ThreadPool::enqueue(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			tasks.push(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	void ThreadPool::work()
+	{
+		while(true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				condition.wait(lock, [this] () { return stopping || !tasks.empty(); });
+				if(stopping && tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+}
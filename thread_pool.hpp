@@ -0,0 +1,112 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace cg
+{
+	class ThreadPool
+	{
+		public:
+			/// Creates thread_count - 1 workers, the thread calling parallel_for does the remaining share.
+			explicit ThreadPool(unsigned int thread_count = std::thread::hardware_concurrency());
+			~ThreadPool();
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/// Pool shared by all mesh operations.
+			static ThreadPool& get_global();
+
+			unsigned int get_thread_count() const;
+
+			/// Calls function(chunk_begin, chunk_end) for disjoint chunks of [begin, end) that contain at least grain elements
+			/// and blocks until all chunks are done. Can be nested, the first exception thrown by function is rethrown.
+			template<typename Function>
+			void parallel_for(size_t begin, size_t end, size_t grain, Function&& function);
+
+		private:
+			void enqueue(std::function<void()> task);
+			void work();
+
+			std::vector<std::thread> workers;
+			std::queue<std::function<void()>> tasks;
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool stopping{false};
+	};
+
+	template<typename Function>
+	void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, Function&& function)
+	{
+		if(end <= begin)
+			return;
+
+		grain = std::max(grain, size_t{1});
+		auto chunk_count{std::min((end - begin + grain - 1) / grain, static_cast<size_t>(get_thread_count()) * 4)};
+		auto chunk_size{(end - begin + chunk_count - 1) / chunk_count};
+		if(chunk_count <= 1 || workers.empty())
+		{
+			function(begin, end);
+			return;
+		}
+
+		// Helpers only touch function after claiming a chunk, which keeps the caller waiting,
+		// so late helpers can safely outlive this call through the shared state.
+		struct State
+		{
+			std::atomic<size_t> next{0};
+			std::atomic<size_t> done{0};
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::exception_ptr exception;
+		};
+		auto state{std::make_shared<State>()};
+		auto* function_ptr{&function};
+
+		auto run_chunks{[state, function_ptr, begin, end, chunk_count, chunk_size] () {
+			size_t chunk;
+			while((chunk = state->next++) < chunk_count)
+			{
+				try
+				{
+					auto chunk_begin{begin + chunk * chunk_size};
+					(*function_ptr)(chunk_begin, std::min(chunk_begin + chunk_size, end));
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock{state->mutex};
+					if(!state->exception)
+						state->exception = std::current_exception();
+				}
+
+				if(++state->done == chunk_count)
+				{
+					std::lock_guard<std::mutex> lock{state->mutex};
+					state->condition.notify_all();
+				}
+			}
+		}};
+
+		auto helpers{std::min(chunk_count - 1, workers.size())};
+		for(size_t i{0}; i < helpers; ++i)
+			enqueue(run_chunks);
+		run_chunks();
+
+		std::unique_lock<std::mutex> lock{state->mutex};
+		state->condition.wait(lock, [&state, chunk_count] () { return state->done == chunk_count; });
+		if(state->exception)
+			std::rethrow_exception(state->exception);
+	}
+}
+
+#endif // THREAD_POOL_HPP